@@ -0,0 +1,159 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_file.h"
+
+#include "db/filename.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+
+void BlobIndex::EncodeTo(std::string* dst) const {
+  PutVarint64(dst, file_number);
+  PutVarint64(dst, offset);
+  PutVarint64(dst, size);
+}
+
+bool BlobIndex::DecodeFrom(const Slice& input) {
+  Slice in = input;
+  return (GetVarint64(&in, &file_number) &&
+          GetVarint64(&in, &offset) &&
+          GetVarint64(&in, &size) &&
+          in.empty());
+}
+
+BlobFileBuilder::BlobFileBuilder(Env* env, const std::string& dbname,
+                                 uint64_t number)
+    : env_(env),
+      fname_(BlobFileName(dbname, number)),
+      number_(number),
+      file_(NULL),
+      offset_(0),
+      finished_(false) {
+}
+
+BlobFileBuilder::~BlobFileBuilder() {
+  if (file_ != NULL) {
+    delete file_;
+    if (!finished_) {
+      env_->DeleteFile(fname_);
+    }
+  }
+}
+
+Status BlobFileBuilder::Add(const Slice& value, std::string* index) {
+  assert(!finished_);
+  Status s;
+  if (file_ == NULL) {
+    s = env_->NewWritableFile(fname_, &file_);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  char trailer[kBlobTrailerSize];
+  EncodeFixed32(trailer, crc32c::Mask(crc32c::Value(value.data(),
+                                                    value.size())));
+  s = file_->Append(value);
+  if (s.ok()) {
+    s = file_->Append(Slice(trailer, sizeof(trailer)));
+  }
+  if (s.ok()) {
+    BlobIndex handle;
+    handle.file_number = number_;
+    handle.offset = offset_;
+    handle.size = value.size();
+    index->clear();
+    handle.EncodeTo(index);
+    offset_ += value.size() + kBlobTrailerSize;
+  }
+  return s;
+}
+
+Status BlobFileBuilder::Finish() {
+  assert(!finished_);
+  Status s;
+  if (file_ != NULL) {
+    s = file_->Sync();
+    if (s.ok()) {
+      s = file_->Close();
+    }
+  }
+  finished_ = s.ok();
+  return s;
+}
+
+static void DeleteBlobFile(const Slice& key, void* value) {
+  delete reinterpret_cast<RandomAccessFile*>(value);
+}
+
+BlobCache::BlobCache(const std::string& dbname, const Options* options,
+                     int entries)
+    : env_(options->env),
+      dbname_(dbname),
+      cache_(NewLRUCache(entries)) {
+}
+
+BlobCache::~BlobCache() {
+  delete cache_;
+}
+
+Status BlobCache::Get(const Slice& index, std::string* value) {
+  BlobIndex handle;
+  if (!handle.DecodeFrom(index)) {
+    return Status::Corruption("bad blob index");
+  }
+
+  char buf[sizeof(handle.file_number)];
+  EncodeFixed64(buf, handle.file_number);
+  Slice key(buf, sizeof(buf));
+  Cache::Handle* h = cache_->Lookup(key);
+  if (h == NULL) {
+    RandomAccessFile* file;
+    Status s = env_->NewRandomAccessFile(
+        BlobFileName(dbname_, handle.file_number), &file);
+    if (!s.ok()) {
+      return s;
+    }
+    h = cache_->Insert(key, file, 1, &DeleteBlobFile);
+  }
+  RandomAccessFile* file = reinterpret_cast<RandomAccessFile*>(
+      cache_->Value(h));
+
+  const size_t n = static_cast<size_t>(handle.size);
+  value->resize(n + kBlobTrailerSize);
+  Slice contents;
+  Status s = file->Read(handle.offset, n + kBlobTrailerSize, &contents,
+                        &(*value)[0]);
+  cache_->Release(h);
+  if (s.ok() && contents.size() != n + kBlobTrailerSize) {
+    s = Status::Corruption("truncated blob");
+  }
+  if (s.ok()) {
+    const uint32_t crc = crc32c::Unmask(DecodeFixed32(contents.data() + n));
+    if (crc32c::Value(contents.data(), n) != crc) {
+      s = Status::Corruption("blob checksum mismatch");
+    }
+  }
+  if (s.ok()) {
+    if (contents.data() != value->data()) {
+      // File implementation gave us a pointer to some other data.
+      value->assign(contents.data(), n);
+    } else {
+      value->resize(n);
+    }
+  } else {
+    value->clear();
+  }
+  return s;
+}
+
+void BlobCache::Evict(uint64_t file_number) {
+  char buf[sizeof(file_number)];
+  EncodeFixed64(buf, file_number);
+  cache_->Erase(Slice(buf, sizeof(buf)));
+}
+
+}  // namespace leveldb
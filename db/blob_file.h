@@ -0,0 +1,94 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Blob files hold values of at least Options::min_blob_size bytes, so
+// that compactions only have to rewrite small pointers to them.  A
+// blob file is a sequence of blobs, each followed by kBlobTrailerSize
+// bytes holding the masked crc32c of the blob.  The table entry of
+// such a value has type kTypeBlobIndex and an encoded BlobIndex as its
+// value.
+
+#ifndef STORAGE_LEVELDB_DB_BLOB_FILE_H_
+#define STORAGE_LEVELDB_DB_BLOB_FILE_H_
+
+#include <string>
+#include <stdint.h>
+#include "leveldb/cache.h"
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Env;
+class WritableFile;
+
+static const size_t kBlobTrailerSize = 4;
+
+// Location of a blob.
+struct BlobIndex {
+  uint64_t file_number;
+  uint64_t offset;
+  uint64_t size;              // Excluding the trailer
+
+  void EncodeTo(std::string* dst) const;
+  bool DecodeFrom(const Slice& input);
+};
+
+// Appends blobs to a new blob file.  The file is only created when the
+// first blob is added.
+class BlobFileBuilder {
+ public:
+  BlobFileBuilder(Env* env, const std::string& dbname, uint64_t number);
+
+  // Deletes the file unless Finish() succeeded.
+  ~BlobFileBuilder();
+
+  // Append "value" to the file and store the encoded BlobIndex that
+  // points to it in *index.
+  Status Add(const Slice& value, std::string* index);
+
+  // Sync and close the file, if it was created.
+  Status Finish();
+
+  uint64_t number() const { return number_; }
+
+  // Number of bytes added so far, i.e. the final size of the file.
+  uint64_t FileSize() const { return offset_; }
+
+ private:
+  Env* const env_;
+  const std::string fname_;
+  const uint64_t number_;
+  WritableFile* file_;
+  uint64_t offset_;
+  bool finished_;
+
+  // No copying allowed
+  BlobFileBuilder(const BlobFileBuilder&);
+  void operator=(const BlobFileBuilder&);
+};
+
+// Keeps blob files open for reading.  Thread-safe.
+class BlobCache {
+ public:
+  BlobCache(const std::string& dbname, const Options* options, int entries);
+  ~BlobCache();
+
+  // Store in *value the blob that the encoded BlobIndex "index" points
+  // to.  The blob's checksum is always verified.
+  Status Get(const Slice& index, std::string* value);
+
+  // Evict any entry for the specified file number
+  void Evict(uint64_t file_number);
+
+ private:
+  Env* const env_;
+  const std::string dbname_;
+  Cache* cache_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BLOB_FILE_H_
@@ -4,6 +4,7 @@
 
 #include "db/builder.h"
 
+#include "db/blob_file.h"
 #include "db/filename.h"
 #include "db/dbformat.h"
 #include "db/table_cache.h"
@@ -19,9 +20,13 @@ Status BuildTable(const std::string& dbname,
                   const Options& options,
                   TableCache* table_cache,
                   Iterator* iter,
-                  FileMetaData* meta) {
+                  FileMetaData* meta,
+                  BlobFileBuilder* blobs) {
   Status s;
   meta->file_size = 0;
+  meta->oldest_expiry = 0;
+  meta->num_entries = 0;
+  meta->num_deletions = 0;
   iter->SeekToFirst();
 
   // 首先得到sstable的名字
@@ -29,18 +34,52 @@ Status BuildTable(const std::string& dbname,
   if (iter->Valid()) {
     WritableFile* file;
     // 创建sstable
-    s = env->NewWritableFile(fname, &file);
+    if (options.use_direct_io_for_flush_and_compaction) {
+      s = env->NewDirectWritableFile(fname, &file);
+    } else {
+      s = env->NewWritableFile(fname, &file);
+    }
     if (!s.ok()) {
       return s;
     }
 
     TableBuilder* builder = new TableBuilder(options, file);
-    meta->smallest.DecodeFrom(iter->key());
     // 依次将iter中的数据添加到builder中
+    std::string blob_key, blob_index;
     for (; iter->Valid(); iter->Next()) {
       Slice key = iter->key();
+      Slice value = iter->value();
+      ParsedInternalKey ikey;
+      if (blobs != NULL && options.min_blob_size > 0 &&
+          value.size() >= options.min_blob_size &&
+          ParseInternalKey(key, &ikey) && ikey.type == kTypeValue) {
+        // Move the value to the blob file
+        s = blobs->Add(value, &blob_index);
+        if (!s.ok()) {
+          break;
+        }
+        blob_key.clear();
+        AppendInternalKey(&blob_key, ParsedInternalKey(
+            ikey.user_key, ikey.sequence, kTypeBlobIndex));
+        key = blob_key;
+        value = blob_index;
+      }
+      if (options.ttl > 0 && ExtractValueType(key) == kTypeValue) {
+        const uint64_t expiry = ExtractExpiry(value);
+        if (expiry != 0 &&
+            (meta->oldest_expiry == 0 || expiry < meta->oldest_expiry)) {
+          meta->oldest_expiry = expiry;
+        }
+      }
+      if (builder->NumEntries() == 0) {
+        meta->smallest.DecodeFrom(key);
+      }
       meta->largest.DecodeFrom(key);
-      builder->Add(key, iter->value());
+      builder->Add(key, value);
+      meta->num_entries++;
+      if (ExtractValueType(key) == kTypeDeletion) {
+        meta->num_deletions++;
+      }
     }
 
     // Finish and check for builder errors
@@ -56,6 +95,9 @@ Status BuildTable(const std::string& dbname,
     delete builder;
 
     // Finish and check for file errors
+    if (s.ok() && blobs != NULL) {
+      s = blobs->Finish();
+    }
     if (s.ok()) {
       s = file->Sync();
     }
@@ -72,6 +114,11 @@ Status BuildTable(const std::string& dbname,
                                               meta->file_size);
       s = it->status();
       delete it;
+      if (s.ok() && options.prepopulate_block_cache &&
+          options.block_cache != NULL) {
+        // Best effort: a failure only leaves the blocks uncached
+        table_cache->LoadAllBlocks(meta->number, meta->file_size);
+      }
     }
   }
 
@@ -12,6 +12,7 @@ namespace leveldb {
 struct Options;
 struct FileMetaData;
 
+class BlobFileBuilder;
 class Env;
 class Iterator;
 class TableCache;
@@ -21,13 +22,20 @@ class VersionEdit;
 // will be named according to meta->number.  On success, the rest of
 // *meta will be filled with metadata about the generated table.
 // If no data is present in *iter, meta->file_size will be set to
-// zero, and no Table file will be produced.
+// zero, and no Table file will be produced.  meta->oldest_expiry is
+// only set if options.ttl is non-zero.
+//
+// If "blobs" is non-NULL, values of at least options.min_blob_size
+// bytes are added to it instead of the table, and the table gets
+// kTypeBlobIndex entries pointing to them.  *blobs is finished along
+// with the table.
 extern Status BuildTable(const std::string& dbname,
                          Env* env,
                          const Options& options,
                          TableCache* table_cache,
                          Iterator* iter,
-                         FileMetaData* meta);
+                         FileMetaData* meta,
+                         BlobFileBuilder* blobs = NULL);
 
 }  // namespace leveldb
 
@@ -30,6 +30,7 @@ using leveldb::Logger;
 using leveldb::NewBloomFilterPolicy;
 using leveldb::NewLRUCache;
 using leveldb::Options;
+using leveldb::PinnableSlice;
 using leveldb::RandomAccessFile;
 using leveldb::Range;
 using leveldb::ReadOptions;
@@ -56,6 +57,7 @@ struct leveldb_randomfile_t   { RandomAccessFile* rep; };
 struct leveldb_writablefile_t { WritableFile*     rep; };
 struct leveldb_logger_t       { Logger*           rep; };
 struct leveldb_filelock_t     { FileLock*         rep; };
+struct leveldb_pinnableslice_t { PinnableSlice    rep; };
 
 struct leveldb_comparator_t : public Comparator {
   void* state_;
@@ -215,6 +217,23 @@ char* leveldb_get(
   return result;
 }
 
+leveldb_pinnableslice_t* leveldb_get_pinned(
+    leveldb_t* db,
+    const leveldb_readoptions_t* options,
+    const char* key, size_t keylen,
+    char** errptr) {
+  leveldb_pinnableslice_t* result = new leveldb_pinnableslice_t;
+  Status s = db->rep->Get(options->rep, Slice(key, keylen), &result->rep);
+  if (!s.ok()) {
+    delete result;
+    result = NULL;
+    if (!s.IsNotFound()) {
+      SaveError(errptr, s);
+    }
+  }
+  return result;
+}
+
 leveldb_iterator_t* leveldb_create_iterator(
     leveldb_t* db,
     const leveldb_readoptions_t* options) {
@@ -338,6 +357,16 @@ leveldb_writebatch_t* leveldb_writebatch_create() {
   return new leveldb_writebatch_t;
 }
 
+void leveldb_pinnableslice_destroy(leveldb_pinnableslice_t* v) {
+  delete v;
+}
+
+const char* leveldb_pinnableslice_value(const leveldb_pinnableslice_t* v,
+                                        size_t* vlen) {
+  *vlen = v->rep.size();
+  return v->rep.data();
+}
+
 void leveldb_writebatch_destroy(leveldb_writebatch_t* b) {
   delete b;
 }
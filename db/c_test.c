@@ -75,6 +75,26 @@ static void CheckGet(
   Free(&val);
 }
 
+static void CheckPinnedGet(
+    leveldb_t* db,
+    const leveldb_readoptions_t* options,
+    const char* key,
+    const char* expected) {
+  char* err = NULL;
+  size_t val_len = 0;
+  const char* val = NULL;
+  leveldb_pinnableslice_t* p;
+  p = leveldb_get_pinned(db, options, key, strlen(key), &err);
+  CheckNoError(err);
+  if (p != NULL) {
+    val = leveldb_pinnableslice_value(p, &val_len);
+  }
+  CheckEqual(expected, val, val_len);
+  if (p != NULL) {
+    leveldb_pinnableslice_destroy(p);
+  }
+}
+
 static void CheckIter(leveldb_iterator_t* iter,
                       const char* key, const char* val) {
   size_t len;
@@ -232,6 +252,10 @@ int main(int argc, char** argv) {
   leveldb_compact_range(db, "a", 1, "z", 1);
   CheckGet(db, roptions, "foo", "hello");
 
+  StartPhase("getpinned");
+  CheckPinnedGet(db, roptions, "foo", "hello");
+  CheckPinnedGet(db, roptions, "bar", NULL);
+
   StartPhase("writebatch");
   {
     leveldb_writebatch_t* wb = leveldb_writebatch_create();
@@ -12,6 +12,7 @@
 #include "leveldb/env.h"
 #include "leveldb/write_batch.h"
 #include "port/port.h"
+#include "util/coding.h"
 #include "util/crc32c.h"
 #include "util/histogram.h"
 #include "util/mutexlock.h"
@@ -30,11 +31,14 @@
 //      readseq       -- read N times sequentially
 //      readreverse   -- read N times in reverse order
 //      readrandom    -- read N times in random order
+//      multireadrandom -- read N times in random order, 32 keys per MultiGet
 //      readmissing   -- read N missing keys in random order
 //      readhot       -- read N times in random order from 1% section of DB
 //      seekrandom    -- N random seeks
 //      crc32c        -- repeated crc32c of 4K of data
 //      acquireload   -- load N*1000 times
+//      lrucache      -- N lookups of 4K blocks in a warm NewLRUCache()
+//      clockcache    -- N lookups of 4K blocks in a warm NewClockCache()
 //   Meta operations:
 //      compact     -- Compact the entire DB
 //      stats       -- Print DB stats
@@ -90,6 +94,15 @@ static int FLAGS_cache_size = -1;
 // Maximum number of files to keep open at the same time (use default if == 0)
 static int FLAGS_open_files = 0;
 
+// Compaction style: 0 for leveled, 1 for universal.  Run e.g.
+// --benchmarks=fillrandom,overwrite,stats with each to compare their
+// write amplification.
+static int FLAGS_compaction_style = 0;
+
+// Which table of a level compactions pick: 0 round-robin, 1 minimal
+// overlapping ratio, 2 oldest first (see Options::compaction_pri).
+static int FLAGS_compaction_pri = 0;
+
 // Bloom filter bits per key.
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
@@ -302,6 +315,7 @@ struct ThreadState {
 class Benchmark {
  private:
   Cache* cache_;
+  Cache* bench_cache_;   // Cache under test for lrucache and clockcache
   const FilterPolicy* filter_policy_;
   DB* db_;
   int num_;
@@ -388,6 +402,7 @@ class Benchmark {
  public:
   Benchmark()
   : cache_(FLAGS_cache_size >= 0 ? NewLRUCache(FLAGS_cache_size) : NULL),
+    bench_cache_(NULL),
     filter_policy_(FLAGS_bloom_bits >= 0
                    ? NewBloomFilterPolicy(FLAGS_bloom_bits)
                    : NULL),
@@ -471,6 +486,8 @@ class Benchmark {
         method = &Benchmark::ReadReverse;
       } else if (name == Slice("readrandom")) {
         method = &Benchmark::ReadRandom;
+      } else if (name == Slice("multireadrandom")) {
+        method = &Benchmark::MultiReadRandom;
       } else if (name == Slice("readmissing")) {
         method = &Benchmark::ReadMissing;
       } else if (name == Slice("seekrandom")) {
@@ -493,6 +510,15 @@ class Benchmark {
         method = &Benchmark::Crc32c;
       } else if (name == Slice("acquireload")) {
         method = &Benchmark::AcquireLoad;
+      } else if (name == Slice("lrucache")) {
+        bench_cache_ = NewLRUCache(kCacheBenchEntries * kCacheBenchCharge);
+        FillBenchCache();
+        method = &Benchmark::CacheLookup;
+      } else if (name == Slice("clockcache")) {
+        bench_cache_ = NewClockCache(kCacheBenchEntries * kCacheBenchCharge,
+                                     kCacheBenchCharge);
+        FillBenchCache();
+        method = &Benchmark::CacheLookup;
       } else if (name == Slice("snappycomp")) {
         method = &Benchmark::SnappyCompress;
       } else if (name == Slice("snappyuncomp")) {
@@ -525,6 +551,8 @@ class Benchmark {
       if (method != NULL) {
         RunBenchmark(num_threads, name, method);
       }
+      delete bench_cache_;
+      bench_cache_ = NULL;
     }
   }
 
@@ -640,6 +668,45 @@ class Benchmark {
     if (ptr == NULL) exit(1); // Disable unused variable warning.
   }
 
+  // Number and size of the entries in the cache used by CacheLookup().
+  static const int kCacheBenchEntries = 16384;
+  static const int kCacheBenchCharge = 4096;
+
+  static void DeleteCacheBenchValue(const Slice& key, void* value) {
+  }
+
+  static std::string CacheBenchKey(int k) {
+    char buf[8];
+    EncodeFixed64(buf, k);
+    return std::string(buf, sizeof(buf));
+  }
+
+  void FillBenchCache() {
+    // Insert the hottest keys last so that the fill itself does not
+    // evict them from overfull shards.
+    for (int k = kCacheBenchEntries - 1; k >= 0; k--) {
+      bench_cache_->Release(bench_cache_->Insert(
+          CacheBenchKey(k), NULL, kCacheBenchCharge, &DeleteCacheBenchValue));
+    }
+  }
+
+  void CacheLookup(ThreadState* thread) {
+    int found = 0;
+    for (int i = 0; i < reads_; i++) {
+      // Most lookups go to a small set of hot blocks.
+      const int k = thread->rand.Skewed(14) % kCacheBenchEntries;
+      Cache::Handle* h = bench_cache_->Lookup(CacheBenchKey(k));
+      if (h != NULL) {
+        found++;
+        bench_cache_->Release(h);
+      }
+      thread->stats.FinishedSingleOp();
+    }
+    char msg[100];
+    snprintf(msg, sizeof(msg), "(%d of %d found)", found, reads_);
+    thread->stats.AddMessage(msg);
+  }
+
   void SnappyCompress(ThreadState* thread) {
     RandomGenerator gen;
     Slice input = gen.Generate(Options().block_size);
@@ -695,6 +762,9 @@ class Benchmark {
     options.write_buffer_size = FLAGS_write_buffer_size;
     options.max_open_files = FLAGS_open_files;
     options.filter_policy = filter_policy_;
+    options.compaction_style = static_cast<CompactionStyle>(
+        FLAGS_compaction_style);
+    options.compaction_pri = static_cast<CompactionPri>(FLAGS_compaction_pri);
     Status s = DB::Open(options, FLAGS_db, &db_);
     if (!s.ok()) {
       fprintf(stderr, "open error: %s\n", s.ToString().c_str());
@@ -784,6 +854,36 @@ class Benchmark {
     thread->stats.AddMessage(msg);
   }
 
+  void MultiReadRandom(ThreadState* thread) {
+    static const int kBatchSize = 32;
+    ReadOptions options;
+    std::vector<std::string> key_strings(kBatchSize);
+    std::vector<Slice> keys(kBatchSize);
+    std::vector<std::string> values;
+    int found = 0;
+    for (int i = 0; i < reads_; i += kBatchSize) {
+      const int n = std::min(kBatchSize, reads_ - i);
+      keys.resize(n);
+      for (int j = 0; j < n; j++) {
+        char key[100];
+        const int k = thread->rand.Next() % FLAGS_num;
+        snprintf(key, sizeof(key), "%016d", k);
+        key_strings[j] = key;
+        keys[j] = key_strings[j];
+      }
+      std::vector<Status> statuses = db_->MultiGet(options, keys, &values);
+      for (int j = 0; j < n; j++) {
+        if (statuses[j].ok()) {
+          found++;
+        }
+        thread->stats.FinishedSingleOp();
+      }
+    }
+    char msg[100];
+    snprintf(msg, sizeof(msg), "(%d of %d found)", found, num_);
+    thread->stats.AddMessage(msg);
+  }
+
   void ReadMissing(ThreadState* thread) {
     ReadOptions options;
     std::string value;
@@ -956,6 +1056,12 @@ int main(int argc, char** argv) {
       FLAGS_cache_size = n;
     } else if (sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1) {
       FLAGS_bloom_bits = n;
+    } else if (sscanf(argv[i], "--compaction_style=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_compaction_style = n;
+    } else if (sscanf(argv[i], "--compaction_pri=%d%c", &n, &junk) == 1 &&
+               n >= 0 && n <= 2) {
+      FLAGS_compaction_pri = n;
     } else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1) {
       FLAGS_open_files = n;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
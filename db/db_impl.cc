@@ -5,11 +5,13 @@
 #include "db/db_impl.h"
 
 #include <algorithm>
+#include <map>
 #include <set>
 #include <string>
 #include <stdint.h>
 #include <stdio.h>
 #include <vector>
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_iter.h"
 #include "db/dbformat.h"
@@ -18,8 +20,10 @@
 #include "db/log_writer.h"
 #include "db/memtable.h"
 #include "db/table_cache.h"
+#include "db/tailing_iter.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/status.h"
@@ -56,11 +60,22 @@ struct DBImpl::CompactionState {
   // Sequence number小于smallest_snapshot的数据都可以不必保留了
   SequenceNumber smallest_snapshot;
 
+  // Entries with larger sequence numbers are seen by no snapshot, so
+  // the compaction filter may change them.
+  SequenceNumber newest_snapshot;
+
+  // Number reserved at the start of a universal merge for its output,
+  // so that the output is older than any table flushed meanwhile
+  uint64_t reserved_number;
+
   // Files produced by compaction
   struct Output {
     uint64_t number;
     uint64_t file_size;
     InternalKey smallest, largest;
+    uint64_t oldest_expiry;   // See FileMetaData
+    uint64_t num_entries;
+    uint64_t num_deletions;
   };
   std::vector<Output> outputs;
 
@@ -68,14 +83,23 @@ struct DBImpl::CompactionState {
   WritableFile* outfile;
   TableBuilder* builder;
 
+  // Blob file for the large values found in the inputs and for the
+  // blobs moved out of blob files that are mostly garbage.
+  BlobFileBuilder* blobs;
+  // Bytes of blobs that the compaction dropped or moved, per blob file
+  std::map<uint64_t, uint64_t> blob_garbage;
+
   uint64_t total_bytes;
 
   Output* current_output() { return &outputs[outputs.size()-1]; }
 
   explicit CompactionState(Compaction* c)
       : compaction(c),
+        newest_snapshot(0),
+        reserved_number(0),
         outfile(NULL),
         builder(NULL),
+        blobs(NULL),
         total_bytes(0) {
   }
 };
@@ -96,6 +120,11 @@ Options SanitizeOptions(const std::string& dbname,
   ClipToRange(&result.max_open_files,            20,     50000);
   ClipToRange(&result.write_buffer_size,         64<<10, 1<<30);
   ClipToRange(&result.block_size,                1<<10,  4<<20);
+  ClipToRange(&result.num_levels,                2,      config::kNumLevels);
+  ClipToRange(&result.max_mem_compaction_level,  0,      result.num_levels-1);
+  ClipToRange(&result.max_file_size,             1<<20,  1<<30);
+  ClipToRange(&result.universal_size_ratio,      0,      100);
+  ClipToRange(&result.universal_max_size_amplification_percent, 1, 1<<20);
   if (result.info_log == NULL) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -120,6 +149,7 @@ DBImpl::DBImpl(const Options& options, const std::string& dbname)
           dbname, &internal_comparator_, &internal_filter_policy_, options)),
       owns_info_log_(options_.info_log != options.info_log),
       owns_cache_(options_.block_cache != options.block_cache),
+      save_cache_state_(false),
       dbname_(dbname),
       db_lock_(NULL),
       shutting_down_(NULL),
@@ -130,14 +160,30 @@ DBImpl::DBImpl(const Options& options, const std::string& dbname)
       logfile_number_(0),
       log_(NULL),
       tmp_batch_(new WriteBatch),
+      ttl_batch_(new WriteBatch),
+      seed_(0),
       bg_compaction_scheduled_(false),
-      manual_compaction_(NULL) {
+      loading_cache_state_(false),
+      preload_version_(NULL),
+      preload_next_(0),
+      preload_threads_(0),
+      checking_expiry_(false),
+      manual_compaction_(NULL),
+      bytes_flushed_(0) {
   mem_->Ref();
   has_imm_.Release_Store(NULL);
 
-  // Reserve ten files or so for other uses and give the rest to TableCache.
-  const int table_cache_size = options.max_open_files - 10;
+  // Reserve ten files or so for other uses and give the rest to TableCache,
+  // except for a share for BlobCache if large values go to blob files.
+  int table_cache_size = options.max_open_files - 10;
+  int blob_cache_size = 1;
+  if (options_.min_blob_size > 0) {
+    blob_cache_size = std::max(table_cache_size / 8, 1);
+    table_cache_size -= blob_cache_size;
+  }
+  table_cache_size_ = table_cache_size;
   table_cache_ = new TableCache(dbname_, &options_, table_cache_size);
+  blob_cache_ = new BlobCache(dbname_, &options_, blob_cache_size);
 
   versions_ = new VersionSet(dbname_, &options_, table_cache_,
                              &internal_comparator_);
@@ -147,11 +193,16 @@ DBImpl::~DBImpl() {
   // Wait for background work to finish
   mutex_.Lock();
   shutting_down_.Release_Store(this);  // Any non-NULL value is ok
-  while (bg_compaction_scheduled_) {
+  while (bg_compaction_scheduled_ || loading_cache_state_ ||
+         preload_threads_ > 0 || checking_expiry_) {
     bg_cv_.Wait();
   }
   mutex_.Unlock();
 
+  if (save_cache_state_) {
+    SaveCacheState();  // Ignore errors: the state only speeds up reopening
+  }
+
   if (db_lock_ != NULL) {
     env_->UnlockFile(db_lock_);
   }
@@ -160,9 +211,11 @@ DBImpl::~DBImpl() {
   if (mem_ != NULL) mem_->Unref();
   if (imm_ != NULL) imm_->Unref();
   delete tmp_batch_;
+  delete ttl_batch_;
   delete log_;
   delete logfile_;
   delete table_cache_;
+  delete blob_cache_;
 
   if (owns_info_log_) {
     delete options_.info_log;
@@ -242,6 +295,7 @@ void DBImpl::DeleteObsoleteFiles() {
           keep = (number >= versions_->ManifestFileNumber());
           break;
         case kTableFile:  // sstable 文件
+        case kBlobFile:
           keep = (live.find(number) != live.end());
           break;
         case kTempFile:
@@ -252,6 +306,7 @@ void DBImpl::DeleteObsoleteFiles() {
         case kCurrentFile:
         case kDBLockFile:
         case kInfoLogFile:
+        case kCacheStateFile:
           keep = true;
           break;
       }
@@ -259,6 +314,8 @@ void DBImpl::DeleteObsoleteFiles() {
       if (!keep) {
         if (type == kTableFile) {
           table_cache_->Evict(number);
+        } else if (type == kBlobFile) {
+          blob_cache_->Evict(number);
         }
         Log(options_.info_log, "Delete type=%d #%lld\n",
             int(type),
@@ -462,6 +519,11 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
   FileMetaData meta;
   meta.number = versions_->NewFileNumber();
   pending_outputs_.insert(meta.number);
+  BlobFileBuilder* blobs = NULL;
+  if (options_.min_blob_size > 0) {
+    blobs = new BlobFileBuilder(env_, dbname_, versions_->NewFileNumber());
+    pending_outputs_.insert(blobs->number());
+  }
   Iterator* iter = mem->NewIterator();
   Log(options_.info_log, "Level-0 table #%llu: started",
       (unsigned long long) meta.number);
@@ -470,7 +532,7 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
   {
     mutex_.Unlock();
     // 新建一个table builder负责写文件
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta, blobs);
     mutex_.Lock();
   }
 
@@ -488,17 +550,28 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
   if (s.ok() && meta.file_size > 0) {
     const Slice min_user_key = meta.smallest.user_key();
     const Slice max_user_key = meta.largest.user_key();
-    if (base != NULL) {
+    // Dynamic level sizes and universal compactions keep levels between
+    // level-0 and the base level empty.
+    if (base != NULL &&
+        options_.compaction_style == kCompactionStyleLevel &&
+        !options_.level_compaction_dynamic_level_bytes) {
       level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
     }
-    edit->AddFile(level, meta.number, meta.file_size,
-                  meta.smallest, meta.largest);
+    edit->AddFile(level, meta);
+    if (blobs != NULL && blobs->FileSize() > 0) {
+      edit->AddBlobFile(blobs->number(), blobs->FileSize());
+    }
+  }
+  if (blobs != NULL) {
+    pending_outputs_.erase(blobs->number());
+    delete blobs;
   }
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros;
   stats.bytes_written = meta.file_size;
   stats_[level].Add(stats);
+  bytes_flushed_ += meta.file_size;
   return s;
 }
 
@@ -674,7 +747,8 @@ Status DBImpl::BackgroundCompaction() {
   if (is_manual) {  // 手动触发compact
     ManualCompaction* m = manual_compaction_;
     c = versions_->CompactRange(m->level, m->begin, m->end);
-    m->done = (c == NULL);
+    // A universal merge takes whole runs, so it covers the entire range
+    m->done = (c == NULL || c->output_level() == c->level());
     if (c != NULL) {
       // 选择最大的一个key
       manual_end = c->input(0, c->num_input_files(0) - 1)->largest;
@@ -699,13 +773,12 @@ Status DBImpl::BackgroundCompaction() {
     assert(c->num_input_files(0) == 1);
     FileMetaData* f = c->input(0, 0);
     c->edit()->DeleteFile(c->level(), f->number);
-    c->edit()->AddFile(c->level() + 1, f->number, f->file_size,
-                       f->smallest, f->largest);
+    c->edit()->AddFile(c->output_level(), *f);
     status = versions_->LogAndApply(c->edit(), &mutex_);
     VersionSet::LevelSummaryStorage tmp;
     Log(options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
         static_cast<unsigned long long>(f->number),
-        c->level() + 1,
+        c->output_level(),
         static_cast<unsigned long long>(f->file_size),
         status.ToString().c_str(),
         versions_->LevelSummary(&tmp));
@@ -761,6 +834,11 @@ void DBImpl::CleanupCompaction(CompactionState* compact) {
     const CompactionState::Output& out = compact->outputs[i];
     pending_outputs_.erase(out.number);
   }
+  pending_outputs_.erase(compact->reserved_number);
+  if (compact->blobs != NULL) {
+    pending_outputs_.erase(compact->blobs->number());
+    delete compact->blobs;  // Deletes the file if it was not finished
+  }
   delete compact;
 }
 
@@ -770,10 +848,18 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   uint64_t file_number;
   {
     mutex_.Lock();
-    file_number = versions_->NewFileNumber();
+    if (compact->reserved_number != 0) {
+      file_number = compact->reserved_number;
+      compact->reserved_number = 0;
+    } else {
+      file_number = versions_->NewFileNumber();
+    }
     pending_outputs_.insert(file_number);
     CompactionState::Output out;
     out.number = file_number;
+    out.oldest_expiry = 0;
+    out.num_entries = 0;
+    out.num_deletions = 0;
     out.smallest.Clear();
     out.largest.Clear();
     compact->outputs.push_back(out);
@@ -782,7 +868,12 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
 
   // Make the output file
   std::string fname = TableFileName(dbname_, file_number);
-  Status s = env_->NewWritableFile(fname, &compact->outfile);
+  Status s;
+  if (options_.use_direct_io_for_flush_and_compaction) {
+    s = env_->NewDirectWritableFile(fname, &compact->outfile);
+  } else {
+    s = env_->NewWritableFile(fname, &compact->outfile);
+  }
   if (s.ok()) {
     compact->builder = new TableBuilder(options_, compact->outfile);
   }
@@ -829,6 +920,11 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
                                                current_bytes);
     s = iter->status();
     delete iter;
+    if (s.ok() && options_.prepopulate_block_cache &&
+        options_.block_cache != NULL) {
+      // Best effort: a failure only leaves the blocks uncached
+      table_cache_->LoadAllBlocks(output_number, current_bytes);
+    }
     if (s.ok()) {
       Log(options_.info_log,
           "Generated table #%llu: %lld keys, %lld bytes",
@@ -847,21 +943,140 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
       compact->compaction->num_input_files(0),
       compact->compaction->level(),
       compact->compaction->num_input_files(1),
-      compact->compaction->level() + 1,
+      compact->compaction->output_level(),
       static_cast<long long>(compact->total_bytes));
 
   // Add compaction outputs
   compact->compaction->AddInputDeletions(compact->compaction->edit());
-  const int level = compact->compaction->level();
+  const int level = compact->compaction->output_level();
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
-    compact->compaction->edit()->AddFile(
-        level + 1,
-        out.number, out.file_size, out.smallest, out.largest);
+    FileMetaData f;
+    f.number = out.number;
+    f.file_size = out.file_size;
+    f.smallest = out.smallest;
+    f.largest = out.largest;
+    f.oldest_expiry = out.oldest_expiry;
+    f.num_entries = out.num_entries;
+    f.num_deletions = out.num_deletions;
+    compact->compaction->edit()->AddFile(level, f);
+  }
+  if (compact->blobs != NULL && compact->blobs->FileSize() > 0) {
+    compact->compaction->edit()->AddBlobFile(compact->blobs->number(),
+                                             compact->blobs->FileSize());
+  }
+  for (std::map<uint64_t, uint64_t>::const_iterator it =
+           compact->blob_garbage.begin();
+       it != compact->blob_garbage.end(); ++it) {
+    compact->compaction->edit()->AddBlobGarbage(it->first, it->second);
   }
   return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
 }
 
+void DBImpl::AddBlobGarbage(CompactionState* compact, const Slice& index) {
+  BlobIndex handle;
+  if (handle.DecodeFrom(index)) {
+    compact->blob_garbage[handle.file_number] +=
+        handle.size + kBlobTrailerSize;
+  }
+}
+
+Status DBImpl::MaybeMoveValue(CompactionState* compact,
+                              const ParsedInternalKey& ikey,
+                              Slice* key, Slice* value,
+                              std::string* key_buf, std::string* index_buf,
+                              std::string* value_buf) {
+  Status s;
+  if (ikey.type == kTypeValue) {
+    if (options_.min_blob_size > 0 &&
+        value->size() >= options_.min_blob_size) {
+      // A large value written before blob files were enabled
+      s = compact->blobs->Add(*value, index_buf);
+      if (s.ok()) {
+        key_buf->clear();
+        AppendInternalKey(key_buf, ParsedInternalKey(
+            ikey.user_key, ikey.sequence, kTypeBlobIndex));
+        *key = *key_buf;
+        *value = *index_buf;
+      }
+    }
+  } else if (ikey.type == kTypeBlobIndex) {
+    BlobIndex handle;
+    if (handle.DecodeFrom(*value) &&
+        compact->compaction->ShouldMoveBlob(handle.file_number)) {
+      // Rescue the blob from a file that is mostly garbage
+      s = blob_cache_->Get(*value, value_buf);
+      if (s.ok()) {
+        s = compact->blobs->Add(*value_buf, index_buf);
+      }
+      if (s.ok()) {
+        AddBlobGarbage(compact, *value);
+        *value = *index_buf;
+      }
+    }
+  }
+  return s;
+}
+
+void DBImpl::TurnIntoDeletion(CompactionState* compact,
+                              ParsedInternalKey* ikey,
+                              Slice* key, Slice* value, bool* drop,
+                              std::string* key_buf) {
+  ikey->type = kTypeDeletion;
+  *value = Slice();
+  // Same rule as for deletion markers in DoCompactionWork()
+  if (ikey->sequence <= compact->smallest_snapshot &&
+      compact->compaction->IsBaseLevelForKey(ikey->user_key)) {
+    *drop = true;
+  } else {
+    key_buf->clear();
+    AppendInternalKey(key_buf, *ikey);
+    *key = *key_buf;
+  }
+}
+
+Status DBImpl::FilterValue(CompactionState* compact, ParsedInternalKey* ikey,
+                           Slice* key, Slice* value, bool* drop,
+                           std::string* key_buf, std::string* value_buf) {
+  Slice existing = *value;
+  std::string blob;
+  if (ikey->type == kTypeBlobIndex) {
+    Status s = blob_cache_->Get(*value, &blob);
+    if (!s.ok()) {
+      return s;
+    }
+    existing = blob;
+  } else if (options_.ttl > 0 && existing.size() >= kExpiryLength) {
+    existing.remove_suffix(kExpiryLength);
+  }
+  value_buf->clear();
+  bool value_changed = false;
+  const bool remove = options_.compaction_filter->Filter(
+      compact->compaction->level(), ikey->user_key, existing,
+      value_buf, &value_changed);
+  if (!remove && !value_changed) {
+    return Status::OK();
+  }
+
+  if (ikey->type == kTypeBlobIndex) {
+    AddBlobGarbage(compact, *value);
+  }
+  if (remove) {
+    TurnIntoDeletion(compact, ikey, key, value, drop, key_buf);
+  } else {
+    if (options_.ttl > 0) {
+      // The new value keeps the expiry time of the old one
+      PutFixed64(value_buf, ExtractExpiry(*value));
+    }
+    ikey->type = kTypeValue;
+    *value = *value_buf;
+    key_buf->clear();
+    AppendInternalKey(key_buf, *ikey);
+    *key = *key_buf;
+  }
+  return Status::OK();
+}
+
 // 正经做compact工作
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
   const uint64_t start_micros = env_->NowMicros();
@@ -871,7 +1086,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
       compact->compaction->num_input_files(0),
       compact->compaction->level(),
       compact->compaction->num_input_files(1),
-      compact->compaction->level() + 1);
+      compact->compaction->output_level());
 
   assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
   assert(compact->builder == NULL);
@@ -880,8 +1095,19 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     compact->smallest_snapshot = versions_->LastSequence();
   } else {
     compact->smallest_snapshot = snapshots_.oldest()->number_;
+    compact->newest_snapshot = snapshots_.newest()->number_;
+  }
+  compact->blobs = new BlobFileBuilder(env_, dbname_,
+                                       versions_->NewFileNumber());
+  pending_outputs_.insert(compact->blobs->number());
+  if (compact->compaction->output_level() == compact->compaction->level()) {
+    // Tables are searched in level-0 by file number, newest first
+    compact->reserved_number = versions_->NewFileNumber();
+    pending_outputs_.insert(compact->reserved_number);
   }
 
+  const uint64_t expiry_clock = ExpiryClock();
+
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
@@ -889,8 +1115,12 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   input->SeekToFirst();
   Status status;
   ParsedInternalKey ikey;
+  bool valid_key;
   std::string current_user_key;
   bool has_current_user_key = false;
+  std::string blob_key, blob_index, blob_value;
+  std::string filter_key, filter_value;
+  bool newest_for_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
   // 遍历所有input文件
   for (; input->Valid() && !shutting_down_.Acquire_Load(); ) {
@@ -921,7 +1151,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 
     // Handle key/value, add to state, etc.
     bool drop = false;
-    if (!ParseInternalKey(key, &ikey)) {
+    valid_key = ParseInternalKey(key, &ikey);
+    if (!valid_key) {
       // Do not hide error keys
       // decode失败，清除之前的状态
       current_user_key.clear();
@@ -961,6 +1192,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
       }
 
       // 保存这次的sequence
+      newest_for_key = (last_sequence_for_key == kMaxSequenceNumber);
       last_sequence_for_key = ikey.sequence;
     }
 #if 0
@@ -973,6 +1205,34 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
+    Slice value = input->value();
+    if (!drop && valid_key && expiry_clock != 0 &&
+        ikey.type == kTypeValue && IsExpired(value, expiry_clock)) {
+      // Reads treat an expired value like a deletion marker
+      TurnIntoDeletion(compact, &ikey, &key, &value, &drop, &filter_key);
+    }
+    if (!drop && valid_key && newest_for_key &&
+        options_.compaction_filter != NULL &&
+        (ikey.type == kTypeValue || ikey.type == kTypeBlobIndex) &&
+        ikey.sequence > compact->newest_snapshot) {
+      status = FilterValue(compact, &ikey, &key, &value, &drop,
+                           &filter_key, &filter_value);
+      if (!status.ok()) {
+        break;
+      }
+    }
+    if (drop) {
+      if (ikey.type == kTypeBlobIndex) {
+        AddBlobGarbage(compact, value);
+      }
+    } else if (valid_key) {
+      status = MaybeMoveValue(compact, ikey, &key, &value,
+                              &blob_key, &blob_index, &blob_value);
+      if (!status.ok()) {
+        break;
+      }
+    }
+
     if (!drop) {
       // 不需要drop掉的数据都写入builder中
       // Open output file if necessary
@@ -986,7 +1246,18 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         compact->current_output()->smallest.DecodeFrom(key);
       }
       compact->current_output()->largest.DecodeFrom(key);
-      compact->builder->Add(key, input->value());
+      compact->builder->Add(key, value);
+      compact->current_output()->num_entries++;
+      if (valid_key && ikey.type == kTypeDeletion) {
+        compact->current_output()->num_deletions++;
+      }
+      if (options_.ttl > 0 && valid_key && ikey.type == kTypeValue) {
+        const uint64_t expiry = ExtractExpiry(value);
+        uint64_t* oldest = &compact->current_output()->oldest_expiry;
+        if (expiry != 0 && (*oldest == 0 || expiry < *oldest)) {
+          *oldest = expiry;
+        }
+      }
 
       // Close output file if it is big enough
       // builder中的数据累计到一定大小时写入磁盘
@@ -1009,6 +1280,9 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 	  // 写入磁盘
     status = FinishCompactionOutputFile(compact, input);
   }
+  if (status.ok()) {
+    status = compact->blobs->Finish();
+  }
   if (status.ok()) {
     status = input->status();
   }
@@ -1025,10 +1299,11 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     stats.bytes_written += compact->outputs[i].file_size;
   }
+  stats.bytes_written += compact->blobs->FileSize();
 
   // 保存结果之前加锁
   mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
+  stats_[compact->compaction->output_level()].Add(stats);
 
   if (status.ok()) {
 	  // 保存compact结果
@@ -1060,10 +1335,12 @@ static void CleanupIteratorState(void* arg1, void* arg2) {
 }  // namespace
 
 Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
-                                      SequenceNumber* latest_snapshot) {
+                                      SequenceNumber* latest_snapshot,
+                                      uint32_t* seed) {
   IterState* cleanup = new IterState;
   mutex_.Lock();
   *latest_snapshot = versions_->LastSequence();
+  *seed = ++seed_;
 
   // Collect together all needed child iterators
   std::vector<Iterator*> list;
@@ -1093,7 +1370,8 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
 
 Iterator* DBImpl::TEST_NewInternalIterator() {
   SequenceNumber ignored;
-  return NewInternalIterator(ReadOptions(), &ignored);
+  uint32_t ignored_seed;
+  return NewInternalIterator(ReadOptions(), &ignored, &ignored_seed);
 }
 
 int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
@@ -1101,9 +1379,240 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
   return versions_->MaxNextLevelOverlappingBytes();
 }
 
+void DBImpl::TEST_WaitForCacheStateLoad() {
+  MutexLock l(&mutex_);
+  while (loading_cache_state_) {
+    bg_cv_.Wait();
+  }
+}
+
+void DBImpl::TEST_WaitForPreload() {
+  MutexLock l(&mutex_);
+  while (preload_threads_ > 0) {
+    bg_cv_.Wait();
+  }
+}
+
+// A CACHESTATE file is a log (see log_format.h) with one record per
+// table: the table's file number and size followed by the offsets of
+// its cached blocks, each stored as the delta from the previous one.
+static void EncodeCachedTable(const TableCache::CachedTable& table,
+                              std::string* dst) {
+  dst->clear();
+  PutVarint64(dst, table.number);
+  PutVarint64(dst, table.file_size);
+  uint64_t last = 0;
+  for (size_t i = 0; i < table.block_offsets.size(); i++) {
+    PutVarint64(dst, table.block_offsets[i] - last);
+    last = table.block_offsets[i];
+  }
+}
+
+static bool DecodeCachedTable(Slice input, TableCache::CachedTable* table) {
+  if (!GetVarint64(&input, &table->number) ||
+      !GetVarint64(&input, &table->file_size)) {
+    return false;
+  }
+  table->block_offsets.clear();
+  uint64_t offset = 0;
+  while (!input.empty()) {
+    uint64_t delta;
+    if (!GetVarint64(&input, &delta)) {
+      return false;
+    }
+    offset += delta;
+    table->block_offsets.push_back(offset);
+  }
+  return true;
+}
+
+Status DBImpl::SaveCacheState() {
+  std::vector<TableCache::CachedTable> tables;
+  table_cache_->GetCachedTables(&tables);
+
+  // Write to a temporary file and rename it into place, so that a
+  // crash leaves either the old or the new state behind.
+  uint64_t number;
+  {
+    MutexLock l(&mutex_);
+    number = versions_->NewFileNumber();
+    pending_outputs_.insert(number);
+  }
+  const std::string tmp = TempFileName(dbname_, number);
+  WritableFile* file;
+  Status s = env_->NewWritableFile(tmp, &file);
+  if (s.ok()) {
+    log::Writer writer(file);
+    std::string record;
+    for (size_t i = 0; s.ok() && i < tables.size(); i++) {
+      EncodeCachedTable(tables[i], &record);
+      s = writer.AddRecord(record);
+    }
+    if (s.ok()) {
+      s = file->Sync();
+    }
+    if (s.ok()) {
+      s = file->Close();
+    }
+    delete file;
+  }
+  if (s.ok()) {
+    s = env_->RenameFile(tmp, CacheStateFileName(dbname_));
+  }
+  if (!s.ok()) {
+    env_->DeleteFile(tmp);
+  }
+
+  MutexLock l(&mutex_);
+  pending_outputs_.erase(number);
+  return s;
+}
+
+void DBImpl::BGLoadCacheState(void* db) {
+  reinterpret_cast<DBImpl*>(db)->LoadCacheState();
+}
+
+void DBImpl::LoadCacheState() {
+  std::vector<TableCache::CachedTable> tables;
+  SequentialFile* file;
+  if (env_->NewSequentialFile(CacheStateFileName(dbname_), &file).ok()) {
+    // Records that fail their checksum are skipped: the state is a hint.
+    log::Reader reader(file, NULL, true/*checksum*/, 0/*initial_offset*/);
+    Slice record;
+    std::string scratch;
+    TableCache::CachedTable table;
+    while (reader.ReadRecord(&record, &scratch)) {
+      if (DecodeCachedTable(record, &table)) {
+        tables.push_back(table);
+      }
+    }
+    delete file;
+  }
+
+  // Tables that were compacted away since the state was saved are
+  // skipped.  Tables are loaded from the least recently used one on,
+  // so that if the caches are now smaller the hottest entries remain.
+  std::set<uint64_t> live;
+  {
+    MutexLock l(&mutex_);
+    versions_->AddLiveFiles(&live);
+  }
+  int loaded = 0;
+  for (size_t i = 0; i < tables.size(); i++) {
+
+    if (shutting_down_.Acquire_Load()) {
+      break;
+    }
+    if (live.count(tables[i].number) > 0 &&
+        table_cache_->LoadTable(tables[i]).ok()) {
+      loaded++;
+    }
+  }
+  if (!tables.empty()) {
+    Log(options_.info_log, "Loaded %d of %d tables from cache state",
+        loaded, static_cast<int>(tables.size()));
+  }
+
+  MutexLock l(&mutex_);
+  loading_cache_state_ = false;
+  bg_cv_.SignalAll();
+}
+
+void DBImpl::StartPreload() {
+  mutex_.AssertHeld();
+  Version* current = versions_->current();
+  for (int level = 0; level < config::kNumLevels; level++) {
+    std::vector<FileMetaData*> files;
+    current->GetOverlappingInputs(level, NULL, NULL, &files);
+    for (size_t i = 0; i < files.size(); i++) {
+      // Tables beyond the table cache's capacity would only push out
+      // the ones opened before them.
+      if (static_cast<int>(preload_files_.size()) < table_cache_size_) {
+        preload_files_.push_back(files[i]);
+      }
+    }
+  }
+  if (preload_files_.empty()) {
+    return;
+  }
+
+  // Table opens are dominated by read latency, so a few threads are
+  // worthwhile even on a single disk.
+  const int kPreloadThreads = 4;
+  preload_version_ = current;
+  preload_version_->Ref();
+  preload_threads_ = std::min(kPreloadThreads,
+                              static_cast<int>(preload_files_.size()));
+  for (int i = 0; i < preload_threads_; i++) {
+    env_->StartThread(&DBImpl::BGPreload, this);
+  }
+}
+
+void DBImpl::BGPreload(void* db) {
+  reinterpret_cast<DBImpl*>(db)->Preload();
+}
+
+void DBImpl::Preload() {
+  ReadOptions options;
+  options.verify_checksums = true;
+  options.fill_cache = false;
+  const bool verify = options_.paranoid_checks;
+
+  MutexLock l(&mutex_);
+  while (preload_next_ < preload_files_.size() &&
+         !shutting_down_.Acquire_Load()) {
+    // The files are kept alive by preload_version_.
+    const FileMetaData* f = preload_files_[preload_next_++];
+    mutex_.Unlock();
+    Iterator* iter = table_cache_->NewIterator(options, f->number,
+                                               f->file_size);
+    if (verify) {
+      for (iter->SeekToFirst();
+           iter->Valid() && !shutting_down_.Acquire_Load();
+           iter->Next()) {
+      }
+    }
+    Status s = iter->status();
+    delete iter;
+    mutex_.Lock();
+
+    if (!s.ok()) {
+      Log(options_.info_log, "Preloading table #%llu: %s",
+          static_cast<unsigned long long>(f->number), s.ToString().c_str());
+      if (verify && bg_error_.ok()) {
+        bg_error_ = s;
+      }
+    }
+  }
+
+  preload_threads_--;
+  if (preload_threads_ == 0) {
+    Log(options_.info_log, "Preloaded %d tables",
+        static_cast<int>(preload_next_));
+    preload_version_->Unref();
+    preload_version_ = NULL;
+    preload_files_.clear();
+    bg_cv_.SignalAll();
+  }
+}
+
 Status DBImpl::Get(const ReadOptions& options,
                    const Slice& key,
                    std::string* value) {
+  return GetImpl(options, key, value, NULL);
+}
+
+Status DBImpl::Get(const ReadOptions& options,
+                   const Slice& key,
+                   PinnableSlice* value) {
+  value->Reset();
+  return GetImpl(options, key, NULL, value);
+}
+
+Status DBImpl::GetImpl(const ReadOptions& options,
+                       const Slice& key,
+                       std::string* value,
+                       PinnableSlice* pinned) {
   Status s;
   MutexLock l(&mutex_);
   SequenceNumber snapshot;
@@ -1128,12 +1637,30 @@ Status DBImpl::Get(const ReadOptions& options,
     mutex_.Unlock();
     // First look in the memtable, then in the immutable memtable (if any).
     LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
-      // Done
-    } else if (imm != NULL && imm->Get(lkey, value, &s)) {
-      // Done
+    // Memtable entries are copied: memtables are not pinned by results.
+    std::string* mem_value = (value != NULL) ? value : pinned->GetSelf();
+    if (mem->Get(lkey, mem_value, &s) ||
+        (imm != NULL && imm->Get(lkey, mem_value, &s))) {
+      if (s.ok() && pinned != NULL) {
+        pinned->PinSelf();
+      }
     } else {
-      s = current->Get(options, lkey, value, &stats);
+      PinnableSlice result;
+      PinnableSlice* found = (pinned != NULL) ? pinned : &result;
+      bool is_blob_index;
+      s = current->Get(options, lkey, found, &stats, &is_blob_index);
+      if (s.ok() && is_blob_index) {
+        // The table only holds the location of the value
+        std::string index(found->data(), found->size());
+        found->Reset();
+        s = blob_cache_->Get(index, (pinned != NULL) ? pinned->GetSelf()
+                                                      : value);
+        if (s.ok() && pinned != NULL) {
+          pinned->PinSelf();
+        }
+      } else if (s.ok() && pinned == NULL) {
+        value->assign(result.data(), result.size());
+      }
       // 如果在memtable和imm table中都找不到,那么设置have_stat_update,因为是在磁盘中查找了
       have_stat_update = true;
     }
@@ -1147,17 +1674,184 @@ Status DBImpl::Get(const ReadOptions& options,
   mem->Unref();
   if (imm != NULL) imm->Unref();
   current->Unref();
+
+  if (s.ok() && options_.ttl > 0) {
+    Slice found = (pinned != NULL) ? Slice(*pinned) : Slice(*value);
+    if (IsExpired(found, ExpiryClock())) {
+      s = Status::NotFound(Slice());
+    } else if (found.size() >= kExpiryLength) {
+      if (pinned != NULL) {
+        pinned->remove_suffix(kExpiryLength);
+      } else {
+        value->resize(value->size() - kExpiryLength);
+      }
+    }
+  }
   return s;
 }
 
+std::vector<Status> DBImpl::MultiGet(const ReadOptions& options,
+                                     const std::vector<Slice>& keys,
+                                     std::vector<std::string>* values) {
+  const size_t n = keys.size();
+  std::vector<Status> statuses(n);
+  values->assign(n, std::string());
+
+  MutexLock l(&mutex_);
+  SequenceNumber snapshot;
+  if (options.snapshot != NULL) {
+    snapshot = reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_;
+  } else {
+    snapshot = versions_->LastSequence();
+  }
+
+  MemTable* mem = mem_;
+  MemTable* imm = imm_;
+  Version* current = versions_->current();
+  mem->Ref();
+  if (imm != NULL) imm->Ref();
+  current->Ref();
+
+  {
+    mutex_.Unlock();
+    // Keys that are not in the memtables are looked up in the tables
+    // all together.
+    std::vector<LookupKey*> table_keys;
+    std::vector<size_t> table_key_index;
+    for (size_t i = 0; i < n; i++) {
+      LookupKey* lkey = new LookupKey(keys[i], snapshot);
+      if (mem->Get(*lkey, &(*values)[i], &statuses[i]) ||
+          (imm != NULL && imm->Get(*lkey, &(*values)[i], &statuses[i]))) {
+        delete lkey;
+      } else {
+        table_keys.push_back(lkey);
+        table_key_index.push_back(i);
+      }
+    }
+    if (!table_keys.empty()) {
+      std::vector<std::string> found;
+      std::vector<Status> found_status;
+      std::vector<bool> is_blob_index;
+      current->MultiGet(options, table_keys, &found, &found_status,
+                        &is_blob_index);
+      for (size_t j = 0; j < table_keys.size(); j++) {
+        const size_t i = table_key_index[j];
+        statuses[i] = found_status[j];
+        if (statuses[i].ok() && is_blob_index[j]) {
+          statuses[i] = blob_cache_->Get(found[j], &(*values)[i]);
+        } else if (statuses[i].ok()) {
+          (*values)[i].swap(found[j]);
+        }
+        delete table_keys[j];
+      }
+    }
+    mutex_.Lock();
+  }
+
+  mem->Unref();
+  if (imm != NULL) imm->Unref();
+  current->Unref();
+
+  if (options_.ttl > 0) {
+    const uint64_t now = ExpiryClock();
+    for (size_t i = 0; i < n; i++) {
+      std::string* v = &(*values)[i];
+      if (!statuses[i].ok()) {
+        // Leave as is
+      } else if (IsExpired(*v, now)) {
+        statuses[i] = Status::NotFound(Slice());
+        v->clear();
+      } else if (v->size() >= kExpiryLength) {
+        v->resize(v->size() - kExpiryLength);
+      }
+    }
+  }
+  return statuses;
+}
+
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
-  Iterator* internal_iter = NewInternalIterator(options, &latest_snapshot);
+  uint32_t seed;
+  if (options.tailing) {
+    {
+      MutexLock l(&mutex_);
+      seed = ++seed_;
+    }
+    return NewTailingIterator(this, &dbname_, env_, &internal_comparator_,
+                              options, seed);
+  }
+  Iterator* internal_iter = NewInternalIterator(options, &latest_snapshot,
+                                                &seed);
   return NewDBIterator(
-      &dbname_, env_, user_comparator(), internal_iter,
+      this, &dbname_, env_, user_comparator(), internal_iter,
       (options.snapshot != NULL
        ? reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_
-       : latest_snapshot));
+       : latest_snapshot),
+      seed, options.iterate_lower_bound, options.iterate_upper_bound);
+}
+
+void DBImpl::RecordReadSample(Slice key) {
+  MutexLock l(&mutex_);
+  if (versions_->current()->RecordReadSample(key)) {
+    MaybeScheduleCompaction();
+  }
+}
+
+SequenceNumber DBImpl::RefreshReadState(MemTable** mem, MemTable** imm,
+                                        Version** version) {
+  MutexLock l(&mutex_);
+  if (*mem != mem_) {
+    if (*mem != NULL) (*mem)->Unref();
+    *mem = mem_;
+    mem_->Ref();
+  }
+  if (*imm != imm_) {
+    if (*imm != NULL) (*imm)->Unref();
+    *imm = imm_;
+    if (imm_ != NULL) imm_->Ref();
+  }
+  if (*version != versions_->current()) {
+    if (*version != NULL) (*version)->Unref();
+    *version = versions_->current();
+    (*version)->Ref();
+  }
+  return versions_->LastSequence();
+}
+
+uint64_t DBImpl::ExpiryClock() const {
+  return (options_.ttl > 0) ? env_->NowMicros() / 1000000 : 0;
+}
+
+void DBImpl::BGExpiryCheck(void* db) {
+  reinterpret_cast<DBImpl*>(db)->ExpiryCheck();
+}
+
+void DBImpl::ExpiryCheck() {
+  // Values expire without any writes, which would otherwise be what
+  // leads to compactions being scheduled.
+  MutexLock l(&mutex_);
+  for (int ticks = 1; !shutting_down_.Acquire_Load(); ticks++) {
+    mutex_.Unlock();
+    env_->SleepForMicroseconds(100000);  // Short, not to delay closing
+    mutex_.Lock();
+    if (ticks % 10 == 0) {
+      MaybeScheduleCompaction();
+    }
+  }
+  checking_expiry_ = false;
+  bg_cv_.SignalAll();
+}
+
+Status DBImpl::GetBlob(const Slice& index, std::string* value) {
+  return blob_cache_->Get(index, value);
+}
+
+void DBImpl::ReleaseReadState(MemTable* mem, MemTable* imm,
+                              Version* version) {
+  MutexLock l(&mutex_);
+  if (mem != NULL) mem->Unref();
+  if (imm != NULL) imm->Unref();
+  if (version != NULL) version->Unref();
 }
 
 const Snapshot* DBImpl::GetSnapshot() {
@@ -1216,8 +1910,16 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
     {
       // 因为前面已经把批量操作的元素加进来了,这个比较慢的写过程就解锁,后面需要操作写队列的时候再进行加锁
       mutex_.Unlock();
+      if (options_.ttl > 0) {
+        status = WriteBatchInternal::AppendExpiry(
+            updates, ExpiryClock() + options_.ttl, ttl_batch_);
+        if (updates == tmp_batch_) tmp_batch_->Clear();
+        updates = ttl_batch_;
+      }
       // 向log中添加记录
-      status = log_->AddRecord(WriteBatchInternal::Contents(updates));
+      if (status.ok()) {
+        status = log_->AddRecord(WriteBatchInternal::Contents(updates));
+      }
       if (status.ok() && options.sync) {
         status = logfile_->Sync();
       }
@@ -1228,6 +1930,7 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
       mutex_.Lock();
     }
     if (updates == tmp_batch_) tmp_batch_->Clear();
+    if (updates == ttl_batch_) ttl_batch_->Clear();
     // 更新last sequence
     versions_->SetLastSequence(last_sequence);
   }
@@ -1324,7 +2027,8 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       break;
     } else if (
         allow_delay &&
-        versions_->NumLevelFiles(0) >= config::kL0_SlowdownWritesTrigger) {
+        versions_->NumLevelFiles(0) >=
+            options_.level0_slowdown_writes_trigger) {
       // 允许延迟而且0级文件大于某个值的情况下等待1秒
       // We are getting close to hitting a hard limit on the number of
       // L0 files.  Rather than delaying a single write by several
@@ -1353,7 +2057,8 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // one is still being compacted, so we wait.
       // 前面还有imm table等待着compact
       bg_cv_.Wait();
-    } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
+    } else if (versions_->NumLevelFiles(0) >=
+               options_.level0_stop_writes_trigger) {
       // There are too many level-0 files.
       Log(options_.info_log, "waiting...\n");
       // 太多0级文件了,等待
@@ -1437,15 +2142,84 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
         value->append(buf);
       }
     }
+    if (bytes_flushed_ > 0) {
+      // Bytes written by flushes and compactions per byte flushed
+      int64_t bytes_written = 0;
+      for (int level = 0; level < config::kNumLevels; level++) {
+        bytes_written += stats_[level].bytes_written;
+      }
+      snprintf(buf, sizeof(buf), "Write amplification: %.2f\n",
+               static_cast<double>(bytes_written) / bytes_flushed_);
+      value->append(buf);
+    }
     return true;
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
+  } else if (in == "block-cache-stats") {
+    options_.block_cache->GetStats(value);
+    return true;
   }
 
   return false;
 }
 
+Status DBImpl::SetOptions(
+    const std::map<std::string, std::string>& new_options) {
+  MutexLock l(&mutex_);
+  Options updated = options_;
+  for (std::map<std::string, std::string>::const_iterator it =
+           new_options.begin();
+       it != new_options.end(); ++it) {
+    const std::string& name = it->first;
+    Slice in = it->second;
+    uint64_t value;
+    if (!ConsumeDecimalNumber(&in, &value) || !in.empty() ||
+        value > (1 << 30)) {
+      return Status::InvalidArgument(name, it->second);
+    }
+    const int v = static_cast<int>(value);
+    if (name == "level0_file_num_compaction_trigger" && v >= 1) {
+      updated.level0_file_num_compaction_trigger = v;
+    } else if (name == "level0_slowdown_writes_trigger" && v >= 1) {
+      updated.level0_slowdown_writes_trigger = v;
+    } else if (name == "level0_stop_writes_trigger" && v >= 1) {
+      updated.level0_stop_writes_trigger = v;
+    } else if (name == "max_mem_compaction_level" &&
+               v < options_.num_levels) {
+      updated.max_mem_compaction_level = v;
+    } else if (name == "max_file_size" && v >= (1 << 20)) {
+      updated.max_file_size = v;
+    } else if (name == "max_grandparent_overlap_factor" && v >= 1) {
+      updated.max_grandparent_overlap_factor = v;
+    } else if (name == "expanded_compaction_factor" && v >= 1) {
+      updated.expanded_compaction_factor = v;
+    } else {
+      return Status::InvalidArgument("cannot set " + name, it->second);
+    }
+    Log(options_.info_log, "Setting option %s to %s",
+        name.c_str(), it->second.c_str());
+  }
+
+  // Only the fields above change: the others are read without mutex_.
+  options_.level0_file_num_compaction_trigger =
+      updated.level0_file_num_compaction_trigger;
+  options_.level0_slowdown_writes_trigger =
+      updated.level0_slowdown_writes_trigger;
+  options_.level0_stop_writes_trigger = updated.level0_stop_writes_trigger;
+  options_.max_mem_compaction_level = updated.max_mem_compaction_level;
+  options_.max_file_size = updated.max_file_size;
+  options_.max_grandparent_overlap_factor =
+      updated.max_grandparent_overlap_factor;
+  options_.expanded_compaction_factor = updated.expanded_compaction_factor;
+
+  // Compactions that are running keep the values they started with.
+  versions_->UpdateCompactionScore();
+  MaybeScheduleCompaction();
+  bg_cv_.SignalAll();  // Writers waiting for level-0 may now proceed
+  return Status::OK();
+}
+
 void DBImpl::GetApproximateSizes(
     const Range* range, int n,
     uint64_t* sizes) {
@@ -1472,6 +2246,123 @@ void DBImpl::GetApproximateSizes(
   }
 }
 
+void DBImpl::GetRangeSplits(const Slice* begin, const Slice* end, int n,
+                            std::vector<std::string>* split_keys) {
+  Version* v;
+  {
+    MutexLock l(&mutex_);
+    versions_->current()->Ref();
+    v = versions_->current();
+  }
+
+  v->GetRangeSplits(begin, end, n, split_keys);
+
+  {
+    MutexLock l(&mutex_);
+    v->Unref();
+  }
+}
+
+namespace {
+// State shared by the threads of a ParallelScan().
+struct ParallelScanState {
+  DB* db;
+  ReadOptions options;
+  ScanVisitor* visitor;
+  port::AtomicPointer stop;   // Non-NULL once all threads should stop
+  port::Mutex mu;
+  port::CondVar cv;
+  int remaining;              // Number of parts still being scanned
+  Status status;              // First error hit by any thread
+
+  ParallelScanState() : cv(&mu) { }
+};
+
+// One part of a ParallelScan() and the thread scanning it.
+struct ScanPart {
+  ParallelScanState* state;
+  int index;
+  const Slice* lower;         // NULL if unbounded
+  const Slice* upper;         // NULL if unbounded
+};
+
+static void ScanPartThread(void* arg) {
+  ScanPart* part = reinterpret_cast<ScanPart*>(arg);
+  ParallelScanState* state = part->state;
+  ReadOptions options = state->options;
+  options.iterate_lower_bound = part->lower;
+  options.iterate_upper_bound = part->upper;
+  Iterator* iter = state->db->NewIterator(options);
+  for (iter->SeekToFirst();
+       iter->Valid() && state->stop.Acquire_Load() == NULL;
+       iter->Next()) {
+    if (!state->visitor->Visit(part->index, iter->key(), iter->value())) {
+      state->stop.Release_Store(state);
+    }
+  }
+  Status s = iter->status();
+  delete iter;
+
+  MutexLock l(&state->mu);
+  if (!s.ok()) {
+    if (state->status.ok()) {
+      state->status = s;
+    }
+    state->stop.Release_Store(state);
+  }
+  state->remaining--;
+  if (state->remaining == 0) {
+    state->cv.SignalAll();
+  }
+}
+}  // namespace
+
+Status DBImpl::ParallelScan(const ReadOptions& options,
+                            const Slice* begin, const Slice* end,
+                            int parallelism, ScanVisitor* visitor) {
+  std::vector<std::string> splits;
+  GetRangeSplits(begin, end, parallelism, &splits);
+  std::vector<Slice> split_keys(splits.begin(), splits.end());
+
+  ParallelScanState state;
+  state.db = this;
+  state.options = options;
+  state.options.tailing = false;
+  state.visitor = visitor;
+  state.stop.Release_Store(NULL);
+  const Snapshot* snapshot = NULL;
+  if (options.snapshot == NULL) {
+    snapshot = GetSnapshot();
+    state.options.snapshot = snapshot;
+  }
+
+  // The calling thread scans the first part itself.
+  const int n = split_keys.size() + 1;
+  std::vector<ScanPart> parts(n);
+  state.remaining = n;
+  for (int i = 0; i < n; i++) {
+    parts[i].state = &state;
+    parts[i].index = i;
+    parts[i].lower = (i == 0) ? begin : &split_keys[i - 1];
+    parts[i].upper = (i == n - 1) ? end : &split_keys[i];
+  }
+  for (int i = 1; i < n; i++) {
+    env_->StartThread(&ScanPartThread, &parts[i]);
+  }
+  ScanPartThread(&parts[0]);
+  {
+    MutexLock l(&state.mu);
+    while (state.remaining > 0) {
+      state.cv.Wait();
+    }
+  }
+
+  if (snapshot != NULL) {
+    ReleaseSnapshot(snapshot);
+  }
+  return state.status;
+}
+
 // Default implementations of convenience methods that subclasses of DB
 // can call if they wish
 Status DB::Put(const WriteOptions& opt, const Slice& key, const Slice& value) {
@@ -1480,17 +2371,60 @@ Status DB::Put(const WriteOptions& opt, const Slice& key, const Slice& value) {
   return Write(opt, &batch);
 }
 
+Status DB::Get(const ReadOptions& options, const Slice& key,
+               PinnableSlice* value) {
+  value->Reset();
+  Status s = Get(options, key, value->GetSelf());
+  if (s.ok()) {
+    value->PinSelf();
+  }
+  return s;
+}
+
+std::vector<Status> DB::MultiGet(const ReadOptions& options,
+                                 const std::vector<Slice>& keys,
+                                 std::vector<std::string>* values) {
+  std::vector<Status> statuses(keys.size());
+  values->assign(keys.size(), std::string());
+  for (size_t i = 0; i < keys.size(); i++) {
+    statuses[i] = Get(options, keys[i], &(*values)[i]);
+  }
+  return statuses;
+}
+
 Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   WriteBatch batch;
   batch.Delete(key);
   return Write(opt, &batch);
 }
 
+Status DB::SaveCacheState() {
+  return Status::NotSupported("SaveCacheState");
+}
+
+Status DB::SetOptions(const std::map<std::string, std::string>& new_options) {
+  return Status::NotSupported("SetOptions");
+}
+
+void DB::GetRangeSplits(const Slice* begin, const Slice* end, int n,
+                        std::vector<std::string>* split_keys) {
+  split_keys->clear();
+}
+
+Status DB::ParallelScan(const ReadOptions& options,
+                        const Slice* begin, const Slice* end,
+                        int parallelism, ScanVisitor* visitor) {
+  return Status::NotSupported("ParallelScan");
+}
+
 DB::~DB() { }
 
 Status DB::Open(const Options& options, const std::string& dbname,
                 DB** dbptr) {
   *dbptr = NULL;
+  if (options.ttl > 0 && options.min_blob_size > 0) {
+    return Status::InvalidArgument("ttl cannot be combined with blob files");
+  }
 
   DBImpl* impl = new DBImpl(options, dbname);
   impl->mutex_.Lock();
@@ -1512,6 +2446,18 @@ Status DB::Open(const Options& options, const std::string& dbname,
       impl->DeleteObsoleteFiles();
       impl->MaybeScheduleCompaction();
     }
+    if (s.ok() && options.persist_cache_state) {
+      impl->save_cache_state_ = true;
+      impl->loading_cache_state_ = true;
+      options.env->StartThread(&DBImpl::BGLoadCacheState, impl);
+    }
+    if (s.ok() && options.preload_tables) {
+      impl->StartPreload();
+    }
+    if (s.ok() && options.ttl > 0) {
+      impl->checking_expiry_ = true;
+      options.env->StartThread(&DBImpl::BGExpiryCheck, impl);
+    }
   }
   impl->mutex_.Unlock();
   if (s.ok()) {
@@ -1525,6 +2471,9 @@ Status DB::Open(const Options& options, const std::string& dbname,
 Snapshot::~Snapshot() {
 }
 
+ScanVisitor::~ScanVisitor() {
+}
+
 Status DestroyDB(const std::string& dbname, const Options& options) {
   Env* env = options.env;
   std::vector<std::string> filenames;
@@ -7,6 +7,7 @@
 
 #include <deque>
 #include <set>
+#include <vector>
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
@@ -17,6 +18,8 @@
 
 namespace leveldb {
 
+class BlobCache;
+struct FileMetaData;
 class MemTable;
 class TableCache;
 class Version;
@@ -35,12 +38,26 @@ class DBImpl : public DB {
   virtual Status Get(const ReadOptions& options,
                      const Slice& key,
                      std::string* value);
+  virtual Status Get(const ReadOptions& options,
+                     const Slice& key,
+                     PinnableSlice* value);
+  virtual std::vector<Status> MultiGet(const ReadOptions& options,
+                                       const std::vector<Slice>& keys,
+                                       std::vector<std::string>* values);
   virtual Iterator* NewIterator(const ReadOptions&);
   virtual const Snapshot* GetSnapshot();
   virtual void ReleaseSnapshot(const Snapshot* snapshot);
   virtual bool GetProperty(const Slice& property, std::string* value);
   virtual void GetApproximateSizes(const Range* range, int n, uint64_t* sizes);
   virtual void CompactRange(const Slice* begin, const Slice* end);
+  virtual Status SaveCacheState();
+  virtual Status SetOptions(
+      const std::map<std::string, std::string>& new_options);
+  virtual void GetRangeSplits(const Slice* begin, const Slice* end, int n,
+                              std::vector<std::string>* split_keys);
+  virtual Status ParallelScan(const ReadOptions& options,
+                              const Slice* begin, const Slice* end,
+                              int parallelism, ScanVisitor* visitor);
 
   // Extra methods (for testing) that are not in the public DB interface
 
@@ -59,13 +76,50 @@ class DBImpl : public DB {
   // file at a level >= 1.
   int64_t TEST_MaxNextLevelOverlappingBytes();
 
+  // Wait until the caches have been loaded from the state saved by an
+  // earlier incarnation of the DB.
+  void TEST_WaitForCacheStateLoad();
+
+  // Wait until the threads started by Options::preload_tables are done.
+  void TEST_WaitForPreload();
+
+  // Record a sample of bytes read at the specified internal key.
+  // Samples are taken approximately once every config::kReadBytesPeriod
+  // bytes.
+  void RecordReadSample(Slice key);
+
+  // Bring an iterator's view of the DB up to date: unless *mem, *imm
+  // and *version (which may be NULL) are still the current memtable,
+  // immutable memtable and version, release them and store Ref()-ed
+  // current ones instead.  Returns the last sequence number.
+  SequenceNumber RefreshReadState(MemTable** mem, MemTable** imm,
+                                  Version** version);
+
+  // Store in *value the value that the encoded BlobIndex "index" of a
+  // kTypeBlobIndex entry points to.
+  Status GetBlob(const Slice& index, std::string* value);
+
+  // If options.ttl is set, return the current time in seconds since the
+  // epoch, against which the expiry times of values are checked.
+  // Otherwise return zero.
+  uint64_t ExpiryClock() const;
+
+  // Release the state obtained through RefreshReadState().
+  void ReleaseReadState(MemTable* mem, MemTable* imm, Version* version);
+
  private:
   friend class DB;
   struct CompactionState;
   struct Writer;
 
   Iterator* NewInternalIterator(const ReadOptions&,
-                                SequenceNumber* latest_snapshot);
+                                SequenceNumber* latest_snapshot,
+                                uint32_t* seed);
+
+  // Shared implementation of the Get() variants.  Exactly one of
+  // "value" and "pinned" is non-NULL.
+  Status GetImpl(const ReadOptions& options, const Slice& key,
+                 std::string* value, PinnableSlice* pinned);
 
   Status NewDB();
 
@@ -105,23 +159,74 @@ class DBImpl : public DB {
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Body of the thread that reads the tables and blocks listed in the
+  // CACHESTATE file back into the caches after the DB is opened.
+  static void BGLoadCacheState(void* db);
+  void LoadCacheState();
+
+  // Start the threads that open (and if paranoid_checks is set, verify)
+  // the tables of the current version, for Options::preload_tables.
+  void StartPreload() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  static void BGPreload(void* db);
+  void Preload();
+
+  // Body of the thread that, for Options::ttl, regularly checks whether
+  // tables hold values that have expired since the last compaction.
+  static void BGExpiryCheck(void* db);
+  void ExpiryCheck();
+
   Status OpenCompactionOutputFile(CompactionState* compact);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
   Status InstallCompactionResults(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Account for the blob that the encoded BlobIndex "index" of an entry
+  // dropped or moved by the compaction pointed to.
+  void AddBlobGarbage(CompactionState* compact, const Slice& index);
+
+  // Before the entry (*key, *value) is copied by a compaction, move a
+  // large value to the compaction's blob file, or a blob out of a blob
+  // file that is mostly garbage.  Updates *key and *value if so, using
+  // the buffers for storage.
+  Status MaybeMoveValue(CompactionState* compact,
+                        const ParsedInternalKey& ikey,
+                        Slice* key, Slice* value,
+                        std::string* key_buf, std::string* index_buf,
+                        std::string* value_buf);
+
+  // Turn the entry (*key, *value) of a compaction into a deletion
+  // marker with the same sequence number, using key_buf for storage, or
+  // set *drop if no deletion marker is needed.
+  void TurnIntoDeletion(CompactionState* compact, ParsedInternalKey* ikey,
+                        Slice* key, Slice* value, bool* drop,
+                        std::string* key_buf);
+
+  // Pass the live entry (*key, *value) of a compaction to
+  // options_.compaction_filter.  Updates *ikey, *key and *value if the
+  // filter replaced the value or removed the key, using the buffers for
+  // storage, and sets *drop if the entry can be dropped altogether.
+  Status FilterValue(CompactionState* compact, ParsedInternalKey* ikey,
+                     Slice* key, Slice* value, bool* drop,
+                     std::string* key_buf, std::string* value_buf);
+
   // Constant after construction
   Env* const env_;
   const InternalKeyComparator internal_comparator_;
   const InternalFilterPolicy internal_filter_policy_;
-  const Options options_;  // options_.comparator == &internal_comparator_
+  // options_.comparator == &internal_comparator_.  The options that
+  // DB::SetOptions() can change are only accessed while mutex_ is held.
+  Options options_;
   bool owns_info_log_;
   bool owns_cache_;
+  bool save_cache_state_;  // Set once the DB is open iff it saves on close
   const std::string dbname_;
 
   // table_cache_ provides its own synchronization
   TableCache* table_cache_;
 
+  // blob_cache_ provides its own synchronization
+  BlobCache* blob_cache_;
+
   // Lock over the persistent DB state.  Non-NULL iff successfully acquired.
   FileLock* db_lock_;
 
@@ -139,9 +244,12 @@ class DBImpl : public DB {
   // Queue of writers.
   std::deque<Writer*> writers_;
   WriteBatch* tmp_batch_;
+  WriteBatch* ttl_batch_;   // The batch being written, with expiry times
 
   SnapshotList snapshots_;
 
+  uint32_t seed_;                // For sampling.
+
   // Set of table files to protect from deletion because they are
   // part of ongoing compactions.
   std::set<uint64_t> pending_outputs_;
@@ -149,6 +257,20 @@ class DBImpl : public DB {
   // Has a background compaction been scheduled or is running?
   bool bg_compaction_scheduled_;
 
+  // Is the thread that loads the cache state still running?
+  bool loading_cache_state_;
+
+  // Tables left for the preload threads to open, and the version they
+  // belong to, which is kept alive until the last thread is done.
+  int table_cache_size_;
+  Version* preload_version_;
+  std::vector<FileMetaData*> preload_files_;
+  size_t preload_next_;
+  int preload_threads_;  // Preload threads still running
+
+  // Is the thread for Options::ttl running?
+  bool checking_expiry_;
+
   // Information for a manual compaction
   struct ManualCompaction {
     int level;
@@ -180,6 +302,7 @@ class DBImpl : public DB {
     }
   };
   CompactionStats stats_[config::kNumLevels];
+  int64_t bytes_flushed_;  // Bytes of tables written from memtables
 
   // No copying allowed
   DBImpl(const DBImpl&);
@@ -4,6 +4,7 @@
 
 #include "db/db_iter.h"
 
+#include "db/db_impl.h"
 #include "db/filename.h"
 #include "db/dbformat.h"
 #include "leveldb/env.h"
@@ -11,6 +12,7 @@
 #include "port/port.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/random.h"
 
 namespace leveldb {
 
@@ -46,15 +48,24 @@ class DBIter: public Iterator {
     kReverse
   };
 
-  DBIter(const std::string* dbname, Env* env,
-         const Comparator* cmp, Iterator* iter, SequenceNumber s)
-      : dbname_(dbname),
+  DBIter(DBImpl* db, const std::string* dbname, Env* env,
+         const Comparator* cmp, Iterator* iter, SequenceNumber s,
+         uint32_t seed, const Slice* lower_bound, const Slice* upper_bound)
+      : db_(db),
+        dbname_(dbname),
         env_(env),
         user_comparator_(cmp),
         iter_(iter),
         sequence_(s),
+        lower_bound_(lower_bound),
+        upper_bound_(upper_bound),
+        expiry_clock_(db->ExpiryClock()),
         direction_(kForward),
-        valid_(false) {
+        valid_(false),
+        is_blob_index_(false),
+        blob_loaded_(false),
+        rnd_(seed),
+        bytes_counter_(RandomPeriod()) {
   }
   virtual ~DBIter() {
     delete iter_;
@@ -66,7 +77,22 @@ class DBIter: public Iterator {
   }
   virtual Slice value() const {
     assert(valid_);
-    return (direction_ == kForward) ? iter_->value() : saved_value_;
+    Slice raw = (direction_ == kForward) ? iter_->value() : saved_value_;
+    if (!is_blob_index_) {
+      if (expiry_clock_ != 0 && raw.size() >= kExpiryLength) {
+        raw.remove_suffix(kExpiryLength);
+      }
+      return raw;
+    }
+    // Only read the blob once the caller asks for it.
+    if (!blob_loaded_) {
+      Status s = db_->GetBlob(raw, &blob_value_);
+      if (!s.ok() && status_.ok()) {
+        status_ = s;
+      }
+      blob_loaded_ = true;
+    }
+    return blob_value_;
   }
   virtual Status status() const {
     if (status_.ok()) {
@@ -87,10 +113,31 @@ class DBIter: public Iterator {
   void FindPrevUserEntry();
   bool ParseKey(ParsedInternalKey* key);
 
+  bool BelowLowerBound(const Slice& user_key) const {
+    return (lower_bound_ != NULL &&
+            user_comparator_->Compare(user_key, *lower_bound_) < 0);
+  }
+  bool AtOrAboveUpperBound(const Slice& user_key) const {
+    return (upper_bound_ != NULL &&
+            user_comparator_->Compare(user_key, *upper_bound_) >= 0);
+  }
+
+  // Return true iff the current entry "ikey" is a value that has
+  // expired, which reads like a deletion marker.
+  bool IsExpiredValue(const ParsedInternalKey& ikey) const {
+    return (expiry_clock_ != 0 && ikey.type == kTypeValue &&
+            IsExpired(iter_->value(), expiry_clock_));
+  }
+
   inline void SaveKey(const Slice& k, std::string* dst) {
     dst->assign(k.data(), k.size());
   }
 
+  // Pick next gap with average value of config::kReadBytesPeriod.
+  ssize_t RandomPeriod() {
+    return rnd_.Uniform(2*config::kReadBytesPeriod);
+  }
+
   inline void ClearSavedValue() {
     if (saved_value_.capacity() > 1048576) {
       std::string empty;
@@ -100,17 +147,27 @@ class DBIter: public Iterator {
     }
   }
 
+  DBImpl* db_;
   const std::string* const dbname_;
   Env* const env_;
   const Comparator* const user_comparator_;
   Iterator* const iter_;
   SequenceNumber const sequence_;
+  const Slice* const lower_bound_;   // NULL if there is no lower bound
+  const Slice* const upper_bound_;   // NULL if there is no upper bound
+  const uint64_t expiry_clock_;      // See DBImpl::ExpiryClock()
 
-  Status status_;
+  mutable Status status_;
   std::string saved_key_;     // == current key when direction_==kReverse
   std::string saved_value_;   // == current raw value when direction_==kReverse
   Direction direction_;
   bool valid_;
+  bool is_blob_index_;        // The raw value is an encoded BlobIndex
+  mutable bool blob_loaded_;  // blob_value_ holds the current blob
+  mutable std::string blob_value_;
+
+  Random rnd_;
+  ssize_t bytes_counter_;
 
   // No copying allowed
   DBIter(const DBIter&);
@@ -118,7 +175,14 @@ class DBIter: public Iterator {
 };
 
 inline bool DBIter::ParseKey(ParsedInternalKey* ikey) {
-  if (!ParseInternalKey(iter_->key(), ikey)) {
+  Slice k = iter_->key();
+  ssize_t n = k.size() + iter_->value().size();
+  bytes_counter_ -= n;
+  while (bytes_counter_ < 0) {
+    bytes_counter_ += RandomPeriod();
+    db_->RecordReadSample(k);
+  }
+  if (!ParseInternalKey(k, ikey)) {
     status_ = Status::Corruption("corrupted internal key in DBIter");
     return false;
   } else {
@@ -158,7 +222,13 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   assert(direction_ == kForward);
   do {
     ParsedInternalKey ikey;
-    if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+    const bool parsed = ParseKey(&ikey);
+    if (parsed && AtOrAboveUpperBound(ikey.user_key)) {
+      // Everything from here on is out of range: stop instead of
+      // skipping over it.
+      break;
+    }
+    if (parsed && ikey.sequence <= sequence_) {
       switch (ikey.type) {
         case kTypeDeletion:
           // Arrange to skip all upcoming entries for this key since
@@ -167,11 +237,18 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
           skipping = true;
           break;
         case kTypeValue:
+        case kTypeBlobIndex:
           if (skipping &&
               user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
             // Entry hidden
+          } else if (IsExpiredValue(ikey)) {
+            // Hides the upcoming entries like a deletion
+            SaveKey(ikey.user_key, skip);
+            skipping = true;
           } else {
             valid_ = true;
+            is_blob_index_ = (ikey.type == kTypeBlobIndex);
+            blob_loaded_ = false;
             saved_key_.clear();
             return;
           }
@@ -218,13 +295,18 @@ void DBIter::FindPrevUserEntry() {
   if (iter_->Valid()) {
     do {
       ParsedInternalKey ikey;
-      if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+      const bool parsed = ParseKey(&ikey);
+      if (parsed && BelowLowerBound(ikey.user_key)) {
+        // Everything from here on is out of range.
+        break;
+      }
+      if (parsed && ikey.sequence <= sequence_) {
         if ((value_type != kTypeDeletion) &&
             user_comparator_->Compare(ikey.user_key, saved_key_) < 0) {
           // We encountered a non-deleted value in entries for previous keys,
           break;
         }
-        value_type = ikey.type;
+        value_type = IsExpiredValue(ikey) ? kTypeDeletion : ikey.type;
         if (value_type == kTypeDeletion) {
           saved_key_.clear();
           ClearSavedValue();
@@ -250,6 +332,8 @@ void DBIter::FindPrevUserEntry() {
     direction_ = kForward;
   } else {
     valid_ = true;
+    is_blob_index_ = (value_type == kTypeBlobIndex);
+    blob_loaded_ = false;
   }
 }
 
@@ -257,8 +341,9 @@ void DBIter::Seek(const Slice& target) {
   direction_ = kForward;
   ClearSavedValue();
   saved_key_.clear();
+  const Slice& start = BelowLowerBound(target) ? *lower_bound_ : target;
   AppendInternalKey(
-      &saved_key_, ParsedInternalKey(target, sequence_, kValueTypeForSeek));
+      &saved_key_, ParsedInternalKey(start, sequence_, kValueTypeForSeek));
   iter_->Seek(saved_key_);
   if (iter_->Valid()) {
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
@@ -268,6 +353,10 @@ void DBIter::Seek(const Slice& target) {
 }
 
 void DBIter::SeekToFirst() {
+  if (lower_bound_ != NULL) {
+    Seek(*lower_bound_);
+    return;
+  }
   direction_ = kForward;
   ClearSavedValue();
   iter_->SeekToFirst();
@@ -281,19 +370,38 @@ void DBIter::SeekToFirst() {
 void DBIter::SeekToLast() {
   direction_ = kReverse;
   ClearSavedValue();
-  iter_->SeekToLast();
+  if (upper_bound_ != NULL) {
+    // Step back from the first entry at or above the bound.
+    saved_key_.clear();
+    AppendInternalKey(&saved_key_, ParsedInternalKey(
+        *upper_bound_, kMaxSequenceNumber, kValueTypeForSeek));
+    iter_->Seek(saved_key_);
+    saved_key_.clear();
+    if (iter_->Valid()) {
+      iter_->Prev();
+    } else {
+      iter_->SeekToLast();
+    }
+  } else {
+    iter_->SeekToLast();
+  }
   FindPrevUserEntry();
 }
 
 }  // anonymous namespace
 
 Iterator* NewDBIterator(
+    DBImpl* db,
     const std::string* dbname,
     Env* env,
     const Comparator* user_key_comparator,
     Iterator* internal_iter,
-    const SequenceNumber& sequence) {
-  return new DBIter(dbname, env, user_key_comparator, internal_iter, sequence);
+    const SequenceNumber& sequence,
+    uint32_t seed,
+    const Slice* lower_bound,
+    const Slice* upper_bound) {
+  return new DBIter(db, dbname, env, user_key_comparator, internal_iter,
+                    sequence, seed, lower_bound, upper_bound);
 }
 
 }  // namespace leveldb
@@ -11,15 +11,27 @@
 
 namespace leveldb {
 
+class DBImpl;
+
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
+// into appropriate user keys.  About once every config::kReadBytesPeriod
+// bytes read, the key being read is reported to db->RecordReadSample();
+// "seed" seeds the choice of the sampled keys.  Values that have expired
+// (see Options::ttl) read as deleted.
+//
+// Only user keys >= *lower_bound and < *upper_bound are returned; a NULL
+// bound imposes no limit.  The bounds must outlive the iterator.
 extern Iterator* NewDBIterator(
+    DBImpl* db,
     const std::string* dbname,
     Env* env,
     const Comparator* user_key_comparator,
     Iterator* internal_iter,
-    const SequenceNumber& sequence);
+    const SequenceNumber& sequence,
+    uint32_t seed,
+    const Slice* lower_bound = NULL,
+    const Slice* upper_bound = NULL);
 
 }  // namespace leveldb
 
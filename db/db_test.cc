@@ -9,7 +9,9 @@
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/env.h"
+#include "leveldb/persistent_cache.h"
 #include "leveldb/table.h"
 #include "util/hash.h"
 #include "util/logging.h"
@@ -36,6 +38,10 @@ class AtomicCounter {
     MutexLock l(&mu_);
     count_++;
   }
+  void IncrementBy(int n) {
+    MutexLock l(&mu_);
+    count_ += n;
+  }
   int Read() {
     MutexLock l(&mu_);
     return count_;
@@ -68,15 +74,34 @@ class SpecialEnv : public EnvWrapper {
   bool count_random_reads_;
   AtomicCounter random_read_counter_;
 
+  // Return the data of random reads in the caller's buffer (as files
+  // that are not mmap-ed do, making their blocks cachable)?
+  bool copy_random_reads_;
+
   AtomicCounter sleep_counter_;
 
+  // Number of random access files opened
+  AtomicCounter random_file_open_counter_;
+
+  // Opening random access files is slow while this pointer is non-NULL
+  port::AtomicPointer slow_random_file_open_;
+
+  // Seconds by which NowMicros() is ahead of the real clock
+  AtomicCounter clock_offset_;
+
   explicit SpecialEnv(Env* base) : EnvWrapper(base) {
     delay_sstable_sync_.Release_Store(NULL);
     no_space_.Release_Store(NULL);
     non_writable_.Release_Store(NULL);
     count_random_reads_ = false;
+    copy_random_reads_ = false;
     manifest_sync_error_.Release_Store(NULL);
     manifest_write_error_.Release_Store(NULL);
+    slow_random_file_open_.Release_Store(NULL);
+  }
+
+  uint64_t NowMicros() {
+    return target()->NowMicros() + clock_offset_.Read() * 1000000ull;
   }
 
   Status NewWritableFile(const std::string& f, WritableFile** r) {
@@ -153,21 +178,32 @@ class SpecialEnv : public EnvWrapper {
      private:
       RandomAccessFile* target_;
       AtomicCounter* counter_;
+      bool copy_;
      public:
-      CountingFile(RandomAccessFile* target, AtomicCounter* counter)
-          : target_(target), counter_(counter) {
+      CountingFile(RandomAccessFile* target, AtomicCounter* counter,
+                   bool copy)
+          : target_(target), counter_(counter), copy_(copy) {
       }
       virtual ~CountingFile() { delete target_; }
       virtual Status Read(uint64_t offset, size_t n, Slice* result,
                           char* scratch) const {
         counter_->Increment();
-        return target_->Read(offset, n, result, scratch);
+        Status s = target_->Read(offset, n, result, scratch);
+        if (s.ok() && copy_ && result->data() != scratch) {
+          memmove(scratch, result->data(), result->size());
+          *result = Slice(scratch, result->size());
+        }
+        return s;
       }
     };
 
+    random_file_open_counter_.Increment();
+    if (slow_random_file_open_.Acquire_Load() != NULL) {
+      target()->SleepForMicroseconds(100000);
+    }
     Status s = target()->NewRandomAccessFile(f, r);
-    if (s.ok() && count_random_reads_) {
-      *r = new CountingFile(*r, &random_read_counter_);
+    if (s.ok() && (count_random_reads_ || copy_random_reads_)) {
+      *r = new CountingFile(*r, &random_read_counter_, copy_random_reads_);
     }
     return s;
   }
@@ -406,6 +442,20 @@ class DBTest {
     return static_cast<int>(files.size());
   }
 
+  int CountBlobFiles() {
+    std::vector<std::string> files;
+    env_->GetChildren(dbname_, &files);
+    int count = 0;
+    uint64_t number;
+    FileType type;
+    for (size_t i = 0; i < files.size(); i++) {
+      if (ParseFileName(files[i], &number, &type) && type == kBlobFile) {
+        count++;
+      }
+    }
+    return count;
+  }
+
   uint64_t Size(const Slice& start, const Slice& limit) {
     Range r(start, limit);
     uint64_t size;
@@ -518,6 +568,38 @@ TEST(DBTest, GetFromVersions) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, GetPinned) {
+  do {
+    PinnableSlice value;
+    ASSERT_OK(Put("foo", "v1"));
+    ASSERT_OK(db_->Get(ReadOptions(), "foo", &value));
+    ASSERT_EQ("v1", value.ToString());
+    ASSERT_TRUE(!value.IsPinned());  // Memtable results are copied
+
+    ASSERT_TRUE(db_->Get(ReadOptions(), "missing", &value).IsNotFound());
+
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_OK(db_->Get(ReadOptions(), "foo", &value));
+    ASSERT_EQ("v1", value.ToString());
+    ASSERT_TRUE(value.IsPinned());
+
+    // The pinned value survives the removal of the file it came from.
+    ASSERT_OK(Put("foo", "v2"));
+    dbfull()->TEST_CompactMemTable();
+    dbfull()->TEST_CompactRange(0, NULL, NULL);
+    dbfull()->TEST_CompactRange(1, NULL, NULL);
+    ASSERT_EQ("v1", value.ToString());
+    ASSERT_OK(db_->Get(ReadOptions(), "foo", &value));
+    ASSERT_EQ("v2", value.ToString());
+
+    ASSERT_OK(Delete("foo"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_TRUE(db_->Get(ReadOptions(), "foo", &value).IsNotFound());
+    ASSERT_TRUE(!value.IsPinned());
+    ASSERT_EQ("", value.ToString());
+  } while (ChangeOptions());
+}
+
 TEST(DBTest, GetSnapshot) {
   do {
     // Try with both a short key and a long key
@@ -808,6 +890,104 @@ TEST(DBTest, IterMultiWithDelete) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, IterBounds) {
+  do {
+    ASSERT_OK(Put("a", "va"));
+    ASSERT_OK(Put("b", "vb"));
+    ASSERT_OK(Put("c", "vc"));
+    ASSERT_OK(Put("d", "vd"));
+    ASSERT_OK(Put("e", "ve"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_OK(Delete("a"));
+    ASSERT_OK(Put("c", "vc2"));
+    ASSERT_OK(Delete("e"));
+
+    Slice lower("b");
+    Slice upper("d");
+    ReadOptions options;
+    options.iterate_lower_bound = &lower;
+    options.iterate_upper_bound = &upper;
+    Iterator* iter = db_->NewIterator(options);
+
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "c->vc2");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+    iter->SeekToLast();
+    ASSERT_EQ(IterStatus(iter), "c->vc2");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+    // Targets outside the bounds
+    iter->Seek("a");
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Seek("d");
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+    iter->Seek("c");
+    ASSERT_EQ(IterStatus(iter), "c->vc2");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "c->vc2");
+    delete iter;
+
+    // Only an upper bound
+    options.iterate_lower_bound = NULL;
+    iter = db_->NewIterator(options);
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->SeekToLast();
+    ASSERT_EQ(IterStatus(iter), "c->vc2");
+    delete iter;
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, TailingIterator) {
+  do {
+    ReadOptions options;
+    options.tailing = true;
+    Iterator* iter = db_->NewIterator(options);
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+    ASSERT_OK(Put("a", "va"));
+    iter->Seek("a");
+    ASSERT_EQ(IterStatus(iter), "a->va");
+
+    // Writes made after the last refresh are picked up at the end.
+    ASSERT_OK(Put("b", "vb"));
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+
+    // Also across a memtable compaction.
+    ASSERT_OK(Put("c", "vc"));
+    dbfull()->TEST_CompactMemTable();
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "c->vc");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+    ASSERT_OK(Delete("a"));
+    ASSERT_OK(Put("b", "vb2"));
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "b->vb2");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "c->vc");
+
+    iter->Prev();
+    ASSERT_TRUE(!iter->Valid());
+    ASSERT_TRUE(!iter->status().ok());
+    iter->Seek("c");
+    ASSERT_EQ(IterStatus(iter), "c->vc");
+    delete iter;
+  } while (ChangeOptions());
+}
+
 TEST(DBTest, Recover) {
   do {
     ASSERT_OK(Put("foo", "v1"));
@@ -896,6 +1076,56 @@ TEST(DBTest, MinorCompactionsHappen) {
   }
 }
 
+TEST(DBTest, IterAsyncPrefetch) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;  // Small write buffer
+  options.block_size = 1024;
+  Reopen(&options);
+
+  // Spread the data over many blocks and table files.
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < 2000; i++) {
+    values.push_back(RandomString(&rnd, 200));
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_GT(TotalTableFiles(), 1);
+
+  ReadOptions ropts;
+  ropts.async_prefetch = true;
+  ropts.fill_cache = false;
+  Iterator* iter = db_->NewIterator(ropts);
+  int i = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ASSERT_EQ(Key(i), iter->key().ToString());
+    ASSERT_EQ(values[i], iter->value().ToString());
+    i++;
+  }
+  ASSERT_EQ(2000, i);
+
+  // Seeks and direction changes discard prefetched blocks correctly.
+  iter->Seek(Key(1500));
+  ASSERT_EQ(Key(1500) + "->" + values[1500], IterStatus(iter));
+  for (i = 1499; i >= 1000; i--) {
+    iter->Prev();
+    ASSERT_EQ(Key(i) + "->" + values[i], IterStatus(iter));
+  }
+  for (i = 1001; i < 1800; i++) {
+    iter->Next();
+    ASSERT_EQ(Key(i) + "->" + values[i], IterStatus(iter));
+  }
+  iter->Seek(Key(10));
+  ASSERT_EQ(Key(10) + "->" + values[10], IterStatus(iter));
+  ASSERT_OK(iter->status());
+  delete iter;
+
+  // Destroying an iterator with a prefetch in flight is safe.
+  iter = db_->NewIterator(ropts);
+  iter->SeekToFirst();
+  delete iter;
+}
+
 TEST(DBTest, RecoverWithLargeLog) {
   {
     Options options = CurrentOptions();
@@ -1625,6 +1855,1033 @@ TEST(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
+TEST(DBTest, IterBoundsSkipReads) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  Reopen(&options);
+
+  // Two sstables, each spanning many blocks.
+  const int N = 1000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'v')));
+    if (i == N / 2) {
+      dbfull()->TEST_CompactMemTable();
+    }
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Delete everything past the first few keys, so that an unbounded
+  // scan has to step over all of it to find out nothing is left.
+  for (int i = 10; i < N; i++) {
+    ASSERT_OK(Delete(Key(i)));
+  }
+
+  std::string upper_key = Key(10);
+  Slice upper(upper_key);
+  ReadOptions ropts;
+  ropts.iterate_upper_bound = &upper;
+  env_->random_read_counter_.Reset();
+  Iterator* iter = db_->NewIterator(ropts);
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(10, count);
+  delete iter;
+  const int bounded_reads = env_->random_read_counter_.Read();
+
+  env_->random_read_counter_.Reset();
+  iter = db_->NewIterator(ReadOptions());
+  count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(10, count);
+  delete iter;
+  const int unbounded_reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "bounded scan => %d reads, unbounded => %d reads\n",
+          bounded_reads, unbounded_reads);
+  ASSERT_LE(bounded_reads, 5);
+  ASSERT_GE(unbounded_reads, 200);
+
+  Close();
+  delete options.block_cache;
+}
+
+TEST(DBTest, GetRangeSplits) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;  // Small write buffer
+  Reopen(&options);
+  const int N = 20000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), std::string(100, 'v')));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  std::vector<std::string> splits;
+  db_->GetRangeSplits(NULL, NULL, 4, &splits);
+  ASSERT_EQ(3, splits.size());
+  for (size_t i = 0; i <= splits.size(); i++) {
+    Slice lower, upper;
+    ReadOptions ropts;
+    if (i > 0) {
+      lower = splits[i - 1];
+      ropts.iterate_lower_bound = &lower;
+    }
+    if (i < splits.size()) {
+      upper = splits[i];
+      ropts.iterate_upper_bound = &upper;
+    }
+    Iterator* iter = db_->NewIterator(ropts);
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      count++;
+    }
+    delete iter;
+    fprintf(stderr, "part %d: %d keys\n", static_cast<int>(i), count);
+    ASSERT_GT(count, N / 8);
+    ASSERT_LT(count, N / 2);
+  }
+
+  std::string begin = Key(1000);
+  std::string end = Key(3000);
+  Slice b(begin), e(end);
+  db_->GetRangeSplits(&b, &e, 2, &splits);
+  ASSERT_EQ(1, splits.size());
+  ASSERT_GT(splits[0], Key(1500));
+  ASSERT_LT(splits[0], Key(2500));
+
+  db_->GetRangeSplits(NULL, NULL, 1, &splits);
+  ASSERT_TRUE(splits.empty());
+}
+
+namespace {
+class CountingScanVisitor : public ScanVisitor {
+ public:
+  port::Mutex mu;
+  std::vector<std::string> last_key;   // Indexed by partition
+  int count;
+  int limit;                           // Stop after this many entries
+  bool in_order;
+
+  CountingScanVisitor() : count(0), limit(-1), in_order(true) { }
+
+  virtual bool Visit(int partition, const Slice& key, const Slice& value) {
+    MutexLock l(&mu);
+    if (last_key.size() <= static_cast<size_t>(partition)) {
+      last_key.resize(partition + 1);
+    }
+    if (!last_key[partition].empty() && key.compare(last_key[partition]) <= 0) {
+      in_order = false;
+    }
+    last_key[partition] = key.ToString();
+    count++;
+    return count != limit;
+  }
+};
+}  // namespace
+
+TEST(DBTest, ParallelScan) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;  // Small write buffer
+  Reopen(&options);
+  const int N = 20000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), std::string(100, 'v')));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Changes made after the snapshot are not seen.
+  const Snapshot* snapshot = db_->GetSnapshot();
+  for (int i = 0; i < N; i += 2) {
+    ASSERT_OK(Delete(Key(i)));
+  }
+  ReadOptions ropts;
+  ropts.snapshot = snapshot;
+  CountingScanVisitor v1;
+  ASSERT_OK(db_->ParallelScan(ropts, NULL, NULL, 4, &v1));
+  ASSERT_EQ(N, v1.count);
+  ASSERT_EQ(4, v1.last_key.size());
+  ASSERT_TRUE(v1.in_order);
+  db_->ReleaseSnapshot(snapshot);
+
+  std::string begin = Key(100);
+  std::string end = Key(9000);
+  Slice b(begin), e(end);
+  CountingScanVisitor v2;
+  ASSERT_OK(db_->ParallelScan(ReadOptions(), &b, &e, 3, &v2));
+  ASSERT_EQ((9000 - 100) / 2, v2.count);
+  ASSERT_TRUE(v2.in_order);
+
+  // Returning false stops all threads.
+  CountingScanVisitor v3;
+  v3.limit = 10;
+  ASSERT_OK(db_->ParallelScan(ReadOptions(), NULL, NULL, 4, &v3));
+  ASSERT_LT(v3.count, N / 4);
+}
+
+TEST(DBTest, IterReadSamplingTriggersCompaction) {
+  // Arrange for two overlapping sstables, one in level 1 and one in
+  // level 2, so that every key read by a scan is looked up in both.
+  const int N = 100;
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < N; i++) {
+      ASSERT_OK(Put(Key(i), std::string(1000, 'a' + pass)));
+    }
+    dbfull()->TEST_CompactMemTable();
+  }
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+
+  // Scans never call Get(), but their samples use up the allowed seeks
+  // of the level-1 table, which is then compacted into level 2.
+  for (int scan = 0; scan < 10000 && NumTableFilesAtLevel(1) > 0; scan++) {
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      count++;
+    }
+    ASSERT_EQ(N, count);
+    delete iter;
+  }
+  for (int i = 0; i < 100 && NumTableFilesAtLevel(1) > 0; i++) {
+    env_->SleepForMicroseconds(10000);
+  }
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ(std::string(1000, 'b'), Get(Key(0)));
+}
+
+TEST(DBTest, RowCache) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent block cache hits
+  options.row_cache = NewLRUCache(1 << 20);
+  Reopen(&options);
+
+  const int N = 100;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  ASSERT_OK(Delete(Key(0)));
+  dbfull()->TEST_CompactMemTable();
+
+  // The first pass fills the row cache; the second is served from it.
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(i == 0 ? "NOT_FOUND" : Key(i), Get(Key(i)));
+  }
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(i == 0 ? "NOT_FOUND" : Key(i), Get(Key(i)));
+    PinnableSlice value;
+    if (i > 0) {
+      ASSERT_OK(db_->Get(ReadOptions(), Key(i), &value));
+      ASSERT_EQ(Key(i), value.ToString());
+      ASSERT_TRUE(value.IsPinned());
+    }
+  }
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+  // Reads at a snapshot bypass the row cache.
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_EQ(Key(1), Get(Key(1), snapshot));
+  ASSERT_GT(env_->random_read_counter_.Read(), 0);
+
+  // Newer files and compaction outputs are not shadowed by cached rows.
+  ASSERT_OK(Put(Key(1), "v2"));
+  ASSERT_OK(Put(Key(0), "v2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("v2", Get(Key(1)));
+  ASSERT_EQ("v2", Get(Key(0)));
+  ASSERT_EQ(Key(1), Get(Key(1), snapshot));
+  db_->ReleaseSnapshot(snapshot);
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+  ASSERT_EQ("v2", Get(Key(1)));
+  ASSERT_EQ("v2", Get(Key(0)));
+  ASSERT_EQ(Key(2), Get(Key(2)));
+
+  Close();
+  delete options.block_cache;
+  delete options.row_cache;
+}
+
+static void DeleteDirContents(const std::string& dir) {
+  std::vector<std::string> children;
+  Env::Default()->GetChildren(dir, &children);
+  for (size_t i = 0; i < children.size(); i++) {
+    Env::Default()->DeleteFile(dir + "/" + children[i]);
+  }
+}
+
+TEST(DBTest, PersistentCache) {
+  const std::string cache_dir = test::TmpDir() + "/db_test_pcache";
+  DeleteDirContents(cache_dir);
+  PersistentCache* persistent_cache;
+  ASSERT_OK(NewPersistentCache(Env::Default(), cache_dir, 1 << 20,
+                               &persistent_cache));
+
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent block cache hits
+  options.persistent_cache = persistent_cache;
+  Reopen(&options);
+
+  const int N = 100;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'a' + (i % 26))));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // The first pass fills the persistent cache; the second is served
+  // from it.
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(std::string(1000, 'a' + (i % 26)), Get(Key(i)));
+  }
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(std::string(1000, 'a' + (i % 26)), Get(Key(i)));
+  }
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+  // Cached blocks stay usable after the DB is reopened; only the
+  // table's footer and index are read again.
+  Reopen(&options);
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(std::string(1000, 'a' + (i % 26)), Get(Key(i)));
+  }
+  ASSERT_LT(env_->random_read_counter_.Read(), 10);
+
+  Close();
+  delete options.block_cache;
+  delete persistent_cache;
+  DeleteDirContents(cache_dir);
+  Env::Default()->DeleteDir(cache_dir);
+}
+
+TEST(DBTest, PersistCacheState) {
+  ASSERT_OK(Put("foo", "v1"));
+  Reopen();
+  ASSERT_TRUE(!env_->FileExists(CacheStateFileName(dbname_)));
+
+  env_->count_random_reads_ = true;
+  env_->copy_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(1 << 20);
+  options.persist_cache_state = true;
+  Reopen(&options);
+
+  const int N = 100;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'a' + (i % 26))));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(db_->SaveCacheState());
+  ASSERT_TRUE(env_->FileExists(CacheStateFileName(dbname_)));
+
+  // Only the blocks read before closing are loaded when reopening.
+  for (int i = 0; i < N / 2; i++) {
+    ASSERT_EQ(std::string(1000, 'a' + (i % 26)), Get(Key(i)));
+  }
+  Reopen(&options);
+  dbfull()->TEST_WaitForCacheStateLoad();
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N / 2; i++) {
+    ASSERT_EQ(std::string(1000, 'a' + (i % 26)), Get(Key(i)));
+  }
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+  ASSERT_EQ(std::string(1000, 'a' + ((N - 1) % 26)), Get(Key(N - 1)));
+  ASSERT_GT(env_->random_read_counter_.Read(), 0);
+
+  // Tables that were compacted away are skipped.
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+  ASSERT_OK(db_->SaveCacheState());
+  dbfull()->TEST_CompactRange(1, NULL, NULL);
+  Reopen(&options);
+  dbfull()->TEST_WaitForCacheStateLoad();
+  ASSERT_EQ(std::string(1000, 'a'), Get(Key(0)));
+
+  Close();
+  delete options.block_cache;
+}
+
+TEST(DBTest, BlockCacheStats) {
+  Options options = CurrentOptions();
+  options.block_cache = NewSegmentedLRUCache(1 << 20, 0.1);
+  Reopen(&options);
+  ASSERT_OK(Put("foo", "v1"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("v1", Get("foo"));
+  ASSERT_EQ("v1", Get("foo"));
+
+  std::string stats;
+  ASSERT_TRUE(db_->GetProperty("leveldb.block-cache-stats", &stats));
+  ASSERT_NE(std::string::npos, stats.find("protected"));
+  ASSERT_NE(std::string::npos, stats.find("total"));
+
+  Close();
+  delete options.block_cache;
+}
+
+TEST(DBTest, BlobFiles) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 100;
+  Reopen(&options);
+
+  const int N = 100;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'a' + (i % 26))));
+  }
+  ASSERT_OK(Put("small", "v1"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(1, CountBlobFiles());
+
+  // The values moved out of the table, which stays small.
+  uint64_t table_bytes = 0;
+  std::vector<std::string> files;
+  ASSERT_OK(env_->GetChildren(dbname_, &files));
+  for (size_t i = 0; i < files.size(); i++) {
+    uint64_t number;
+    FileType type;
+    uint64_t size;
+    if (ParseFileName(files[i], &number, &type) && type == kTableFile &&
+        env_->GetFileSize(dbname_ + "/" + files[i], &size).ok()) {
+      table_bytes += size;
+    }
+  }
+  ASSERT_LT(table_bytes, N * 100);
+
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(std::string(1000, 'a' + (i % 26)), Get(Key(i)));
+  }
+  ASSERT_EQ("v1", Get("small"));
+
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    if (iter->key() != "small") {
+      ASSERT_EQ(std::string(1000, 'a' + (count % 26)), iter->value().ToString());
+    }
+    count++;
+  }
+  ASSERT_EQ(N + 1, count);
+  for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+    count--;
+  }
+  ASSERT_EQ(0, count);
+  ASSERT_OK(iter->status());
+  delete iter;
+
+  Reopen(&options);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(std::string(1000, 'a' + (i % 26)), Get(Key(i)));
+  }
+  ASSERT_EQ(1, CountBlobFiles());
+}
+
+TEST(DBTest, BlobFileGarbageCollection) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 100;
+  Reopen(&options);
+
+  const int N = 100;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'a')));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Overwriting most of the values leaves the first blob file mostly
+  // garbage once the old entries are compacted away.
+  for (int i = 0; i < N * 3 / 4; i++) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'b')));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+  ASSERT_EQ(2, CountBlobFiles());
+  dbfull()->TEST_CompactRange(1, NULL, NULL);
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ(2, CountBlobFiles());
+
+  // The next compaction relocates its remaining values, after which
+  // the first file holds only garbage and is deleted.
+  dbfull()->TEST_CompactRange(2, NULL, NULL);
+  ASSERT_EQ("0,0,0,1", FilesPerLevel());
+  ASSERT_EQ(2, CountBlobFiles());
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(std::string(1000, i < N * 3 / 4 ? 'b' : 'a'), Get(Key(i)));
+  }
+
+  // Deleting every key frees all blob files.
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Delete(Key(i)));
+  }
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ(0, CountBlobFiles());
+
+  Reopen(&options);
+  ASSERT_EQ("NOT_FOUND", Get(Key(0)));
+  ASSERT_EQ(0, CountBlobFiles());
+}
+
+TEST(DBTest, DirectIO) {
+  Options options = CurrentOptions();
+  options.use_direct_reads = true;
+  options.use_direct_io_for_flush_and_compaction = true;
+  Reopen(&options);
+
+  const int N = 1000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), std::string(100 + i % 500, 'a' + (i % 26))));
+  }
+  dbfull()->TEST_CompactMemTable();
+  for (int i = 0; i < N; i += 2) {
+    ASSERT_OK(Delete(Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  db_->CompactRange(NULL, NULL);
+
+  Reopen(&options);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(i % 2 == 0 ? "NOT_FOUND"
+                         : std::string(100 + i % 500, 'a' + (i % 26)),
+              Get(Key(i)));
+  }
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(N / 2, count);
+  delete iter;
+}
+
+TEST(DBTest, MultiGet) {
+  do {
+    for (int pass = 0; pass < 3; pass++) {
+      Options options = CurrentOptions();
+      if (pass == 1) {
+        options.use_direct_reads = true;
+      } else if (pass == 2) {
+        options.block_cache = NewLRUCache(1 << 20);
+      }
+      options.create_if_missing = true;
+      DestroyAndReopen(&options);
+
+      // Entries spread over several levels, level-0 files and the
+      // memtable, with overwrites and deletions.
+      const int N = 200;
+      for (int i = 0; i < N; i++) {
+        ASSERT_OK(Put(Key(i), "old" + Key(i)));
+      }
+      dbfull()->TEST_CompactMemTable();
+      dbfull()->TEST_CompactRange(0, NULL, NULL);
+      for (int i = 0; i < N; i += 3) {
+        ASSERT_OK(Put(Key(i), "new" + Key(i)));
+      }
+      dbfull()->TEST_CompactMemTable();
+      for (int i = 1; i < N; i += 5) {
+        ASSERT_OK(Delete(Key(i)));
+      }
+      dbfull()->TEST_CompactMemTable();
+      ASSERT_OK(Put(Key(2), "mem"));
+
+      std::vector<std::string> key_strings;
+      for (int i = 0; i < N + 10; i++) {
+        key_strings.push_back(Key(i));
+      }
+      std::vector<Slice> keys(key_strings.begin(), key_strings.end());
+      std::vector<std::string> values;
+      for (int repeat = 0; repeat < 2; repeat++) {
+        std::vector<Status> statuses = db_->MultiGet(ReadOptions(), keys,
+                                                     &values);
+        ASSERT_EQ(keys.size(), statuses.size());
+        ASSERT_EQ(keys.size(), values.size());
+        for (size_t i = 0; i < keys.size(); i++) {
+          if (statuses[i].IsNotFound()) {
+            ASSERT_EQ("NOT_FOUND", Get(key_strings[i]));
+          } else {
+            ASSERT_OK(statuses[i]);
+            ASSERT_EQ(Get(key_strings[i]), values[i]);
+          }
+        }
+      }
+      ASSERT_EQ("mem", values[2]);
+      ASSERT_EQ("new" + Key(3), values[3]);
+      ASSERT_EQ("old" + Key(4), values[4]);
+      ASSERT_TRUE(values[6].empty());
+
+      // Reads at a snapshot taken before the deletions
+      const Snapshot* snapshot = db_->GetSnapshot();
+      ASSERT_OK(Delete(Key(3)));
+      ReadOptions ropts;
+      ropts.snapshot = snapshot;
+      std::vector<Status> statuses = db_->MultiGet(ropts, keys, &values);
+      ASSERT_OK(statuses[3]);
+      ASSERT_EQ("new" + Key(3), values[3]);
+      statuses = db_->MultiGet(ReadOptions(), keys, &values);
+      ASSERT_TRUE(statuses[3].IsNotFound());
+      db_->ReleaseSnapshot(snapshot);
+
+      Close();
+      delete options.block_cache;
+    }
+  } while (ChangeOptions());
+}
+
+namespace {
+struct ConcurrentGetState {
+  DB* db;
+  std::string key;
+  port::Mutex mu;
+  int running;
+  int found;
+};
+
+static void ConcurrentGet(void* arg) {
+  ConcurrentGetState* state = reinterpret_cast<ConcurrentGetState*>(arg);
+  std::string value;
+  bool found = state->db->Get(ReadOptions(), state->key, &value).ok();
+  MutexLock l(&state->mu);
+  if (found) {
+    state->found++;
+  }
+  state->running--;
+}
+}  // namespace
+
+TEST(DBTest, ConcurrentTableOpen) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  Reopen(&options);
+  ASSERT_OK(Put("foo", "v1"));
+  dbfull()->TEST_CompactMemTable();
+  Reopen(&options);
+
+  // Threads that miss on the same table share a single open of it.
+  env_->random_file_open_counter_.Reset();
+  env_->slow_random_file_open_.Release_Store(env_);
+  const int kThreads = 8;
+  ConcurrentGetState state;
+  state.db = db_;
+  state.key = "foo";
+  state.running = kThreads;
+  state.found = 0;
+  for (int i = 0; i < kThreads; i++) {
+    env_->StartThread(&ConcurrentGet, &state);
+  }
+  while (true) {
+    state.mu.Lock();
+    const int running = state.running;
+    state.mu.Unlock();
+    if (running == 0) {
+      break;
+    }
+    env_->SleepForMicroseconds(10000);
+  }
+  env_->slow_random_file_open_.Release_Store(NULL);
+  ASSERT_EQ(kThreads, state.found);
+  ASSERT_EQ(1, env_->random_file_open_counter_.Read());
+}
+
+TEST(DBTest, PrepopulateBlockCache) {
+  env_->count_random_reads_ = true;
+  env_->copy_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(1 << 20);
+  options.prepopulate_block_cache = true;
+  Reopen(&options);
+
+  const int N = 100;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'a' + (i % 26))));
+  }
+  dbfull()->TEST_CompactMemTable();
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(std::string(1000, 'a' + (i % 26)), Get(Key(i)));
+  }
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+  // The same holds for the output of a compaction.
+  for (int i = 0; i < N; i += 2) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'z')));
+  }
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+  dbfull()->TEST_CompactRange(1, NULL, NULL);
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(std::string(1000, i % 2 == 0 ? 'z' : 'a' + (i % 26)),
+              Get(Key(i)));
+  }
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+  Close();
+  delete options.block_cache;
+}
+
+TEST(DBTest, PreloadTables) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  Reopen(&options);
+  const int N = 100;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'a' + (i % 26))));
+    if (i % 25 == 24) {
+      dbfull()->TEST_CompactMemTable();
+    }
+  }
+
+  // The tables are all open by the time the first read comes in.
+  options.preload_tables = true;
+  Reopen(&options);
+  dbfull()->TEST_WaitForPreload();
+  env_->random_file_open_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(std::string(1000, 'a' + (i % 26)), Get(Key(i)));
+  }
+  ASSERT_EQ(0, env_->random_file_open_counter_.Read());
+
+  // With paranoid_checks the tables are verified too, and a corrupt
+  // one stops later writes.
+  Close();
+  std::vector<std::string> filenames;
+  ASSERT_OK(env_->GetChildren(dbname_, &filenames));
+  std::string table;
+  uint64_t number;
+  FileType type;
+  for (size_t i = 0; i < filenames.size(); i++) {
+    if (ParseFileName(filenames[i], &number, &type) && type == kTableFile) {
+      table = dbname_ + "/" + filenames[i];
+    }
+  }
+  ASSERT_TRUE(!table.empty());
+  std::string contents;
+  ASSERT_OK(ReadFileToString(env_, table, &contents));
+  contents[100] ^= 0x80;  // In the first data block
+  ASSERT_OK(WriteStringToFile(env_, contents, table));
+  options.paranoid_checks = true;
+  Reopen(&options);
+  dbfull()->TEST_WaitForPreload();
+  ASSERT_TRUE(!Put("foo", "v1").ok());
+}
+
+TEST(DBTest, UniversalCompaction) {
+  Options options = CurrentOptions();
+  options.compaction_style = kCompactionStyleUniversal;
+  Reopen(&options);
+
+  // Every flush adds a run to level-0, and merges keep the number of
+  // runs down without ever moving data to other levels.
+  Random rnd(301);
+  const int N = 200;
+  std::vector<std::string> values(N);
+  for (int round = 0; round < 20; round++) {
+    for (int i = round % 2; i < N; i += 2) {
+      values[i] = RandomString(&rnd, 1000);
+      ASSERT_OK(Put(Key(i), values[i]));
+    }
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ(NumTableFilesAtLevel(0), TotalTableFiles());
+  }
+  for (int i = 0; i < 1000; i++) {
+    if (NumTableFilesAtLevel(0) < config::kL0_SlowdownWritesTrigger) {
+      break;
+    }
+    env_->SleepForMicroseconds(10000);
+  }
+  ASSERT_LT(NumTableFilesAtLevel(0), config::kL0_SlowdownWritesTrigger);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+  std::string stats;
+  ASSERT_TRUE(db_->GetProperty("leveldb.stats", &stats));
+  ASSERT_TRUE(stats.find("Write amplification") != std::string::npos);
+
+  // Deletions are dropped once they are merged with the oldest run.
+  for (int i = 0; i < N / 2; i++) {
+    ASSERT_OK(Delete(Key(i)));
+  }
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ("1", FilesPerLevel());
+  ASSERT_EQ("[ ]", AllEntriesFor(Key(0)));
+  Reopen(&options);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(i < N / 2 ? "NOT_FOUND" : values[i], Get(Key(i)));
+  }
+}
+
+TEST(DBTest, DynamicLevelBytes) {
+  Options options = CurrentOptions();
+  options.level_compaction_dynamic_level_bytes = true;
+  Reopen(&options);
+
+  // While the DB is small, level-0 compacts straight into the last level.
+  const int N = 200;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'a' + (i % 26))));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("1", FilesPerLevel());
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+  ASSERT_EQ("0,0,0,0,0,0,1", FilesPerLevel());
+
+  // So do automatic level-0 compactions.
+  for (int round = 0; round < config::kL0_CompactionTrigger; round++) {
+    for (int i = round; i < N; i += config::kL0_CompactionTrigger) {
+      ASSERT_OK(Put(Key(i), std::string(1000, 'A' + (i % 26))));
+    }
+    dbfull()->TEST_CompactMemTable();
+  }
+  for (int i = 0; i < 1000 && NumTableFilesAtLevel(0) > 0; i++) {
+    env_->SleepForMicroseconds(10000);
+  }
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  ASSERT_EQ(NumTableFilesAtLevel(config::kNumLevels - 1), TotalTableFiles());
+
+  Reopen(&options);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(std::string(1000, 'A' + (i % 26)), Get(Key(i)));
+  }
+}
+
+TEST(DBTest, SetOptions) {
+  Options options = CurrentOptions();
+  options.max_mem_compaction_level = 0;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  std::map<std::string, std::string> opts;
+  opts["no_such_option"] = "1";
+  ASSERT_TRUE(!db_->SetOptions(opts).ok());
+  opts.clear();
+  opts["num_levels"] = "3";
+  ASSERT_TRUE(!db_->SetOptions(opts).ok());
+  opts.clear();
+  opts["level0_file_num_compaction_trigger"] = "2x";
+  ASSERT_TRUE(!db_->SetOptions(opts).ok());
+  opts["level0_file_num_compaction_trigger"] = "0";
+  ASSERT_TRUE(!db_->SetOptions(opts).ok());
+
+  // A failed call changes none of the options.
+  opts["level0_file_num_compaction_trigger"] = "2";
+  opts["max_mem_compaction_level"] = "7";
+  ASSERT_TRUE(!db_->SetOptions(opts).ok());
+
+  for (int round = 0; round < 2; round++) {
+    ASSERT_OK(Put("a", "va"));
+    ASSERT_OK(Put("z", "vz"));
+    dbfull()->TEST_CompactMemTable();
+  }
+  ASSERT_EQ("2", FilesPerLevel());
+
+  // Lowering the trigger compacts level-0 right away.
+  opts.erase("max_mem_compaction_level");
+  ASSERT_OK(db_->SetOptions(opts));
+  for (int i = 0; i < 1000 && NumTableFilesAtLevel(0) > 0; i++) {
+    env_->SleepForMicroseconds(10000);
+  }
+  ASSERT_EQ("0,1", FilesPerLevel());
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ("vz", Get("z"));
+}
+
+TEST(DBTest, NumLevels) {
+  Options options = CurrentOptions();
+  options.num_levels = 3;
+  options.level_compaction_dynamic_level_bytes = true;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+  ASSERT_OK(Put("foo", "v1"));
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+
+  // Reopening with more levels is fine...
+  options.num_levels = 5;
+  Reopen(&options);
+  ASSERT_EQ("v1", Get("foo"));
+  dbfull()->TEST_CompactRange(2, NULL, NULL);
+  ASSERT_EQ("0,0,0,1", FilesPerLevel());
+
+  // ...but not with fewer levels than hold tables.
+  options.num_levels = 3;
+  ASSERT_TRUE(!TryReopen(&options).ok());
+  options.num_levels = 4;
+  Reopen(&options);
+  ASSERT_EQ("v1", Get("foo"));
+}
+
+namespace {
+// Removes the keys whose value is "remove", and replaces values that
+// start with "old" by "new".
+class TestCompactionFilter : public CompactionFilter {
+ public:
+  virtual const char* Name() const { return "TestCompactionFilter"; }
+  virtual bool Filter(int level, const Slice& key,
+                      const Slice& existing_value,
+                      std::string* new_value,
+                      bool* value_changed) const {
+    if (existing_value == "remove") {
+      return true;
+    }
+    if (existing_value.starts_with("old")) {
+      new_value->assign("new");
+      *value_changed = true;
+    }
+    return false;
+  }
+};
+}
+
+TEST(DBTest, CompactionFilter) {
+  TestCompactionFilter filter;
+  for (int blobs = 0; blobs < 2; blobs++) {
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.compaction_filter = &filter;
+    options.min_blob_size = blobs;
+    options.max_mem_compaction_level = 0;
+    DestroyAndReopen(&options);
+
+    ASSERT_OK(Put("a", "keep"));
+    ASSERT_OK(Put("b", "remove"));
+    ASSERT_OK(Put("c", "old1"));
+    ASSERT_OK(Put("d", "x"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_OK(Put("c", "old2"));
+    ASSERT_OK(Put("d", "remove"));
+    ASSERT_OK(Put("e", "remove"));
+    dbfull()->TEST_CompactMemTable();
+    dbfull()->TEST_CompactRange(0, NULL, NULL);
+
+    // Values that the snapshot sees are left alone.
+    ASSERT_EQ("keep", Get("a"));
+    ASSERT_EQ("remove", Get("b"));
+    ASSERT_EQ("new", Get("c"));
+    ASSERT_EQ("NOT_FOUND", Get("d"));
+    ASSERT_EQ("NOT_FOUND", Get("e"));
+    ASSERT_EQ("remove", Get("b", snapshot));
+    ASSERT_EQ("old1", Get("c", snapshot));
+    ASSERT_EQ("x", Get("d", snapshot));
+    ASSERT_EQ("NOT_FOUND", Get("e", snapshot));
+
+    db_->ReleaseSnapshot(snapshot);
+    dbfull()->TEST_CompactRange(1, NULL, NULL);
+    ASSERT_EQ("keep", Get("a"));
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("new", Get("c"));
+    ASSERT_EQ("NOT_FOUND", Get("d"));
+    ASSERT_EQ("[ ]", AllEntriesFor("b"));
+    ASSERT_EQ("[ ]", AllEntriesFor("d"));
+    ASSERT_EQ("[ ]", AllEntriesFor("e"));
+  }
+}
+
+TEST(DBTest, TTL) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.env = env_;
+  options.ttl = 100;
+  DestroyAndReopen(&options);
+
+  ASSERT_OK(Put("a", "va"));
+  ASSERT_OK(Put("b", "vb1"));
+  env_->clock_offset_.IncrementBy(50);
+  ASSERT_OK(Put("b", "vb2"));
+  ASSERT_OK(Put("c", "vc"));
+  env_->clock_offset_.IncrementBy(60);
+
+  // Expired keys read as deleted, even where older values remain.
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  ASSERT_EQ("vb2", Get("b"));
+  ASSERT_EQ("vc", Get("c"));
+  std::vector<Slice> keys;
+  keys.push_back("a");
+  keys.push_back("b");
+  std::vector<std::string> values;
+  std::vector<Status> statuses = db_->MultiGet(ReadOptions(), keys, &values);
+  ASSERT_TRUE(statuses[0].IsNotFound());
+  ASSERT_OK(statuses[1]);
+  ASSERT_EQ("vb2", values[1]);
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->SeekToFirst();
+  ASSERT_EQ("b->vb2", IterStatus(iter));
+  iter->Next();
+  ASSERT_EQ("c->vc", IterStatus(iter));
+  iter->Prev();
+  ASSERT_EQ("b->vb2", IterStatus(iter));
+  iter->Prev();
+  ASSERT_EQ("(invalid)", IterStatus(iter));
+  delete iter;
+
+  // The table written out holds an expired value, so it is compacted
+  // right away.
+  dbfull()->TEST_CompactMemTable();
+  for (int i = 0; i < 500 && AllEntriesFor("a") != "[ ]"; i++) {
+    env_->SleepForMicroseconds(10000);
+  }
+  ASSERT_EQ("[ ]", AllEntriesFor("a"));
+  ASSERT_EQ("vb2", Get("b"));
+  ASSERT_EQ(1, TotalTableFiles());
+
+  // Once the rest expires, the table is compacted away even though the
+  // DB gets no more writes.
+  Reopen(&options);
+  ASSERT_EQ("vb2", Get("b"));
+  env_->clock_offset_.IncrementBy(100);
+  for (int i = 0; i < 500 && TotalTableFiles() > 0; i++) {
+    env_->SleepForMicroseconds(10000);
+  }
+  ASSERT_EQ(0, TotalTableFiles());
+  ASSERT_EQ("NOT_FOUND", Get("b"));
+  ASSERT_EQ("NOT_FOUND", Get("c"));
+
+  options.min_blob_size = 100;
+  ASSERT_TRUE(!TryReopen(&options).ok());
+}
+
+TEST(DBTest, DeletionTriggeredCompaction) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_OK(Put(Key(i), "v"));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+
+  // A third of the entries are deletion markers: not enough to compact.
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_OK(Delete(Key(i)));
+  }
+  for (int i = 2000; i < 4000; i++) {
+    ASSERT_OK(Put(Key(i), "v"));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+
+  // A table of deletions only is pushed down until the markers have
+  // dropped all of the deleted entries.
+  Reopen(&options);
+  for (int i = 1000; i < 4000; i++) {
+    ASSERT_OK(Delete(Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  for (int i = 0; i < 500 && TotalTableFiles() > 0; i++) {
+    env_->SleepForMicroseconds(10000);
+  }
+  ASSERT_EQ(0, TotalTableFiles());
+  ASSERT_EQ("NOT_FOUND", Get(Key(0)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(3999)));
+}
+
 // Multi-threaded test:
 namespace {
 
@@ -16,10 +16,11 @@
 
 namespace leveldb {
 
-// Grouping of constants.  We may want to make some of these
-// parameters set via options.
+// Grouping of constants.  The level-0 triggers and kMaxMemCompactLevel
+// are the defaults of the Options of the same purpose.
 namespace config {
 // 最大level数量
+// Upper bound of Options::num_levels
 static const int kNumLevels = 7;
 
 // Level-0 compaction is started when we hit this many files.
@@ -43,6 +44,22 @@ static const int kL0_StopWritesTrigger = 12;
 // memtable dump成的sstable，允许推向的最高level
 static const int kMaxMemCompactLevel = 2;
 
+// Approximate gap in bytes between samples of data read during iteration.
+static const int kReadBytesPeriod = 1048576;
+
+// A compaction moves the blobs it comes across out of blob files in
+// which at least this percentage of the bytes is garbage, so that the
+// files can eventually be deleted.
+static const int kBlobGarbagePercentForGC = 50;
+
+// A table outside the last level that holds at least
+// kMinDeletionsForCompaction deletion markers, making up at least this
+// percentage of its entries, is compacted into the next level even if
+// its level is within its size limit, so that reads stop skipping over
+// the markers once the deleted entries are gone.
+static const int kDeletionPercentForCompaction = 50;
+static const int kMinDeletionsForCompaction = 1000;
+
 }  // namespace config
 
 class InternalKey;
@@ -52,7 +69,8 @@ class InternalKey;
 // data structures.
 enum ValueType {
   kTypeDeletion = 0x0,
-  kTypeValue = 0x1
+  kTypeValue = 0x1,
+  kTypeBlobIndex = 0x2   // The value is an encoded BlobIndex
 };
 // kValueTypeForSeek defines the ValueType that should be passed when
 // constructing a ParsedInternalKey object for seeking to a particular
@@ -60,7 +78,7 @@ enum ValueType {
 // and the value type is embedded as the low 8 bits in the sequence
 // number in internal keys, we need to use the highest-numbered
 // ValueType, not the lowest).
-static const ValueType kValueTypeForSeek = kTypeValue;
+static const ValueType kValueTypeForSeek = kTypeBlobIndex;
 
 typedef uint64_t SequenceNumber;
 
@@ -115,6 +133,27 @@ inline ValueType ExtractValueType(const Slice& internal_key) {
   return static_cast<ValueType>(c);
 }
 
+// In a DB opened with a non-zero Options::ttl, the value of every
+// kTypeValue entry is followed by the Fixed64 time, in seconds since the
+// epoch, at which the entry expires.  An expired entry reads like a
+// deletion marker.
+static const size_t kExpiryLength = 8;
+
+// Return the expiry time stored at the end of "value", or zero (never)
+// if "value" is too short to hold one.
+inline uint64_t ExtractExpiry(const Slice& value) {
+  if (value.size() < kExpiryLength) {
+    return 0;
+  }
+  return DecodeFixed64(value.data() + value.size() - kExpiryLength);
+}
+
+// Return true iff "value" carries an expiry time that is not after "now".
+inline bool IsExpired(const Slice& value, uint64_t now) {
+  const uint64_t expiry = ExtractExpiry(value);
+  return expiry != 0 && expiry <= now;
+}
+
 // A comparator for internal keys that uses a specified comparator for
 // the user key portion and breaks ties by decreasing sequence number.
 // db内部实现key排序时使用的比较方法
@@ -191,7 +230,7 @@ inline bool ParseInternalKey(const Slice& internal_key,
   result->sequence = num >> 8;
   result->type = static_cast<ValueType>(c);
   result->user_key = Slice(internal_key.data(), n - 8);
-  return (c <= static_cast<unsigned char>(kTypeValue));
+  return (c <= static_cast<unsigned char>(kTypeBlobIndex));
 }
 
 // A helper class useful for DBImpl::Get()
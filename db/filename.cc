@@ -34,6 +34,11 @@ std::string TableFileName(const std::string& name, uint64_t number) {
   return MakeFileName(name, number, "sst");
 }
 
+std::string BlobFileName(const std::string& name, uint64_t number) {
+  assert(number > 0);
+  return MakeFileName(name, number, "blob");
+}
+
 std::string DescriptorFileName(const std::string& dbname, uint64_t number) {
   assert(number > 0);
   char buf[100];
@@ -55,6 +60,10 @@ std::string TempFileName(const std::string& dbname, uint64_t number) {
   return MakeFileName(dbname, number, "dbtmp");
 }
 
+std::string CacheStateFileName(const std::string& dbname) {
+  return dbname + "/CACHESTATE";
+}
+
 std::string InfoLogFileName(const std::string& dbname) {
   return dbname + "/LOG";
 }
@@ -66,6 +75,7 @@ std::string OldInfoLogFileName(const std::string& dbname) {
 
 
 // Owned filenames have the form:
+//    dbname/CACHESTATE
 //    dbname/CURRENT
 //    dbname/LOCK
 //    dbname/LOG
@@ -85,6 +95,9 @@ bool ParseFileName(const std::string& fname,
   } else if (rest == "LOG" || rest == "LOG.old") {
     *number = 0;
     *type = kInfoLogFile;
+  } else if (rest == "CACHESTATE") {
+    *number = 0;
+    *type = kCacheStateFile;
   } else if (rest.starts_with("MANIFEST-")) {
     rest.remove_prefix(strlen("MANIFEST-"));
     uint64_t num;
@@ -110,6 +123,8 @@ bool ParseFileName(const std::string& fname,
       *type = kTableFile;
     } else if (suffix == Slice(".dbtmp")) {
       *type = kTempFile;
+    } else if (suffix == Slice(".blob")) {
+      *type = kBlobFile;
     } else {
       return false;
     }
@@ -24,7 +24,9 @@ enum FileType {
   kDescriptorFile,
   kCurrentFile,
   kTempFile,
-  kInfoLogFile  // Either the current one, or an old one
+  kInfoLogFile,  // Either the current one, or an old one
+  kCacheStateFile,
+  kBlobFile
 };
 
 // Return the name of the log file with the specified number
@@ -37,6 +39,11 @@ extern std::string LogFileName(const std::string& dbname, uint64_t number);
 // "dbname".
 extern std::string TableFileName(const std::string& dbname, uint64_t number);
 
+// Return the name of the blob file with the specified number
+// in the db named by "dbname".  The result will be prefixed with
+// "dbname".
+extern std::string BlobFileName(const std::string& dbname, uint64_t number);
+
 // Return the name of the descriptor file for the db named by
 // "dbname" and the specified incarnation number.  The result will be
 // prefixed with "dbname".
@@ -56,6 +63,11 @@ extern std::string LockFileName(const std::string& dbname);
 // The result will be prefixed with "dbname".
 extern std::string TempFileName(const std::string& dbname, uint64_t number);
 
+// Return the name of the file that lists the tables and blocks that
+// were cached by the db named by "dbname".  The result will be
+// prefixed with "dbname".
+extern std::string CacheStateFileName(const std::string& dbname);
+
 // Return the name of the info log file for "dbname".
 extern std::string InfoLogFileName(const std::string& dbname);
 
@@ -27,12 +27,14 @@ TEST(FileNameTest, Parse) {
     { "100.log",            100,   kLogFile },
     { "0.log",              0,     kLogFile },
     { "0.sst",              0,     kTableFile },
+    { "42.blob",            42,    kBlobFile },
     { "CURRENT",            0,     kCurrentFile },
     { "LOCK",               0,     kDBLockFile },
     { "MANIFEST-2",         2,     kDescriptorFile },
     { "MANIFEST-7",         7,     kDescriptorFile },
     { "LOG",                0,     kInfoLogFile },
     { "LOG.old",            0,     kInfoLogFile },
+    { "CACHESTATE",         0,     kCacheStateFile },
     { "18446744073709551615.log", 18446744073709551615ull, kLogFile },
   };
   for (int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
@@ -61,11 +63,13 @@ TEST(FileNameTest, Parse) {
     "LOCKx",
     "LO",
     "LOGx",
+    "CACHESTATEx",
     "18446744073709551616.log",
     "184467440737095516150.log",
     "100",
     "100.",
-    "100.lop"
+    "100.lop",
+    "100.blobx"
   };
   for (int i = 0; i < sizeof(errors) / sizeof(errors[0]); i++) {
     std::string f = errors[i];
@@ -102,12 +106,24 @@ TEST(FileNameTest, Construction) {
   ASSERT_EQ(200, number);
   ASSERT_EQ(kTableFile, type);
 
+  fname = BlobFileName("bar", 300);
+  ASSERT_EQ("bar/", std::string(fname.data(), 4));
+  ASSERT_TRUE(ParseFileName(fname.c_str() + 4, &number, &type));
+  ASSERT_EQ(300, number);
+  ASSERT_EQ(kBlobFile, type);
+
   fname = DescriptorFileName("bar", 100);
   ASSERT_EQ("bar/", std::string(fname.data(), 4));
   ASSERT_TRUE(ParseFileName(fname.c_str() + 4, &number, &type));
   ASSERT_EQ(100, number);
   ASSERT_EQ(kDescriptorFile, type);
 
+  fname = CacheStateFileName("foo");
+  ASSERT_EQ("foo/", std::string(fname.data(), 4));
+  ASSERT_TRUE(ParseFileName(fname.c_str() + 4, &number, &type));
+  ASSERT_EQ(0, number);
+  ASSERT_EQ(kCacheStateFile, type);
+
   fname = TempFileName("tmp", 999);
   ASSERT_EQ("tmp/", std::string(fname.data(), 4));
   ASSERT_TRUE(ParseFileName(fname.c_str() + 4, &number, &type));
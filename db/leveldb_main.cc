@@ -159,6 +159,8 @@ bool DumpTable(Env* env, const std::string& fname) {
         type = "del";
       } else if (key.type == kTypeValue) {
         type = "val";
+      } else if (key.type == kTypeBlobIndex) {
+        type = "blob";
       } else {
         snprintf(kbuf, sizeof(kbuf), "%d", static_cast<int>(key.type));
         type = kbuf;
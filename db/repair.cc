@@ -109,6 +109,7 @@ class Repairer {
 
   std::vector<std::string> manifests_;
   std::vector<uint64_t> table_numbers_;
+  std::vector<uint64_t> blob_numbers_;
   std::vector<uint64_t> logs_;
   std::vector<TableInfo> tables_;
   uint64_t next_file_number_;
@@ -137,6 +138,8 @@ class Repairer {
             logs_.push_back(number);
           } else if (type == kTableFile) {
             table_numbers_.push_back(number);
+          } else if (type == kBlobFile) {
+            blob_numbers_.push_back(number);
           } else {
             // Ignore other files
           }
@@ -327,6 +330,16 @@ class Repairer {
                     t.meta.smallest, t.meta.largest);
     }
 
+    // Keep all blob files.  Without knowing which of their blobs are
+    // still referenced, they are recorded as holding no garbage.
+    for (size_t i = 0; i < blob_numbers_.size(); i++) {
+      uint64_t file_size;
+      if (env_->GetFileSize(BlobFileName(dbname_, blob_numbers_[i]),
+                            &file_size).ok() && file_size > 0) {
+        edit_.AddBlobFile(blob_numbers_[i], file_size);
+      }
+    }
+
     //fprintf(stderr, "NewDescriptor:\n%s\n", edit_.DebugString().c_str());
     {
       log::Writer log(file);
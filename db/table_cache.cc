@@ -4,9 +4,12 @@
 
 #include "db/table_cache.h"
 
+#include <algorithm>
+#include <map>
 #include "db/filename.h"
 #include "leveldb/env.h"
 #include "leveldb/table.h"
+#include "table/format.h"
 #include "util/coding.h"
 
 namespace leveldb {
@@ -14,6 +17,8 @@ namespace leveldb {
 struct TableAndFile {
   RandomAccessFile* file;
   Table* table;
+  uint64_t file_size;
+  uint64_t block_cache_id;
 };
 
 static void DeleteEntry(const Slice& key, void* value) {
@@ -29,13 +34,52 @@ static void UnrefEntry(void* arg1, void* arg2) {
   cache->Release(h);
 }
 
+// A row cache entry holds what the table handed to the saver for a
+// lookup: an empty string if the saver was not called, otherwise the
+// found internal key (length-prefixed) followed by the found value.
+static void DeleteRow(const Slice& key, void* value) {
+  std::string* row = reinterpret_cast<std::string*>(value);
+  delete row;
+}
+
+static bool DecodeRow(const std::string& row, Slice* found_key,
+                      Slice* found_value) {
+  Slice input(row);
+  if (!GetLengthPrefixedSlice(&input, found_key)) {
+    return false;
+  }
+  *found_value = input;
+  return true;
+}
+
+namespace {
+// Forwards to the caller's saver while recording the entry it was
+// given, so that the lookup can be replayed from the row cache.
+struct RowRecorder {
+  void* arg;
+  void (*saver)(void*, const Slice&, const Slice&);
+  std::string* row;
+};
+}
+
+static void RecordRow(void* arg, const Slice& k, const Slice& v) {
+  RowRecorder* r = reinterpret_cast<RowRecorder*>(arg);
+  r->row->clear();
+  PutLengthPrefixedSlice(r->row, k);
+  r->row->append(v.data(), v.size());
+  (*r->saver)(r->arg, k, v);
+}
+
 TableCache::TableCache(const std::string& dbname,
                        const Options* options,
                        int entries)
     : env_(options->env),
       dbname_(dbname),
       options_(options),
-      cache_(NewLRUCache(entries)) {
+      cache_(NewLRUCache(entries)),
+      row_cache_id_(options->row_cache != NULL ?
+                    options->row_cache->NewId() : 0),
+      cv_(&mu_) {
 }
 
 TableCache::~TableCache() {
@@ -51,15 +95,59 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
   Slice key(buf, sizeof(buf));
   // 在cache中查找key
   *handle = cache_->Lookup(key);
-  if (*handle == NULL) {
+  if (*handle != NULL) {
+    return s;
+  }
+
+  // Only one thread opens a table at a time; others that miss on it
+  // wait for the outcome instead of reading the same footer, index and
+  // filter blocks themselves.
+  mu_.Lock();
+  while (true) {
+    std::map<uint64_t, PendingOpen*>::iterator it =
+        pending_opens_.find(file_number);
+    if (it == pending_opens_.end()) {
+      *handle = cache_->Lookup(key);
+      if (*handle != NULL) {
+        mu_.Unlock();
+        return s;
+      }
+      break;
+    }
+    PendingOpen* pending = it->second;
+    pending->waiters++;
+    while (!pending->done) {
+      cv_.Wait();
+    }
+    s = pending->status;
+    if (--pending->waiters == 0) {
+      delete pending;
+    }
+    if (!s.ok()) {
+      mu_.Unlock();
+      return s;
+    }
+    // The table is in the cache now, unless it was evicted again.
+  }
+  PendingOpen* pending = new PendingOpen;
+  pending->done = false;
+  pending->waiters = 0;
+  pending_opens_[file_number] = pending;
+  mu_.Unlock();
+
+  {
 	// 如果找不到就生成一个
     std::string fname = TableFileName(dbname_, file_number);
     // 先打开文件
     RandomAccessFile* file = NULL;
     Table* table = NULL;
-    s = env_->NewRandomAccessFile(fname, &file);
+    if (options_->use_direct_reads) {
+      s = env_->NewDirectRandomAccessFile(fname, &file);
+    } else {
+      s = env_->NewRandomAccessFile(fname, &file);
+    }
     if (s.ok()) {
-      s = Table::Open(*options_, file, file_size, &table);
+      s = Table::Open(*options_, file, file_size, file_number, &table);
     }
 
     if (!s.ok()) {
@@ -71,9 +159,22 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
       TableAndFile* tf = new TableAndFile;
       tf->file = file;
       tf->table = table;
+      tf->file_size = file_size;
+      tf->block_cache_id = table->BlockCacheId();
       *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
     }
   }
+
+  mu_.Lock();
+  pending_opens_.erase(file_number);
+  pending->done = true;
+  pending->status = s;
+  if (pending->waiters == 0) {
+    delete pending;
+  } else {
+    cv_.SignalAll();
+  }
+  mu_.Unlock();
   return s;
 }
 
@@ -93,7 +194,15 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
 
   Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
   // 得到table之后根据table返回迭代器
-  Iterator* result = table->NewIterator(options);
+  Iterator* result;
+  if (options.iterate_upper_bound != NULL) {
+    InternalKey bound(*options.iterate_upper_bound, kMaxSequenceNumber,
+                      kValueTypeForSeek);
+    Slice encoded = bound.Encode();
+    result = table->NewIterator(options, &encoded);
+  } else {
+    result = table->NewIterator(options);
+  }
   result->RegisterCleanup(&UnrefEntry, cache_, handle);
   if (tableptr != NULL) {
     *tableptr = table;
@@ -106,17 +215,226 @@ Status TableCache::Get(const ReadOptions& options,
                        uint64_t file_size,
                        const Slice& k,
                        void* arg,
-                       void (*saver)(void*, const Slice&, const Slice&)) {
+                       void (*saver)(void*, const Slice&, const Slice&),
+                       Iterator** pinned) {
+  if (pinned != NULL) {
+    *pinned = NULL;
+  }
+
+  // A lookup without an explicit snapshot reads at a sequence number
+  // newer than everything in the file, so its outcome depends only on
+  // the user key and can be shared by all such lookups.  Reads at an
+  // older snapshot may see a different version and bypass the row cache.
+  Cache* row_cache = options_->row_cache;
+  std::string row_key;
+  if (row_cache != NULL && options.snapshot == NULL) {
+    PutVarint64(&row_key, row_cache_id_);
+    PutVarint64(&row_key, file_number);
+    Slice user_key = ExtractUserKey(k);
+    row_key.append(user_key.data(), user_key.size());
+    Cache::Handle* row_handle = row_cache->Lookup(row_key);
+    if (row_handle != NULL) {
+      const std::string* row =
+          reinterpret_cast<std::string*>(row_cache->Value(row_handle));
+      Slice found_key, found_value;
+      if (!row->empty() && DecodeRow(*row, &found_key, &found_value)) {
+        (*saver)(arg, found_key, found_value);
+        if (pinned != NULL) {
+          *pinned = NewEmptyIterator();
+          (*pinned)->RegisterCleanup(&UnrefEntry, row_cache, row_handle);
+          return Status::OK();
+        }
+      }
+      row_cache->Release(row_handle);
+      return Status::OK();
+    }
+  } else {
+    row_cache = NULL;
+  }
+
+  Cache::Handle* handle = NULL;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+    if (row_cache != NULL) {
+      std::string* row = new std::string;
+      RowRecorder recorder;
+      recorder.arg = arg;
+      recorder.saver = saver;
+      recorder.row = row;
+      s = t->InternalGet(options, k, &recorder, &RecordRow, pinned);
+      if (s.ok()) {
+        row_cache->Release(row_cache->Insert(
+            row_key, row, row_key.size() + row->size(), &DeleteRow));
+      } else {
+        delete row;
+      }
+    } else {
+      s = t->InternalGet(options, k, arg, saver, pinned);
+    }
+    if (pinned != NULL && *pinned != NULL) {
+      // The table must outlive the block pinned by the caller.
+      (*pinned)->RegisterCleanup(&UnrefEntry, cache_, handle);
+    } else {
+      cache_->Release(handle);
+    }
+  }
+  return s;
+}
+
+namespace {
+struct TableWalkState {
+  std::vector<TableCache::CachedTable>* tables;
+  std::map<uint64_t, size_t> index;  // Block cache id => position in tables
+};
+}
+
+void TableCache::AddCachedTable(void* arg, const Slice& key, void* value) {
+  TableWalkState* state = reinterpret_cast<TableWalkState*>(arg);
+  const TableAndFile* tf = reinterpret_cast<TableAndFile*>(value);
+  TableCache::CachedTable table;
+  table.number = DecodeFixed64(key.data());
+  table.file_size = tf->file_size;
+  state->index[tf->block_cache_id] = state->tables->size();
+  state->tables->push_back(table);
+}
+
+void TableCache::AddCachedBlock(void* arg, const Slice& key, void* value) {
+  TableWalkState* state = reinterpret_cast<TableWalkState*>(arg);
+  uint64_t cache_id, offset;
+  if (Table::ParseBlockCacheKey(key, &cache_id, &offset)) {
+    std::map<uint64_t, size_t>::iterator it = state->index.find(cache_id);
+    if (it != state->index.end()) {
+      (*state->tables)[it->second].block_offsets.push_back(offset);
+    }
+  }
+}
+
+void TableCache::GetCachedTables(std::vector<CachedTable>* tables) {
+  tables->clear();
+  TableWalkState state;
+  state.tables = tables;
+  cache_->Walk(&AddCachedTable, &state);
+  if (options_->block_cache != NULL) {
+    options_->block_cache->Walk(&AddCachedBlock, &state);
+  }
+  for (size_t i = 0; i < tables->size(); i++) {
+    std::vector<uint64_t>* offsets = &(*tables)[i].block_offsets;
+    std::sort(offsets->begin(), offsets->end());
+  }
+}
+
+Status TableCache::LoadTable(const CachedTable& table) {
+  Cache::Handle* handle = NULL;
+  Status s = FindTable(table.number, table.file_size, &handle);
+  if (s.ok()) {
+    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+    s = t->LoadBlocks(table.block_offsets);
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+Status TableCache::LoadAllBlocks(uint64_t file_number, uint64_t file_size) {
+  Cache::Handle* handle = NULL;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+    s = t->LoadAllBlocks();
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+Status TableCache::SampleKeys(uint64_t file_number, uint64_t file_size,
+                              int n, std::vector<std::string>* keys,
+                              std::vector<uint64_t>* offsets) {
+  keys->clear();
+  offsets->clear();
   Cache::Handle* handle = NULL;
   Status s = FindTable(file_number, file_size, &handle);
   if (s.ok()) {
     Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-    s = t->InternalGet(options, k, arg, saver);
+    t->SampleIndexKeys(n, keys, offsets);
     cache_->Release(handle);
   }
   return s;
 }
 
+void TableCache::MultiGet(
+    const ReadOptions& options, const GetRequest* reqs, size_t n,
+    void (*saver)(void*, const Slice&, const Slice&),
+    Status* statuses) {
+  // Find the block each lookup needs and set up one read per block
+  // that is not at hand.
+  std::vector<Cache::Handle*> tables(n, NULL);
+  std::vector<Iterator*> blocks(n, NULL);
+  std::vector<ReadRequest> reads;
+  std::vector<std::pair<const Table*, BlockHandle> > read_blocks;
+  std::map<std::pair<uint64_t, uint64_t>, size_t> read_index;
+  std::vector<size_t> read_of(n, ~static_cast<size_t>(0));  // Index in reads
+  for (size_t i = 0; i < n; i++) {
+    const GetRequest& req = reqs[i];
+    statuses[i] = FindTable(req.file_number, req.file_size, &tables[i]);
+    if (!statuses[i].ok()) {
+      tables[i] = NULL;
+      continue;
+    }
+    const Table* t =
+        reinterpret_cast<TableAndFile*>(cache_->Value(tables[i]))->table;
+    BlockHandle handle;
+    if (!t->PrepareGet(options, req.key, &handle, &blocks[i], &statuses[i]) ||
+        blocks[i] != NULL) {
+      continue;
+    }
+    std::pair<uint64_t, uint64_t> id(req.file_number, handle.offset());
+    std::map<std::pair<uint64_t, uint64_t>, size_t>::iterator it =
+        read_index.find(id);
+    if (it != read_index.end()) {
+      read_of[i] = it->second;
+    } else {
+      read_of[i] = reads.size();
+      read_index[id] = reads.size();
+      reads.push_back(ReadRequest());
+      t->PrepareBlockRead(handle, &reads.back());
+      read_blocks.push_back(std::make_pair(t, handle));
+    }
+  }
+
+  std::vector<Iterator*> read_iters(reads.size(), NULL);
+  if (!reads.empty()) {
+    env_->MultiRead(&reads[0], reads.size());
+    for (size_t r = 0; r < reads.size(); r++) {
+      read_iters[r] = read_blocks[r].first->FinishBlockRead(
+          options, read_blocks[r].second, &reads[r]);
+    }
+  }
+
+  // Lookups that share a block search it one after the other.
+  for (size_t i = 0; i < n; i++) {
+    Iterator* block = blocks[i];
+    if (block == NULL && read_of[i] < reads.size()) {
+      block = read_iters[read_of[i]];
+    }
+    if (block != NULL) {
+      block->Seek(reqs[i].key);
+      if (block->Valid()) {
+        (*saver)(reqs[i].arg, block->key(), block->value());
+      }
+      statuses[i] = block->status();
+    }
+    delete blocks[i];
+  }
+  for (size_t r = 0; r < read_iters.size(); r++) {
+    delete read_iters[r];
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (tables[i] != NULL) {
+      cache_->Release(tables[i]);
+    }
+  }
+}
+
 void TableCache::Evict(uint64_t file_number) {
   char buf[sizeof(file_number)];
   EncodeFixed64(buf, file_number);
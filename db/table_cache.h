@@ -7,7 +7,9 @@
 #ifndef STORAGE_LEVELDB_DB_TABLE_CACHE_H_
 #define STORAGE_LEVELDB_DB_TABLE_CACHE_H_
 
+#include <map>
 #include <string>
+#include <vector>
 #include <stdint.h>
 #include "db/dbformat.h"
 #include "leveldb/cache.h"
@@ -37,23 +39,93 @@ class TableCache {
 
   // If a seek to internal key "k" in specified file finds an entry,
   // call (*handle_result)(arg, found_key, found_value).
+  //
+  // If "pinned" is non-NULL and an entry was found, *pinned is set to
+  // an iterator that keeps found_key and found_value (and the table
+  // they came from) live until the caller deletes it.  Otherwise
+  // *pinned is set to NULL.
+  //
+  // If options->row_cache is set, the outcome of lookups that do not
+  // use an explicit snapshot is cached per (file, user key), and later
+  // lookups of the same key are answered without touching the table.
   Status Get(const ReadOptions& options,
              uint64_t file_number,
              uint64_t file_size,
              const Slice& k,
              void* arg,
-             void (*handle_result)(void*, const Slice&, const Slice&));
+             void (*handle_result)(void*, const Slice&, const Slice&),
+             Iterator** pinned = NULL);
+
+  // A lookup of internal key "key" in the specified file, for MultiGet()
+  struct GetRequest {
+    uint64_t file_number;
+    uint64_t file_size;
+    Slice key;
+    void* arg;          // Passed to handle_result
+  };
+
+  // Like Get() for each of reqs[0,n-1], without "pinned" and the row
+  // cache, and with the table reads of all the lookups issued together
+  // with Env::MultiRead().  Stores the status of reqs[i] in statuses[i].
+  void MultiGet(const ReadOptions& options, const GetRequest* reqs, size_t n,
+                void (*handle_result)(void*, const Slice&, const Slice&),
+                Status* statuses);
 
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
 
+  // A table in the cache and the data blocks of it that are held in
+  // options->block_cache.
+  struct CachedTable {
+    uint64_t number;
+    uint64_t file_size;
+    std::vector<uint64_t> block_offsets;  // Sorted
+  };
+
+  // Store in *tables the tables in the cache, roughly from the least to
+  // the most recently used one.
+  void GetCachedTables(std::vector<CachedTable>* tables);
+
+  // Add the table described by "table" to the cache and read its listed
+  // blocks into options->block_cache.
+  Status LoadTable(const CachedTable& table);
+
+  // Add the specified table to the cache and read all of its data
+  // blocks into options->block_cache.
+  Status LoadAllBlocks(uint64_t file_number, uint64_t file_size);
+
+  // Store in *keys up to "n" internal keys spread evenly over the
+  // specified file, always including its last block's index key, and
+  // in *offsets the approximate file offset at which the data up to
+  // each of them ends.
+  Status SampleKeys(uint64_t file_number, uint64_t file_size, int n,
+                    std::vector<std::string>* keys,
+                    std::vector<uint64_t>* offsets);
+
  private:
   Env* const env_;
   const std::string dbname_;
   const Options* options_;
   Cache* cache_;
+  const uint64_t row_cache_id_;
+
+  // A table being opened by FindTable(), which other threads that need
+  // the same table wait for.
+  struct PendingOpen {
+    bool done;
+    Status status;
+    int waiters;      // Threads waiting for the outcome
+  };
+
+  port::Mutex mu_;
+  port::CondVar cv_;  // Signalled when an open is done
+  std::map<uint64_t, PendingOpen*> pending_opens_;  // Guarded by mu_
 
   Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+
+  // Cache::Walk() callbacks of GetCachedTables()
+  static void AddCachedTable(void* arg, const Slice& key, void* value);
+  static void AddCachedBlock(void* arg, const Slice& key, void* value);
 };
 
 }  // namespace leveldb
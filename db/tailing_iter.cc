@@ -0,0 +1,198 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/tailing_iter.h"
+
+#include <vector>
+#include "db/db_impl.h"
+#include "db/db_iter.h"
+#include "db/memtable.h"
+#include "db/version_set.h"
+#include "table/merger.h"
+
+namespace leveldb {
+
+namespace {
+
+// Forwards to an iterator that it does not own, so that the iterator
+// can outlive the merging iterator it is handed to.
+class BorrowedIterator : public Iterator {
+ public:
+  explicit BorrowedIterator(Iterator* iter) : iter_(iter) { }
+  virtual bool Valid() const { return iter_->Valid(); }
+  virtual void SeekToFirst() { iter_->SeekToFirst(); }
+  virtual void SeekToLast() { iter_->SeekToLast(); }
+  virtual void Seek(const Slice& target) { iter_->Seek(target); }
+  virtual void Next() { iter_->Next(); }
+  virtual void Prev() { iter_->Prev(); }
+  virtual Slice key() const { return iter_->key(); }
+  virtual Slice value() const { return iter_->value(); }
+  virtual Status status() const { return iter_->status(); }
+
+ private:
+  Iterator* const iter_;
+};
+
+// A TailingIterator keeps the iterators over the table files of the
+// version it last saw across refreshes, and only rebuilds the cheap
+// memtable iterators and the DBIter on top of them when there were new
+// writes.  The table iterators are only replaced when the version
+// changes, i.e. after a compaction.
+class TailingIterator : public Iterator {
+ public:
+  TailingIterator(DBImpl* db, const std::string* dbname, Env* env,
+                  const InternalKeyComparator* icmp,
+                  const ReadOptions& options, uint32_t seed)
+      : db_(db),
+        dbname_(dbname),
+        env_(env),
+        icmp_(icmp),
+        options_(options),
+        seed_(seed),
+        mem_(NULL),
+        imm_(NULL),
+        version_(NULL),
+        sequence_(0),
+        iter_(NULL) {
+  }
+
+  virtual ~TailingIterator() {
+    delete iter_;
+    DeleteTableIterators();
+    db_->ReleaseReadState(mem_, imm_, version_);
+  }
+
+  virtual bool Valid() const {
+    return status_.ok() && iter_ != NULL && iter_->Valid();
+  }
+  virtual Slice key() const {
+    assert(Valid());
+    return iter_->key();
+  }
+  virtual Slice value() const {
+    assert(Valid());
+    return iter_->value();
+  }
+  virtual Status status() const {
+    if (!status_.ok()) {
+      return status_;
+    } else if (iter_ != NULL) {
+      return iter_->status();
+    }
+    return Status::OK();
+  }
+
+  virtual void SeekToFirst() {
+    status_ = Status::OK();
+    Refresh();
+    iter_->SeekToFirst();
+  }
+  virtual void Seek(const Slice& target) {
+    status_ = Status::OK();
+    Refresh();
+    iter_->Seek(target);
+  }
+
+  virtual void Next() {
+    assert(Valid());
+    last_key_.assign(iter_->key().data(), iter_->key().size());
+    iter_->Next();
+    if (!iter_->Valid() && iter_->status().ok() && Refresh()) {
+      // Passed the last entry, but there were new writes: continue
+      // after the last key returned.
+      iter_->Seek(last_key_);
+      if (iter_->Valid() &&
+          icmp_->user_comparator()->Compare(iter_->key(), last_key_) == 0) {
+        iter_->Next();
+      }
+    }
+  }
+
+  virtual void SeekToLast() {
+    status_ = Status::NotSupported("SeekToLast() on a tailing iterator");
+  }
+  virtual void Prev() {
+    status_ = Status::NotSupported("Prev() on a tailing iterator");
+  }
+
+ private:
+  // Catch up with the current state of the DB.  Returns true iff iter_
+  // was rebuilt.  iter_ is left unpositioned if so.
+  bool Refresh() {
+    Version* old_version = version_;
+    MemTable* old_mem = mem_;
+    MemTable* old_imm = imm_;
+    const SequenceNumber sequence =
+        db_->RefreshReadState(&mem_, &imm_, &version_);
+    if (iter_ != NULL && sequence == sequence_ && mem_ == old_mem &&
+        imm_ == old_imm && version_ == old_version) {
+      return false;
+    }
+    sequence_ = sequence;
+
+    delete iter_;
+    if (version_ != old_version) {
+      DeleteTableIterators();
+      version_->AddIterators(options_, &table_iters_);
+    }
+    std::vector<Iterator*> list;
+    list.push_back(mem_->NewIterator());
+    if (imm_ != NULL) {
+      list.push_back(imm_->NewIterator());
+    }
+    for (size_t i = 0; i < table_iters_.size(); i++) {
+      list.push_back(new BorrowedIterator(table_iters_[i]));
+    }
+    Iterator* internal_iter =
+        NewMergingIterator(icmp_, &list[0], list.size());
+    iter_ = NewDBIterator(db_, dbname_, env_, icmp_->user_comparator(),
+                          internal_iter, sequence_, seed_,
+                          options_.iterate_lower_bound,
+                          options_.iterate_upper_bound);
+    return true;
+  }
+
+  void DeleteTableIterators() {
+    for (size_t i = 0; i < table_iters_.size(); i++) {
+      delete table_iters_[i];
+    }
+    table_iters_.clear();
+  }
+
+  DBImpl* const db_;
+  const std::string* const dbname_;
+  Env* const env_;
+  const InternalKeyComparator* const icmp_;
+  const ReadOptions options_;
+  const uint32_t seed_;
+
+  // The state iter_ reads from; each part is Ref()-ed.
+  MemTable* mem_;
+  MemTable* imm_;
+  Version* version_;
+  SequenceNumber sequence_;
+
+  std::vector<Iterator*> table_iters_;   // Over the files of version_
+  Iterator* iter_;                       // NULL before the first refresh
+  std::string last_key_;                 // Key before the latest Next()
+  Status status_;
+
+  // No copying allowed
+  TailingIterator(const TailingIterator&);
+  void operator=(const TailingIterator&);
+};
+
+}  // namespace
+
+Iterator* NewTailingIterator(
+    DBImpl* db,
+    const std::string* dbname,
+    Env* env,
+    const InternalKeyComparator* icmp,
+    const ReadOptions& options,
+    uint32_t seed) {
+  return new TailingIterator(db, dbname, env, icmp, options, seed);
+}
+
+}  // namespace leveldb
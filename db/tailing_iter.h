@@ -0,0 +1,29 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_TAILING_ITER_H_
+#define STORAGE_LEVELDB_DB_TAILING_ITER_H_
+
+#include <stdint.h>
+#include "leveldb/db.h"
+#include "db/dbformat.h"
+
+namespace leveldb {
+
+class DBImpl;
+
+// Return a new forward-only iterator over the user keys of "*db" that
+// follows writes made after its creation (see ReadOptions::tailing).
+// "seed" is passed on to NewDBIterator().
+extern Iterator* NewTailingIterator(
+    DBImpl* db,
+    const std::string* dbname,
+    Env* env,
+    const InternalKeyComparator* icmp,
+    const ReadOptions& options,
+    uint32_t seed);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_TAILING_ITER_H_
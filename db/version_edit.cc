@@ -20,7 +20,11 @@ enum Tag {
   kDeletedFile          = 6,
   kNewFile              = 7,
   // 8 was used for large value refs
-  kPrevLogNumber        = 9
+  kPrevLogNumber        = 9,
+  kNewBlobFile          = 10,
+  kBlobGarbage          = 11,
+  kFileExpiry           = 12,
+  kFileEntryCounts      = 13
 };
 
 void VersionEdit::Clear() {
@@ -36,6 +40,8 @@ void VersionEdit::Clear() {
   has_last_sequence_ = false;
   deleted_files_.clear();
   new_files_.clear();
+  new_blob_files_.clear();
+  blob_garbage_.clear();
 }
 
 // encode VersionEdit的信息到字符串中返回
@@ -91,6 +97,30 @@ void VersionEdit::EncodeTo(std::string* dst) const {
     PutVarint64(dst, f.file_size);
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
+    if (f.oldest_expiry != 0) {
+      // Older versions reject the tag, so it is only written when needed
+      PutVarint32(dst, kFileExpiry);
+      PutVarint64(dst, f.number);
+      PutVarint64(dst, f.oldest_expiry);
+    }
+    if (f.num_entries != 0) {
+      PutVarint32(dst, kFileEntryCounts);
+      PutVarint64(dst, f.number);
+      PutVarint64(dst, f.num_entries);
+      PutVarint64(dst, f.num_deletions);
+    }
+  }
+
+  for (size_t i = 0; i < new_blob_files_.size(); i++) {
+    PutVarint32(dst, kNewBlobFile);
+    PutVarint64(dst, new_blob_files_[i].first);   // file number
+    PutVarint64(dst, new_blob_files_[i].second);  // total bytes
+  }
+
+  for (size_t i = 0; i < blob_garbage_.size(); i++) {
+    PutVarint32(dst, kBlobGarbage);
+    PutVarint64(dst, blob_garbage_[i].first);     // file number
+    PutVarint64(dst, blob_garbage_[i].second);    // garbage bytes
   }
 }
 
@@ -124,6 +154,9 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
   // Temporary storage for parsing
   int level;
   uint64_t number;
+  uint64_t bytes;
+  uint64_t expiry;
+  uint64_t entries, deletions;
   FileMetaData f;
   Slice str;
   InternalKey key;
@@ -205,6 +238,48 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         }
         break;
 
+      case kFileExpiry:
+        if (GetVarint64(&input, &number) &&
+            GetVarint64(&input, &expiry) &&
+            !new_files_.empty() &&
+            new_files_.back().second.number == number) {
+          new_files_.back().second.oldest_expiry = expiry;
+        } else {
+          msg = "file-expiry entry";
+        }
+        break;
+
+      case kFileEntryCounts:
+        if (GetVarint64(&input, &number) &&
+            GetVarint64(&input, &entries) &&
+            GetVarint64(&input, &deletions) &&
+            !new_files_.empty() &&
+            new_files_.back().second.number == number) {
+          new_files_.back().second.num_entries = entries;
+          new_files_.back().second.num_deletions = deletions;
+        } else {
+          msg = "file-entry-counts entry";
+        }
+        break;
+
+      case kNewBlobFile:
+        if (GetVarint64(&input, &number) &&
+            GetVarint64(&input, &bytes)) {
+          new_blob_files_.push_back(std::make_pair(number, bytes));
+        } else {
+          msg = "new-blob-file entry";
+        }
+        break;
+
+      case kBlobGarbage:
+        if (GetVarint64(&input, &number) &&
+            GetVarint64(&input, &bytes)) {
+          blob_garbage_.push_back(std::make_pair(number, bytes));
+        } else {
+          msg = "blob-garbage entry";
+        }
+        break;
+
       default:
         msg = "unknown tag";
         break;
@@ -271,6 +346,28 @@ std::string VersionEdit::DebugString() const {
     r.append(f.smallest.DebugString());
     r.append(" .. ");
     r.append(f.largest.DebugString());
+    if (f.oldest_expiry != 0) {
+      r.append(" expires ");
+      AppendNumberTo(&r, f.oldest_expiry);
+    }
+    if (f.num_entries != 0) {
+      r.append(" entries ");
+      AppendNumberTo(&r, f.num_entries);
+      r.append(" deletions ");
+      AppendNumberTo(&r, f.num_deletions);
+    }
+  }
+  for (size_t i = 0; i < new_blob_files_.size(); i++) {
+    r.append("\n  AddBlobFile: ");
+    AppendNumberTo(&r, new_blob_files_[i].first);
+    r.append(" ");
+    AppendNumberTo(&r, new_blob_files_[i].second);
+  }
+  for (size_t i = 0; i < blob_garbage_.size(); i++) {
+    r.append("\n  BlobGarbage: ");
+    AppendNumberTo(&r, blob_garbage_[i].first);
+    r.append(" ");
+    AppendNumberTo(&r, blob_garbage_[i].second);
   }
   r.append("\n}\n");
   return r;
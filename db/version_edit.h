@@ -28,8 +28,28 @@ struct FileMetaData {
   InternalKey smallest;       // Smallest internal key served by table
   // 最大key
   InternalKey largest;        // Largest internal key served by table
+  // Earliest expiry time of the values in the table (see Options::ttl),
+  // or zero if none of them expires
+  uint64_t oldest_expiry;
+  // Number of entries in the table, and how many of them are deletion
+  // markers.  Zero if unknown.
+  uint64_t num_entries;
+  uint64_t num_deletions;
+
+  FileMetaData()
+      : refs(0), allowed_seeks(1 << 30), file_size(0), oldest_expiry(0),
+        num_entries(0), num_deletions(0) { }
+};
+
+// Metadata of a blob file (see db/blob_file.h).  Every blob in the file
+// is referenced by exactly one table entry until that entry is dropped
+// or its blob is moved to another file, which turns the blob into
+// garbage.  A file whose bytes are all garbage is no longer needed.
+struct BlobFileMetaData {
+  uint64_t total_bytes;       // Size of all blobs, including trailers
+  uint64_t garbage_bytes;     // Size of the blobs no longer referenced
 
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) { }
+  BlobFileMetaData() : total_bytes(0), garbage_bytes(0) { }
 };
 
 // 用于记录compact过程中，对Version进行的修改操作。
@@ -71,21 +91,42 @@ class VersionEdit {
   void AddFile(int level, uint64_t file,
                uint64_t file_size,
                const InternalKey& smallest,
-               const InternalKey& largest) {
+               const InternalKey& largest,
+               uint64_t oldest_expiry = 0) {
     // FileMetaData存放新增文件的信息
     FileMetaData f;
     f.number = file;
     f.file_size = file_size;
     f.smallest = smallest;
     f.largest = largest;
+    f.oldest_expiry = oldest_expiry;
     new_files_.push_back(std::make_pair(level, f));
   }
 
+  // Add the file described by the metadata of "f" at the specified level.
+  void AddFile(int level, const FileMetaData& f) {
+    AddFile(level, f.number, f.file_size, f.smallest, f.largest,
+            f.oldest_expiry);
+    new_files_.back().second.num_entries = f.num_entries;
+    new_files_.back().second.num_deletions = f.num_deletions;
+  }
+
   // Delete the specified "file" from the specified "level".
   void DeleteFile(int level, uint64_t file) {
     deleted_files_.insert(std::make_pair(level, file));
   }
 
+  // Add the specified blob file, which holds "total_bytes" bytes.
+  void AddBlobFile(uint64_t file, uint64_t total_bytes) {
+    new_blob_files_.push_back(std::make_pair(file, total_bytes));
+  }
+
+  // Record that "bytes" more bytes of the specified blob file are
+  // no longer referenced.
+  void AddBlobGarbage(uint64_t file, uint64_t bytes) {
+    blob_garbage_.push_back(std::make_pair(file, bytes));
+  }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(const Slice& src);
 
@@ -113,6 +154,10 @@ class VersionEdit {
   DeletedFileSet deleted_files_;
   // 新文件
   std::vector< std::pair<int, FileMetaData> > new_files_;
+  // <blob file number, total bytes> of new blob files
+  std::vector< std::pair<uint64_t, uint64_t> > new_blob_files_;
+  // <blob file number, bytes> of newly unreferenced blobs
+  std::vector< std::pair<uint64_t, uint64_t> > blob_garbage_;
 };
 
 }  // namespace leveldb
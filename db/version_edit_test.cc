@@ -27,9 +27,20 @@ TEST(VersionEditTest, EncodeDecode) {
     TestEncodeDecode(edit);
     edit.AddFile(3, kBig + 300 + i, kBig + 400 + i,
                  InternalKey("foo", kBig + 500 + i, kTypeValue),
-                 InternalKey("zoo", kBig + 600 + i, kTypeDeletion));
+                 InternalKey("zoo", kBig + 600 + i, kTypeDeletion),
+                 (i % 2 == 0) ? 0 : kBig + 800 + i);
+    FileMetaData f;
+    f.number = kBig + 800 + i;
+    f.file_size = kBig + 900 + i;
+    f.smallest = InternalKey("bar", kBig + 500 + i, kTypeValue);
+    f.largest = InternalKey("baz", kBig + 600 + i, kTypeValue);
+    f.num_entries = (i % 2 == 0) ? 0 : kBig + 1000 + i;
+    f.num_deletions = (i % 2 == 0) ? 0 : i;
+    edit.AddFile(2, f);
     edit.DeleteFile(4, kBig + 700 + i);
     edit.SetCompactPointer(i, InternalKey("x", kBig + 900 + i, kTypeValue));
+    edit.AddBlobFile(kBig + 1100 + i, kBig + 1200 + i);
+    edit.AddBlobGarbage(kBig + 1300 + i, kBig + 1400 + i);
   }
 
   edit.SetComparatorName("foo");
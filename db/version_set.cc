@@ -21,18 +21,24 @@
 namespace leveldb {
 
 // compact 过程中， level-0 中的 sstable 由 memtable 直接 dump 生成，不做大小限制
-// 非 level-0 中的 sstable 的大小设定为 kTargetFileSize
-static const int kTargetFileSize = 2 * 1048576;
+// 非 level-0 中的 sstable 的大小设定为 TargetFileSize
+static uint64_t TargetFileSize(const Options* options) {
+  return options->max_file_size;
+}
 
 // Maximum bytes of overlaps in grandparent (i.e., level+2) before we
 // stop building a single file in a level->level+1 compaction.
 // compact过程中，允许level-n与level-n+2之间产生overlap的数据size
-static const int64_t kMaxGrandParentOverlapBytes = 10 * kTargetFileSize;
+static int64_t MaxGrandParentOverlapBytes(const Options* options) {
+  return options->max_grandparent_overlap_factor * TargetFileSize(options);
+}
 
 // Maximum number of bytes in all compacted files.  We avoid expanding
 // the lower level file set of a compaction if it would make the
 // total compaction cover more than this many bytes.
-static const int64_t kExpandedCompactionByteSizeLimit = 25 * kTargetFileSize;
+static int64_t ExpandedCompactionByteSizeLimit(const Options* options) {
+  return options->expanded_compaction_factor * TargetFileSize(options);
+}
 
 // 计算一个level的最大Bytes
 static double MaxBytesForLevel(int level) {
@@ -49,8 +55,9 @@ static double MaxBytesForLevel(int level) {
 }
 
 // 返回每层最大的文件大小
-static uint64_t MaxFileSizeForLevel(int level) {
-  return kTargetFileSize;  // We could vary per level to reduce number of files?
+static uint64_t MaxFileSizeForLevel(const Options* options, int level) {
+  // We could vary per level to reduce number of files?
+  return TargetFileSize(options);
 }
 
 // 返回这些文件集合的大小之和
@@ -189,23 +196,28 @@ bool SomeFileOverlapsRange(
 // value()：16byte保存了文件号以及文件大小的值，两个数字都是fixed64类型
 class Version::LevelFileNumIterator : public Iterator {
  public:
+  // Only the files in [begin, end) of "*flist" are visited.
   LevelFileNumIterator(const InternalKeyComparator& icmp,
-                       const std::vector<FileMetaData*>* flist)
+                       const std::vector<FileMetaData*>* flist,
+                       uint32_t begin, uint32_t end)
       : icmp_(icmp),
         flist_(flist),
-        index_(flist->size()) {        // Marks as invalid
+        begin_(begin),
+        end_(end),
+        index_(end) {        // Marks as invalid
   }
   virtual bool Valid() const {
-    return index_ < flist_->size();
+    return index_ >= begin_ && index_ < end_;
   }
   virtual void Seek(const Slice& target) {
-    index_ = FindFile(icmp_, *flist_, target);
+    index_ = std::max(FindFile(icmp_, *flist_, target),
+                      static_cast<int>(begin_));
   }
   // SeekToFirst直接将index置为0
-  virtual void SeekToFirst() { index_ = 0; }
+  virtual void SeekToFirst() { index_ = begin_; }
   // SeekToLast直接将index置为最后的index
   virtual void SeekToLast() {
-    index_ = flist_->empty() ? 0 : flist_->size() - 1;
+    index_ = (end_ == begin_) ? end_ : end_ - 1;
   }
   virtual void Next() {
     assert(Valid());
@@ -213,8 +225,8 @@ class Version::LevelFileNumIterator : public Iterator {
   }
   virtual void Prev() {
     assert(Valid());
-    if (index_ == 0) {
-      index_ = flist_->size();  // Marks as invalid
+    if (index_ == begin_) {
+      index_ = end_;  // Marks as invalid
     } else {
       index_--;
     }
@@ -235,6 +247,8 @@ class Version::LevelFileNumIterator : public Iterator {
  private:
   const InternalKeyComparator icmp_;
   const std::vector<FileMetaData*>* const flist_;
+  const uint32_t begin_;
+  const uint32_t end_;
   uint32_t index_;
 
   // Backing store for value().  Holds the file number and size.
@@ -258,19 +272,49 @@ static Iterator* GetFileIterator(void* arg,
 
 Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
                                             int level) const {
+  // Leave out the files that only hold keys outside the iterator bounds.
+  const std::vector<FileMetaData*>& files = files_[level];
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  uint32_t begin = 0;
+  uint32_t end = files.size();
+  if (options.iterate_lower_bound != NULL) {
+    InternalKey lower(*options.iterate_lower_bound, kMaxSequenceNumber,
+                      kValueTypeForSeek);
+    begin = FindFile(vset_->icmp_, files, lower.Encode());
+  }
+  if (options.iterate_upper_bound != NULL) {
+    InternalKey upper(*options.iterate_upper_bound, kMaxSequenceNumber,
+                      kValueTypeForSeek);
+    end = FindFile(vset_->icmp_, files, upper.Encode());
+    if (end < files.size() &&
+        ucmp->Compare(files[end]->smallest.user_key(),
+                      *options.iterate_upper_bound) < 0) {
+      end++;  // The file straddles the bound
+    }
+    end = std::max(begin, end);
+  }
   return NewTwoLevelIterator(
-      new LevelFileNumIterator(vset_->icmp_, &files_[level]),
-      &GetFileIterator, vset_->table_cache_, options);
+      new LevelFileNumIterator(vset_->icmp_, &files, begin, end),
+      &GetFileIterator, vset_->table_cache_, options, vset_->env_);
 }
 
 void Version::AddIterators(const ReadOptions& options,
                            std::vector<Iterator*>* iters) {
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
   // 对于0级文件，全部添加进来，因为其中可能有重叠
   // Merge all level zero files together since they may overlap
   for (size_t i = 0; i < files_[0].size(); i++) {
+    const FileMetaData* f = files_[0][i];
+    if ((options.iterate_lower_bound != NULL &&
+         ucmp->Compare(f->largest.user_key(),
+                       *options.iterate_lower_bound) < 0) ||
+        (options.iterate_upper_bound != NULL &&
+         ucmp->Compare(f->smallest.user_key(),
+                       *options.iterate_upper_bound) >= 0)) {
+      continue;  // Entirely outside the iterator bounds
+    }
     iters->push_back(
-        vset_->table_cache_->NewIterator(
-            options, files_[0][i]->number, files_[0][i]->file_size));
+        vset_->table_cache_->NewIterator(options, f->number, f->file_size));
   }
 
   // 对于>0级文件，使用NewConcatenatingIterator类型的iterator
@@ -296,7 +340,9 @@ struct Saver {
   SaverState state;
   const Comparator* ucmp;
   Slice user_key;
-  std::string* value;
+  Slice value;  // Points into the block pinned by TableCache::Get()
+  std::string* copy;  // If non-NULL, the value is also copied here
+  bool is_blob_index;
 };
 }
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -306,14 +352,22 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
     s->state = kCorrupt;
   } else {
     if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
-      s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
+      s->state = (parsed_key.type == kTypeDeletion) ? kDeleted : kFound;
       if (s->state == kFound) {
-        s->value->assign(v.data(), v.size());
+        s->value = v;
+        if (s->copy != NULL) {
+          s->copy->assign(v.data(), v.size());
+        }
+        s->is_blob_index = (parsed_key.type == kTypeBlobIndex);
       }
     }
   }
 }
 
+static void DeleteIterator(void* arg1, void* arg2) {
+  delete reinterpret_cast<Iterator*>(arg1);
+}
+
 // 文件序号越大的越新
 static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
   return a->number > b->number;
@@ -322,8 +376,9 @@ static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
 // 查询key
 Status Version::Get(const ReadOptions& options,
                     const LookupKey& k,
-                    std::string* value,
-                    GetStats* stats) {
+                    PinnableSlice* value,
+                    GetStats* stats,
+                    bool* is_blob_index) {
   Slice ikey = k.internal_key();
   Slice user_key = k.user_key();
   const Comparator* ucmp = vset_->icmp_.user_comparator();
@@ -331,6 +386,7 @@ Status Version::Get(const ReadOptions& options,
 
   stats->seek_file = NULL;
   stats->seek_file_level = -1;
+  *is_blob_index = false;
   FileMetaData* last_file_read = NULL;
   int last_file_read_level = -1;
 
@@ -410,10 +466,20 @@ Status Version::Get(const ReadOptions& options,
       saver.state = kNotFound;
       saver.ucmp = ucmp;
       saver.user_key = user_key;
-      saver.value = value;
+      saver.copy = NULL;
+      saver.is_blob_index = false;
+      Iterator* pinned_iter = NULL;
       // 这里会读取LRU cache中存储的Table指针,再调用Table指针的InternalGet函数去查找数据(但是这里是磁盘I/O)
       s = vset_->table_cache_->Get(options, f->number, f->file_size,
-                                   ikey, &saver, SaveValue);
+                                   ikey, &saver, SaveValue, &pinned_iter);
+      if (saver.state == kFound && s.ok()) {
+        // Hand the block holding the value over to the caller.
+        assert(pinned_iter != NULL);
+        value->PinSlice(saver.value, &DeleteIterator, pinned_iter, NULL);
+        *is_blob_index = saver.is_blob_index;
+      } else {
+        delete pinned_iter;
+      }
       if (!s.ok()) {
         return s;
       }
@@ -436,6 +502,111 @@ Status Version::Get(const ReadOptions& options,
   return Status::NotFound(Slice());  // Use an empty error message for speed
 }
 
+void Version::MultiGet(const ReadOptions& options,
+                       const std::vector<LookupKey*>& keys,
+                       std::vector<std::string>* values,
+                       std::vector<Status>* statuses,
+                       std::vector<bool>* is_blob_index) {
+  const size_t n = keys.size();
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  values->assign(n, std::string());
+  statuses->assign(n, Status::NotFound(Slice()));
+  is_blob_index->assign(n, false);
+
+  std::vector<Saver> savers(n);
+  std::vector<size_t> pending;
+  for (size_t i = 0; i < n; i++) {
+    savers[i].state = kNotFound;
+    savers[i].ucmp = ucmp;
+    savers[i].user_key = keys[i]->user_key();
+    savers[i].copy = &(*values)[i];
+    savers[i].is_blob_index = false;
+    pending.push_back(i);
+  }
+
+  // Level-0 files may overlap each other, so each of them is a round of
+  // lookups, from the newest file to the oldest.  Every other level is a
+  // single round.
+  std::vector<FileMetaData*> level0(files_[0]);
+  std::sort(level0.begin(), level0.end(), NewestFirst);
+  const int rounds = static_cast<int>(level0.size()) + config::kNumLevels - 1;
+  std::vector<TableCache::GetRequest> reqs;
+  std::vector<size_t> req_keys;
+  for (int round = 0; round < rounds && !pending.empty(); round++) {
+    reqs.clear();
+    req_keys.clear();
+    const int level = std::max(0, round - static_cast<int>(level0.size()) + 1);
+    for (size_t p = 0; p < pending.size(); p++) {
+      const size_t i = pending[p];
+      const Slice user_key = savers[i].user_key;
+      FileMetaData* f = NULL;
+      if (level == 0) {
+        f = level0[round];
+        if (ucmp->Compare(user_key, f->smallest.user_key()) < 0 ||
+            ucmp->Compare(user_key, f->largest.user_key()) > 0) {
+          continue;
+        }
+      } else {
+        const std::vector<FileMetaData*>& files = files_[level];
+        uint32_t index = FindFile(vset_->icmp_, files,
+                                  keys[i]->internal_key());
+        if (index >= files.size() ||
+            ucmp->Compare(user_key, files[index]->smallest.user_key()) < 0) {
+          continue;
+        }
+        f = files[index];
+      }
+      TableCache::GetRequest req;
+      req.file_number = f->number;
+      req.file_size = f->file_size;
+      req.key = keys[i]->internal_key();
+      req.arg = &savers[i];
+      reqs.push_back(req);
+      req_keys.push_back(i);
+    }
+    if (reqs.empty()) {
+      continue;
+    }
+
+    std::vector<Status> results(reqs.size());
+    vset_->table_cache_->MultiGet(options, &reqs[0], reqs.size(), SaveValue,
+                                  &results[0]);
+    std::vector<bool> done(n, false);
+    for (size_t r = 0; r < reqs.size(); r++) {
+      const size_t i = req_keys[r];
+      if (!results[r].ok()) {
+        (*statuses)[i] = results[r];
+        done[i] = true;
+        continue;
+      }
+      switch (savers[i].state) {
+        case kNotFound:
+          break;      // Keep searching in other files
+        case kFound:
+          (*statuses)[i] = Status::OK();
+          (*is_blob_index)[i] = savers[i].is_blob_index;
+          done[i] = true;
+          break;
+        case kDeleted:
+          done[i] = true;
+          break;
+        case kCorrupt:
+          (*statuses)[i] = Status::Corruption("corrupted key for ",
+                                              savers[i].user_key);
+          done[i] = true;
+          break;
+      }
+    }
+    size_t kept = 0;
+    for (size_t p = 0; p < pending.size(); p++) {
+      if (!done[pending[p]]) {
+        pending[kept++] = pending[p];
+      }
+    }
+    pending.resize(kept);
+  }
+}
+
 bool Version::UpdateStats(const GetStats& stats) {
   // stats.seek_file中存放的是最后一个seek的文件
   // 这里不应该只对最后一个seek的文件减allowed_seeks,应该对这个过程中所有seek过的文件都减吧?
@@ -454,6 +625,201 @@ bool Version::UpdateStats(const GetStats& stats) {
   return false;
 }
 
+void Version::ForEachOverlapping(Slice user_key, Slice internal_key,
+                                 void* arg,
+                                 bool (*func)(void*, int, FileMetaData*)) {
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+
+  // Search level-0 in order from newest to oldest.
+  std::vector<FileMetaData*> tmp;
+  tmp.reserve(files_[0].size());
+  for (uint32_t i = 0; i < files_[0].size(); i++) {
+    FileMetaData* f = files_[0][i];
+    if (ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
+        ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
+      tmp.push_back(f);
+    }
+  }
+  if (!tmp.empty()) {
+    std::sort(tmp.begin(), tmp.end(), NewestFirst);
+    for (uint32_t i = 0; i < tmp.size(); i++) {
+      if (!(*func)(arg, 0, tmp[i])) {
+        return;
+      }
+    }
+  }
+
+  // Search other levels.
+  for (int level = 1; level < config::kNumLevels; level++) {
+    size_t num_files = files_[level].size();
+    if (num_files == 0) continue;
+
+    // Binary search to find earliest index whose largest key >= internal_key.
+    uint32_t index = FindFile(vset_->icmp_, files_[level], internal_key);
+    if (index < num_files) {
+      FileMetaData* f = files_[level][index];
+      if (ucmp->Compare(user_key, f->smallest.user_key()) < 0) {
+        // All of "f" is past any data for user_key
+      } else {
+        if (!(*func)(arg, level, f)) {
+          return;
+        }
+      }
+    }
+  }
+}
+
+bool Version::RecordReadSample(Slice internal_key) {
+  ParsedInternalKey ikey;
+  if (!ParseInternalKey(internal_key, &ikey)) {
+    return false;
+  }
+
+  struct State {
+    GetStats stats;  // Holds first matching file
+    int matches;
+
+    static bool Match(void* arg, int level, FileMetaData* f) {
+      State* state = reinterpret_cast<State*>(arg);
+      state->matches++;
+      if (state->matches == 1) {
+        // Remember first match.
+        state->stats.seek_file = f;
+        state->stats.seek_file_level = level;
+      }
+      // We can stop iterating once we have a second match.
+      return state->matches < 2;
+    }
+  };
+
+  State state;
+  state.matches = 0;
+  ForEachOverlapping(ikey.user_key, internal_key, &state, &State::Match);
+
+  // Must have at least two matches since we want to merge across
+  // files.  A read that only touches a single file costs no more than
+  // it would after a compaction.
+  if (state.matches >= 2) {
+    // 1MB cost is about 1 seek (see comment in Builder::Apply).
+    return UpdateStats(state.stats);
+  }
+  return false;
+}
+
+namespace {
+// A point in the key space and the number of bytes of one table file
+// that lie between the previous point of that file and this one.
+struct SplitAnchor {
+  std::string user_key;
+  uint64_t bytes;
+};
+
+struct SplitAnchorComparator {
+  const Comparator* ucmp;
+  bool operator()(const SplitAnchor& a, const SplitAnchor& b) const {
+    return ucmp->Compare(a.user_key, b.user_key) < 0;
+  }
+};
+
+// About how many anchors GetRangeSplits() gathers per requested part.
+// Index blocks are only sampled if there are fewer files than that.
+static const int kSplitAnchorsPerPart = 64;
+}  // namespace
+
+void Version::GetRangeSplits(const Slice* begin, const Slice* end, int n,
+                             std::vector<std::string>* splits) {
+  splits->clear();
+  if (n <= 1) {
+    return;
+  }
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+
+  std::vector<FileMetaData*> inputs;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (size_t i = 0; i < files_[level].size(); i++) {
+      FileMetaData* f = files_[level][i];
+      if ((begin != NULL && ucmp->Compare(f->largest.user_key(), *begin) < 0) ||
+          (end != NULL && ucmp->Compare(f->smallest.user_key(), *end) >= 0)) {
+        continue;
+      }
+      inputs.push_back(f);
+    }
+  }
+  if (inputs.empty()) {
+    return;
+  }
+
+  // Every file contributes its data as anchors at the ends of some of
+  // its blocks, or as a single anchor at its largest key.
+  const int samples_per_file = kSplitAnchorsPerPart * n / inputs.size();
+  std::vector<SplitAnchor> anchors;
+  std::vector<std::string> keys;
+  std::vector<uint64_t> offsets;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    FileMetaData* f = inputs[i];
+    keys.clear();
+    if (samples_per_file > 1) {
+      vset_->table_cache_->SampleKeys(f->number, f->file_size,
+                                      samples_per_file, &keys, &offsets);
+    }
+    if (keys.empty()) {
+      keys.push_back(f->largest.Encode().ToString());
+      offsets.assign(1, f->file_size);
+    }
+    uint64_t prev = 0;
+    for (size_t j = 0; j < keys.size(); j++) {
+      SplitAnchor anchor;
+      anchor.user_key = ExtractUserKey(keys[j]).ToString();
+      anchor.bytes = (offsets[j] > prev) ? offsets[j] - prev : 0;
+      prev = std::max(prev, offsets[j]);
+      anchors.push_back(anchor);
+    }
+  }
+
+  // Only anchors strictly inside the range can be split points.
+  std::vector<SplitAnchor> inside;
+  uint64_t total = 0;
+  for (size_t i = 0; i < anchors.size(); i++) {
+    const SplitAnchor& a = anchors[i];
+    if ((begin == NULL || ucmp->Compare(a.user_key, *begin) > 0) &&
+        (end == NULL || ucmp->Compare(a.user_key, *end) < 0)) {
+      inside.push_back(a);
+      total += a.bytes;
+    }
+  }
+  SplitAnchorComparator cmp;
+  cmp.ucmp = ucmp;
+  std::sort(inside.begin(), inside.end(), cmp);
+
+  // Place the i-th split where the running total passes i/n of the
+  // total.  The last anchor is never a split point, so that the last
+  // part is not empty.
+  uint64_t sum = 0;
+  for (size_t i = 0; i + 1 < inside.size(); i++) {
+    if (splits->size() + 1 >= static_cast<size_t>(n)) {
+      break;
+    }
+    sum += inside[i].bytes;
+    const uint64_t target = total / n * (splits->size() + 1);
+    if (sum >= target &&
+        (splits->empty() ||
+         ucmp->Compare(inside[i].user_key, splits->back()) > 0)) {
+      splits->push_back(inside[i].user_key);
+    }
+  }
+}
+
+bool Version::BlobFileNeedsGC(uint64_t number) const {
+  std::map<uint64_t, BlobFileMetaData>::const_iterator it =
+      blob_files_.find(number);
+  if (it == blob_files_.end()) {
+    return false;
+  }
+  const BlobFileMetaData& b = it->second;
+  return (b.garbage_bytes * 100 >=
+          b.total_bytes * config::kBlobGarbagePercentForGC);
+}
+
 void Version::Ref() {
   ++refs_;
 }
@@ -490,7 +856,8 @@ int Version::PickLevelForMemTableOutput(
     InternalKey limit(largest_user_key, 0, static_cast<ValueType>(0));
     std::vector<FileMetaData*> overlaps;
     // 逐层查找
-    while (level < config::kMaxMemCompactLevel) {
+    const Options* options = vset_->options_;
+    while (level < options->max_mem_compaction_level) {
       // 先判断level+1级别是否满足要求，满足就返回
       if (OverlapInLevel(level + 1, &smallest_user_key, &largest_user_key)) {
         break;
@@ -499,7 +866,7 @@ int Version::PickLevelForMemTableOutput(
       GetOverlappingInputs(level + 2, &start, &limit, &overlaps);
       const int64_t sum = TotalFileSize(overlaps);
       // 但是如果超过了返回就不再继续查找了
-      if (sum > kMaxGrandParentOverlapBytes) {
+      if (sum > MaxGrandParentOverlapBytes(options)) {
         break;
       }
       level++;
@@ -628,6 +995,8 @@ class VersionSet::Builder {
   Version* base_;
   // 每个级别上都有什么需要更新的
   LevelState levels_[config::kNumLevels];
+  // Blob files of base_ with the edits applied
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
 
  public:
   // Initialize a builder with the files from *base and other info from *vset
@@ -640,6 +1009,7 @@ class VersionSet::Builder {
     for (int level = 0; level < config::kNumLevels; level++) {
       levels_[level].added_files = new FileSet(cmp);
     }
+    blob_files_ = base_->blob_files_;
   }
 
   ~Builder() {
@@ -728,6 +1098,20 @@ class VersionSet::Builder {
       // 增加到新添加文件中
       levels_[level].added_files->insert(f);
     }
+
+    // Add new blob files, then account for their garbage
+    for (size_t i = 0; i < edit->new_blob_files_.size(); i++) {
+      BlobFileMetaData& b = blob_files_[edit->new_blob_files_[i].first];
+      b.total_bytes = edit->new_blob_files_[i].second;
+      b.garbage_bytes = 0;
+    }
+    for (size_t i = 0; i < edit->blob_garbage_.size(); i++) {
+      std::map<uint64_t, BlobFileMetaData>::iterator it =
+          blob_files_.find(edit->blob_garbage_[i].first);
+      if (it != blob_files_.end()) {
+        it->second.garbage_bytes += edit->blob_garbage_[i].second;
+      }
+    }
   }
 
   // Save the current state in *v.
@@ -785,6 +1169,15 @@ class VersionSet::Builder {
       }
 #endif
     }
+
+    // Blob files that are all garbage are no longer referenced
+    for (std::map<uint64_t, BlobFileMetaData>::const_iterator it =
+             blob_files_.begin();
+         it != blob_files_.end(); ++it) {
+      if (it->second.garbage_bytes < it->second.total_bytes) {
+        v->blob_files_.insert(*it);
+      }
+    }
   }
 
   // 判断某个文件是否需要添加进来
@@ -1064,6 +1457,14 @@ Status VersionSet::Recover() {
     Version* v = new Version(this);
     // 将改动保存到Version中
     builder.SaveTo(v);
+    for (int level = options_->num_levels; level < config::kNumLevels;
+         level++) {
+      if (!v->files_[level].empty()) {
+        delete v;
+        return Status::InvalidArgument(
+            dbname_, "has tables beyond options.num_levels");
+      }
+    }
     // Install recovered version
     Finalize(v);
     AppendVersion(v);
@@ -1083,14 +1484,204 @@ void VersionSet::MarkFileNumberUsed(uint64_t number) {
   }
 }
 
+size_t VersionSet::UniversalRunsToMerge(
+    const std::vector<FileMetaData*>& runs) const {
+  if (runs.size() <
+      static_cast<size_t>(options_->level0_file_num_compaction_trigger)) {
+    return 0;
+  }
+
+  // Merge all runs if the newer ones take up too much space compared
+  // to the oldest, which holds most of the data once the DB is large.
+  uint64_t newer_bytes = 0;
+  for (size_t i = 0; i + 1 < runs.size(); i++) {
+    newer_bytes += runs[i]->file_size;
+  }
+  if (newer_bytes * 100 > runs.back()->file_size *
+      options_->universal_max_size_amplification_percent) {
+    return runs.size();
+  }
+
+  // Merge the newest runs for as long as the next one is not much
+  // larger than those picked before it together.  Only ever merging
+  // the newest runs keeps the output newer than all the runs left,
+  // which is the order that reads search level-0 in.
+  uint64_t picked_bytes = runs[0]->file_size;
+  size_t n = 1;
+  while (n < runs.size() &&
+         runs[n]->file_size * 100 <=
+             picked_bytes * (100 + options_->universal_size_ratio)) {
+    picked_bytes += runs[n]->file_size;
+    n++;
+  }
+  if (n >= 2) {
+    return n;
+  }
+
+  // No similar runs.  Leave them be until writes are about to be
+  // slowed down, then merge just enough of them.
+  const size_t max_runs =
+      std::max(options_->level0_slowdown_writes_trigger - 1, 2);
+  if (runs.size() >= max_runs) {
+    return runs.size() - max_runs + 2;
+  }
+  return 0;
+}
+
+int FindMinOverlappingRatio(const InternalKeyComparator& icmp,
+                            const std::vector<FileMetaData*>& files,
+                            const std::vector<FileMetaData*>& next_files) {
+  const Comparator* ucmp = icmp.user_comparator();
+  int best = -1;
+  double best_ratio = 0;
+  // next_files[begin,end) overlap files[i] and hold "overlap" bytes.
+  // Both ends only move forward as files[i] moves through the key space.
+  size_t begin = 0;
+  size_t end = 0;
+  uint64_t overlap = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    const FileMetaData* f = files[i];
+    while (begin < next_files.size() &&
+           ucmp->Compare(next_files[begin]->largest.user_key(),
+                         f->smallest.user_key()) < 0) {
+      if (begin < end) {
+        overlap -= next_files[begin]->file_size;
+      }
+      begin++;
+    }
+    if (end < begin) {
+      end = begin;
+      overlap = 0;
+    }
+    while (end < next_files.size() &&
+           ucmp->Compare(next_files[end]->smallest.user_key(),
+                         f->largest.user_key()) <= 0) {
+      overlap += next_files[end]->file_size;
+      end++;
+    }
+    const double ratio = static_cast<double>(overlap) /
+        std::max<uint64_t>(f->file_size, 1);
+    if (best < 0 || ratio < best_ratio) {
+      best = i;
+      best_ratio = ratio;
+    }
+  }
+  return best;
+}
+
+int DynamicLevelTargets(const int64_t* level_bytes, int num_levels,
+                        double* max_bytes) {
+  // No level is given a target below that of level-1 in the static
+  // shape, so that the levels never get smaller than level-0.
+  const double kMinBytes = MaxBytesForLevel(1);
+  int first_level = 0;
+  int64_t largest_bytes = 0;
+  for (int level = 1; level < num_levels; level++) {
+    if (level_bytes[level] > 0 && first_level == 0) {
+      first_level = level;
+    }
+    largest_bytes = std::max(largest_bytes, level_bytes[level]);
+  }
+  if (first_level == 0) {
+    // Empty DB: level-0 compacts straight into the last level
+    max_bytes[num_levels - 1] = kMinBytes;
+    return num_levels - 1;
+  }
+
+  // Size the levels from the last one, which should hold most of the
+  // data, up with a fan-out of 10, and compact level-0 into the first
+  // level that is due some data.
+  double bytes = static_cast<double>(largest_bytes);
+  for (int level = num_levels - 1; level > first_level; level--) {
+    bytes /= 10;
+  }
+  int base_level = first_level;
+  while (base_level > 1 && bytes > kMinBytes) {
+    base_level--;
+    bytes /= 10;
+  }
+  for (int level = base_level; level < num_levels; level++) {
+    max_bytes[level] = std::max(bytes, kMinBytes);
+    bytes *= 10;
+  }
+  return base_level;
+}
+
 // 预计算下一次compact的最佳层次
 void VersionSet::Finalize(Version* v) {
   // Precomputed best level for next compaction
   int best_level = -1;
   double best_score = -1;
 
+  // Find the table whose values expire first
+  for (int level = 0; level < config::kNumLevels; level++) {
+    const std::vector<FileMetaData*>& files = v->files_[level];
+    for (size_t i = 0; i < files.size(); i++) {
+      FileMetaData* f = files[i];
+      if (f->oldest_expiry != 0 &&
+          (v->file_to_expire_ == NULL ||
+           f->oldest_expiry < v->file_to_expire_->oldest_expiry)) {
+        v->file_to_expire_ = f;
+        v->file_to_expire_level_ = level;
+      }
+    }
+  }
+
+  double max_bytes[config::kNumLevels];
+  if (options_->level_compaction_dynamic_level_bytes) {
+    int64_t level_bytes[config::kNumLevels];
+    for (int level = 0; level < config::kNumLevels; level++) {
+      level_bytes[level] = TotalFileSize(v->files_[level]);
+    }
+    v->base_level_ = DynamicLevelTargets(level_bytes, options_->num_levels,
+                                         max_bytes);
+    for (int level = 1; level < v->base_level_; level++) {
+      max_bytes[level] = MaxBytesForLevel(level);  // Empty anyway
+    }
+  } else {
+    v->base_level_ = 1;
+    for (int level = 1; level < config::kNumLevels; level++) {
+      max_bytes[level] = MaxBytesForLevel(level);
+    }
+  }
+
   // 遍历所有的层次计算最佳score和level
-  for (int level = 0; level < config::kNumLevels-1; level++) {
+  if (options_->compaction_style == kCompactionStyleUniversal) {
+    // All runs are in level-0, and it is their number that reads pay
+    // for, but only some shapes of runs call for a merge.
+    std::vector<FileMetaData*> runs = v->files_[0];
+    std::sort(runs.begin(), runs.end(), NewestFirst);
+    v->compaction_level_ = 0;
+    v->compaction_score_ = (UniversalRunsToMerge(runs) == 0) ? 0 :
+        runs.size() /
+        static_cast<double>(options_->level0_file_num_compaction_trigger);
+    return;
+  }
+
+  // Find the table with the largest share of deletion markers.  Tables
+  // in the last level are left alone: the markers that remain there are
+  // kept alive by snapshots, and rewriting the table would not drop them.
+  double best_deletion_ratio = -1;
+  for (int level = 0; level + 1 < options_->num_levels; level++) {
+    const std::vector<FileMetaData*>& files = v->files_[level];
+    for (size_t i = 0; i < files.size(); i++) {
+      FileMetaData* f = files[i];
+      if (f->num_deletions < config::kMinDeletionsForCompaction ||
+          f->num_deletions * 100 <
+          f->num_entries * config::kDeletionPercentForCompaction) {
+        continue;
+      }
+      const double ratio = static_cast<double>(f->num_deletions) /
+          f->num_entries;
+      if (ratio > best_deletion_ratio) {
+        v->file_with_deletions_ = f;
+        v->file_with_deletions_level_ = level;
+        best_deletion_ratio = ratio;
+      }
+    }
+  }
+
+  for (int level = 0; level < options_->num_levels - 1; level++) {
     double score;
     if (level == 0) {
       // We treat level-0 specially by bounding the number of files
@@ -1112,12 +1703,12 @@ void VersionSet::Finalize(Version* v) {
       // 高压缩比例，也或者是很多覆盖写、删除操作，等等原因造成的0级别的小文件）
       // level 0是根据这个级别的文件数量来计算分数
       score = v->files_[level].size() /
-          static_cast<double>(config::kL0_CompactionTrigger);
+          static_cast<double>(options_->level0_file_num_compaction_trigger);
     } else {
       // Compute the ratio of current size to size limit.
       // 其他级别是按照该级别所有文件的尺寸之和与来计算分数
       const uint64_t level_bytes = TotalFileSize(v->files_[level]);
-      score = static_cast<double>(level_bytes) / MaxBytesForLevel(level);
+      score = static_cast<double>(level_bytes) / max_bytes[level];
     }
 
     // 记录下分数更高的级别和分数
@@ -1157,7 +1748,17 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, *f);
+    }
+  }
+
+  // Save blob files
+  for (std::map<uint64_t, BlobFileMetaData>::const_iterator it =
+           current_->blob_files_.begin();
+       it != current_->blob_files_.end(); ++it) {
+    edit.AddBlobFile(it->first, it->second.total_bytes);
+    if (it->second.garbage_bytes > 0) {
+      edit.AddBlobGarbage(it->first, it->second.garbage_bytes);
     }
   }
 
@@ -1260,6 +1861,11 @@ void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
         live->insert(files[i]->number);
       }
     }
+    for (std::map<uint64_t, BlobFileMetaData>::const_iterator it =
+             v->blob_files_.begin();
+         it != v->blob_files_.end(); ++it) {
+      live->insert(it->first);
+    }
   }
 }
 
@@ -1360,9 +1966,10 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
     	// 对于非0级,创建了一个concatenating iterator来遍历这个级别的所有文件
         list[num++] = NewTwoLevelIterator(
         	// 这里的index iter是LevelFileNumIterator,这是在遍历排序好的FileMetaData数组的迭代器
-            new Version::LevelFileNumIterator(icmp_, &c->inputs_[which]),
+            new Version::LevelFileNumIterator(icmp_, &c->inputs_[which], 0,
+                                              c->inputs_[which].size()),
             // GetFileIterator返回的是遍历一个sstable的迭代器
-            &GetFileIterator, table_cache_, options);
+            &GetFileIterator, table_cache_, options, env_);
         // 综合以上,这里得到的迭代器,首先会在一组排序好的FileMetaData数组中选择一个FileMetaData,然后再在这个FileMetaData表示的sstable中遍历的迭代器
         // 换言之, 非0级的迭代器是将该等级的文件集合在一起进行遍历
       }
@@ -1388,16 +1995,43 @@ Compaction* VersionSet::PickCompaction() {
   // file_to_compact_在Version::UpdateStats函数中计算
   // 这种情况是某个文件的seek次数太多，需要compact
   const bool seek_compaction = (current_->file_to_compact_ != NULL);
+  // Tables mostly made of deletion markers are pushed down until the
+  // markers meet, and drop, the entries they delete.
+  const bool deletion_compaction = (current_->file_with_deletions_ != NULL);
+  if (options_->compaction_style == kCompactionStyleUniversal) {
+    if (size_compaction) {
+      return PickUniversalCompaction();
+    }
+    return ExpiryCompactionDue() ? PickExpiryCompaction() : NULL;
+  }
   if (size_compaction) {
 	  // 如果有compaction_score_ >= 1的情况,优先考虑这种情况
     level = current_->compaction_level_;
     assert(level >= 0);
     assert(level+1 < config::kNumLevels);
-    c = new Compaction(level);
+    c = new Compaction(options_, level, OutputLevel(level));
+    const std::vector<FileMetaData*>& files = current_->files_[level];
+
+    // Level-0 files overlap each other, so all of the ones that overlap
+    // the picked one are compacted anyway.
+    if (level > 0 && options_->compaction_pri == kMinOverlappingRatio) {
+      const int i = FindMinOverlappingRatio(
+          icmp_, files, current_->files_[c->output_level()]);
+      c->inputs_[0].push_back(files[i]);
+    } else if (level > 0 && options_->compaction_pri == kOldestFirst) {
+      // File numbers grow with the time the files were written
+      FileMetaData* oldest = files[0];
+      for (size_t i = 1; i < files.size(); i++) {
+        if (files[i]->number < oldest->number) {
+          oldest = files[i];
+        }
+      }
+      c->inputs_[0].push_back(oldest);
+    }
 
     // Pick the first file that comes after compact_pointer_[level]
     // 查找第一个包含比上次已经compact的最大key大的key的文件
-    for (size_t i = 0; i < current_->files_[level].size(); i++) {
+    for (size_t i = 0; c->inputs_[0].empty() && i < files.size(); i++) {
       FileMetaData* f = current_->files_[level][i];
       if (compact_pointer_[level].empty() || //如果当前层的compact_pointer_为空
           icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0) { // 或者找到了第一个大于compact_pointer_的文件
@@ -1415,8 +2049,16 @@ Compaction* VersionSet::PickCompaction() {
 	  // 然后才考虑file_to_compact_不为空的情况
 	  // file_to_compact_是allow_seeks为0的等级
     level = current_->file_to_compact_level_;
-    c = new Compaction(level);
+    c = new Compaction(options_, level, OutputLevel(level));
     c->inputs_[0].push_back(current_->file_to_compact_);
+  } else if (deletion_compaction) {
+    level = current_->file_with_deletions_level_;
+    c = new Compaction(options_, level, OutputLevel(level));
+    // Moving the table down as is would keep all of its markers
+    c->rewrite_inputs_ = true;
+    c->inputs_[0].push_back(current_->file_with_deletions_);
+  } else if (ExpiryCompactionDue()) {
+    return PickExpiryCompaction();
   } else {
     return NULL;
   }
@@ -1450,7 +2092,9 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
   GetRange(c->inputs_[0], &smallest, &largest);
 
   // 遍历level + 1级,得到level + 1级中也在该范围内的文件将它们放到inputs[1]中
-  current_->GetOverlappingInputs(level+1, &smallest, &largest, &c->inputs_[1]);
+  const int output_level = c->output_level();
+  current_->GetOverlappingInputs(output_level, &smallest, &largest,
+                                 &c->inputs_[1]);
 
   // Get entire range covered by compaction
   // 所有inputs的开始结束范围
@@ -1477,14 +2121,15 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
     // level级别新增的文件大小
     const int64_t expanded0_size = TotalFileSize(expanded0);
     if (expanded0.size() > c->inputs_[0].size() && // 这个条件表示在level中取[all_start, all_limit]的话比原来的inputs[0]范围大
-        inputs1_size + expanded0_size < kExpandedCompactionByteSizeLimit) {
-      // 满足 inputs1_size + expanded0_size < kExpandedCompactionByteSizeLimit表示现在可以不compact level + 1的文件
+        inputs1_size + expanded0_size <
+            ExpandedCompactionByteSizeLimit(options_)) {
+      // 满足 inputs1_size + expanded0_size < ExpandedCompactionByteSizeLimit表示现在可以不compact level + 1的文件
       InternalKey new_start, new_limit;
       // 拿到expanded0的范围[new_start, new_limit]
       GetRange(expanded0, &new_start, &new_limit);
       std::vector<FileMetaData*> expanded1;
       // 拿到level + 1中overlap范围[new_start, new_limit]的文件
-      current_->GetOverlappingInputs(level+1, &new_start, &new_limit,
+      current_->GetOverlappingInputs(output_level, &new_start, &new_limit,
                                      &expanded1);
       if (expanded1.size() == c->inputs_[1].size()) { // expanded1和inputs[1]大小相同,而expanded0>inputs[0]
   	  	  	  	  	  	  	  	  	  	  	  	  	  // 那么说明可以扩展level的文件数量而不改变level + 1的文件数量
@@ -1509,10 +2154,10 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
   // Compute the set of grandparent files that overlap this compaction
   // (parent == level+1; grandparent == level+2)
   // 如果level+2还没到最大层次，那么取得level+2 中重叠的文件放入grandparents_
-  if (level + 2 < config::kNumLevels) {
+  if (output_level + 1 < config::kNumLevels) {
 	  // 计算level + 2中也在[all_start,all_limit]范围的文件
     // 用于后面计算level+2级别的overlap时使用
-    current_->GetOverlappingInputs(level + 2, &all_start, &all_limit,
+    current_->GetOverlappingInputs(output_level + 1, &all_start, &all_limit,
                                    &c->grandparents_);
   }
 
@@ -1532,6 +2177,66 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
   c->edit_.SetCompactPointer(level, largest);
 }
 
+Compaction* VersionSet::PickUniversalCompaction() {
+  std::vector<FileMetaData*> runs = current_->files_[0];
+  std::sort(runs.begin(), runs.end(), NewestFirst);
+  const size_t n = UniversalRunsToMerge(runs);
+  if (n == 0) {
+    return NULL;
+  }
+  Log(options_->info_log, "Universal: merging %d of %d runs\n",
+      static_cast<int>(n), static_cast<int>(runs.size()));
+  return NewUniversalCompaction(runs, n);
+}
+
+bool VersionSet::ExpiryCompactionDue() const {
+  const FileMetaData* f = current_->file_to_expire_;
+  return (f != NULL && f->oldest_expiry <= env_->NowMicros() / 1000000);
+}
+
+Compaction* VersionSet::PickExpiryCompaction() {
+  FileMetaData* f = current_->file_to_expire_;
+  const int level = current_->file_to_expire_level_;
+  if (options_->compaction_style == kCompactionStyleUniversal) {
+    // Runs can only be merged newest first, so merge the run with all
+    // newer ones.
+    std::vector<FileMetaData*> runs = current_->files_[0];
+    std::sort(runs.begin(), runs.end(), NewestFirst);
+    const size_t n = std::find(runs.begin(), runs.end(), f) - runs.begin();
+    return NewUniversalCompaction(runs, n + 1);
+  }
+
+  // The last level has nowhere to move the table to, so it is rewritten
+  // in place.
+  const bool last_level = (level + 1 >= options_->num_levels);
+  Compaction* c = new Compaction(options_, level,
+                                 last_level ? level : OutputLevel(level));
+  c->rewrite_inputs_ = true;
+  c->inputs_[0].push_back(f);
+  c->input_version_ = current_;
+  c->input_version_->Ref();
+  if (level == 0) {
+    InternalKey smallest, largest;
+    GetRange(c->inputs_[0], &smallest, &largest);
+    current_->GetOverlappingInputs(0, &smallest, &largest, &c->inputs_[0]);
+  }
+  if (!last_level) {
+    SetupOtherInputs(c);
+  }
+  return c;
+}
+
+Compaction* VersionSet::NewUniversalCompaction(
+    const std::vector<FileMetaData*>& runs, size_t n) {
+  Compaction* c = new Compaction(options_, 0, 0);
+  c->max_output_file_size_ = ~static_cast<uint64_t>(0);  // A single run
+  c->input_version_ = current_;
+  c->input_version_->Ref();
+  c->inputs_[0].assign(runs.begin(), runs.begin() + n);
+  c->older_runs_.assign(runs.begin() + n, runs.end());
+  return c;
+}
+
 // 返回一个Compaction指针，用于在level级别针对[begin,end]返回的数据进行compact操作
 Compaction* VersionSet::CompactRange(
     int level,
@@ -1544,10 +2249,18 @@ Compaction* VersionSet::CompactRange(
     return NULL;
   }
 
+  if (level == 0 &&
+      options_->compaction_style == kCompactionStyleUniversal) {
+    // Runs can only be merged whole and newest first, so merge them all.
+    std::vector<FileMetaData*> runs = current_->files_[0];
+    std::sort(runs.begin(), runs.end(), NewestFirst);
+    return NewUniversalCompaction(runs, runs.size());
+  }
+
   // Avoid compacting too much in one shot in case the range is large.
   // 避免出现compact太多文件的情况
   // 首先得到该level的文件大小上限
-  const uint64_t limit = MaxFileSizeForLevel(level);
+  const uint64_t limit = MaxFileSizeForLevel(options_, level);
   uint64_t total = 0;
   for (size_t i = 0; i < inputs.size(); i++) {
     uint64_t s = inputs[i]->file_size;
@@ -1559,7 +2272,7 @@ Compaction* VersionSet::CompactRange(
     }
   }
 
-  Compaction* c = new Compaction(level);
+  Compaction* c = new Compaction(options_, level, OutputLevel(level));
   c->input_version_ = current_;
   c->input_version_->Ref();
   c->inputs_[0] = inputs;
@@ -1567,10 +2280,13 @@ Compaction* VersionSet::CompactRange(
   return c;
 }
 
-Compaction::Compaction(int level)
+Compaction::Compaction(const Options* options, int level, int output_level)
     : level_(level),
-      max_output_file_size_(MaxFileSizeForLevel(level)),
+      output_level_(output_level),
+      max_output_file_size_(MaxFileSizeForLevel(options, level)),
+      max_grandparent_overlap_bytes_(MaxGrandParentOverlapBytes(options)),
       input_version_(NULL),
+      rewrite_inputs_(false),
       grandparent_index_(0),
       seen_key_(false),
       overlapped_bytes_(0) {
@@ -1590,17 +2306,20 @@ bool Compaction::IsTrivialMove() const {
   // Avoid a move if there is lots of overlapping grandparent data.
   // Otherwise, the move could create a parent file that will require
   // a very expensive merge later on.
-  return (num_input_files(0) == 1 &&  // level 只有一个文件
+  return (output_level_ != level_ &&
+          !rewrite_inputs_ &&
+          num_input_files(0) == 1 &&  // level 只有一个文件
           num_input_files(1) == 0 &&  // level + 1没有文件
           // 有重叠的爷爷辈文件大小之和小于阈值
-          TotalFileSize(grandparents_) <= kMaxGrandParentOverlapBytes);
+          TotalFileSize(grandparents_) <= max_grandparent_overlap_bytes_);
 }
 
 // 将这个compact中的所有文件输入到edit中作为待删除的文件
 void Compaction::AddInputDeletions(VersionEdit* edit) {
   for (int which = 0; which < 2; which++) {
     for (size_t i = 0; i < inputs_[which].size(); i++) {
-      edit->DeleteFile(level_ + which, inputs_[which][i]->number);
+      edit->DeleteFile(which == 0 ? level_ : output_level_,
+                       inputs_[which][i]->number);
     }
   }
 }
@@ -1611,7 +2330,14 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
   // Maybe use binary search to find right entry instead of linear search?
   // 以下使用的线性查找的办法，可以使用二分查找来替换这个算法？
   const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
-  for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
+  for (size_t i = 0; i < older_runs_.size(); i++) {
+    FileMetaData* f = older_runs_[i];
+    if (user_cmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
+        user_cmp->Compare(user_key, f->largest.user_key()) <= 0) {
+      return false;
+    }
+  }
+  for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
     const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
     for (; level_ptrs_[lvl] < files.size(); ) {
       FileMetaData* f = files[level_ptrs_[lvl]];
@@ -1648,7 +2374,7 @@ bool Compaction::ShouldStopBefore(const Slice& internal_key) {
   // 第一次进来该函数就会置为true，第二次以后进来都为true了
   seen_key_ = true;
 
-  if (overlapped_bytes_ > kMaxGrandParentOverlapBytes) {
+  if (overlapped_bytes_ > max_grandparent_overlap_bytes_) {
     // Too much overlap for current output; start new output
 	  // 如果overlap大小超过了一定范围,返回true
     overlapped_bytes_ = 0;
@@ -1658,6 +2384,10 @@ bool Compaction::ShouldStopBefore(const Slice& internal_key) {
   }
 }
 
+bool Compaction::ShouldMoveBlob(uint64_t blob_file_number) const {
+  return input_version_->BlobFileNeedsGC(blob_file_number);
+}
+
 void Compaction::ReleaseInputs() {
   if (input_version_ != NULL) {
     input_version_->Unref();
@@ -60,6 +60,24 @@ extern bool SomeFileOverlapsRange(
     const Slice* smallest_user_key,
     const Slice* largest_user_key);
 
+// Return the index of the file of "files" that has the lowest ratio of
+// the bytes of the overlapping files of "next_files" to its own size,
+// or -1 if "files" is empty.  REQUIRES: both are sorted and disjoint.
+// Runs in O(files.size() + next_files.size()) time.
+extern int FindMinOverlappingRatio(
+    const InternalKeyComparator& icmp,
+    const std::vector<FileMetaData*>& files,
+    const std::vector<FileMetaData*>& next_files);
+
+// Compute the shape of the first "num_levels" levels for
+// Options::level_compaction_dynamic_level_bytes from "level_bytes",
+// the number of bytes in each level (level_bytes[0] is ignored).
+// Returns the level that level-0 compacts into, and stores in
+// max_bytes[level] the target size of that level and the ones after it.
+// Levels between level-0 and the returned level are always empty.
+extern int DynamicLevelTargets(const int64_t* level_bytes, int num_levels,
+                               double* max_bytes);
+
 class Version {
  public:
   // Append to *iters a sequence of iterators that will
@@ -77,14 +95,42 @@ class Version {
     // 查询文件的level
     int seek_file_level;
   };
-  Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
-             GetStats* stats);
+  // On success the value is pinned in *val without copying it.  If the
+  // entry found is a kTypeBlobIndex, *val holds the encoded BlobIndex
+  // and *is_blob_index is set to true.
+  Status Get(const ReadOptions&, const LookupKey& key, PinnableSlice* val,
+             GetStats* stats, bool* is_blob_index);
+
+  // Look up each of keys[0,n-1] like Get(), storing a copy of the value
+  // found in (*values)[i], the outcome in (*statuses)[i] and whether
+  // the value is a blob index in (*is_blob_index)[i].  The table reads of
+  // all the lookups at a level are issued together.  Seeks are not
+  // charged to files.
+  // REQUIRES: lock is not held
+  void MultiGet(const ReadOptions&, const std::vector<LookupKey*>& keys,
+                std::vector<std::string>* values,
+                std::vector<Status>* statuses,
+                std::vector<bool>* is_blob_index);
 
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
   // REQUIRES: lock is held
   bool UpdateStats(const GetStats& stats);
 
+  // Record a sample of bytes read at the specified internal key.
+  // Samples are taken approximately once every config::kReadBytesPeriod
+  // bytes.  Returns true if a new compaction may need to be triggered.
+  // REQUIRES: lock is held
+  bool RecordReadSample(Slice key);
+
+  // Store in *splits up to n-1 user keys, in increasing order, that
+  // divide the user key range [*begin,*end) into at most "n" parts
+  // holding about the same amount of table data.  NULL means an
+  // unbounded end of the range.  Reads table index blocks, so should
+  // be called without holding the lock.
+  void GetRangeSplits(const Slice* begin, const Slice* end, int n,
+                      std::vector<std::string>* splits);
+
   // Reference count management (so Versions do not disappear out from
   // under live iterators)
   void Ref();
@@ -111,6 +157,11 @@ class Version {
 
   int NumFiles(int level) const { return files_[level].size(); }
 
+  // Returns true iff the blobs still referenced in the specified blob
+  // file should be moved elsewhere by compactions that come across
+  // them, because most of the file is garbage.
+  bool BlobFileNeedsGC(uint64_t number) const;
+
   // Return a human readable string that describes this version's contents.
   std::string DebugString() const;
 
@@ -121,6 +172,15 @@ class Version {
   class LevelFileNumIterator;
   Iterator* NewConcatenatingIterator(const ReadOptions&, int level) const;
 
+  // Call func(arg, level, f) for every file that overlaps user_key in
+  // order from newest to oldest.  If an invocation of func returns
+  // false, makes no more calls.
+  //
+  // REQUIRES: user portion of internal_key == user_key.
+  void ForEachOverlapping(Slice user_key, Slice internal_key,
+                          void* arg,
+                          bool (*func)(void*, int, FileMetaData*));
+
   // 属于哪个VersionSet
   VersionSet* vset_;            // VersionSet to which this Version belongs
   // 链表
@@ -133,11 +193,26 @@ class Version {
   // List of files per level
   std::vector<FileMetaData*> files_[config::kNumLevels];
 
+  // Blob files referenced by the tables of this version
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
+
   // Next file to compact based on seek stats.
   // 下一次需要compact时的文件以及级别
   FileMetaData* file_to_compact_;
   int file_to_compact_level_;
 
+  // Table whose values expire first and its level, if any table holds
+  // expiring values.  Initialized by Finalize().
+  FileMetaData* file_to_expire_;
+  int file_to_expire_level_;
+
+  // Table outside the last level with the largest share of deletion
+  // markers, and its level, if some table has enough of them to be
+  // worth compacting (see config::kDeletionPercentForCompaction).
+  // Initialized by Finalize().
+  FileMetaData* file_with_deletions_;
+  int file_with_deletions_level_;
+
   // Level that should be compacted next and its compaction score.
   // Score < 1 means compaction is not strictly needed.  These fields
   // are initialized by Finalize().
@@ -145,12 +220,21 @@ class Version {
   double compaction_score_;
   int compaction_level_;
 
+  // Level that level-0 compacts into, also set by Finalize().  Levels
+  // between level-0 and this one are empty.
+  int base_level_;
+
   explicit Version(VersionSet* vset)
       : vset_(vset), next_(this), prev_(this), refs_(0),
         file_to_compact_(NULL),
         file_to_compact_level_(-1),
+        file_to_expire_(NULL),
+        file_to_expire_level_(-1),
+        file_with_deletions_(NULL),
+        file_with_deletions_level_(-1),
         compaction_score_(-1),
-        compaction_level_(-1) {
+        compaction_level_(-1),
+        base_level_(1) {
   }
 
   ~Version();
@@ -176,6 +260,11 @@ class VersionSet {
   Status LogAndApply(VersionEdit* edit, port::Mutex* mu)
       EXCLUSIVE_LOCKS_REQUIRED(mu);
 
+  // Recompute the compaction score of the current version after the
+  // options that it depends on have changed.
+  // REQUIRES: lock is held
+  void UpdateCompactionScore() { Finalize(current_); }
+
   // Recover the last saved descriptor from persistent storage.
   Status Recover();
 
@@ -248,7 +337,11 @@ class VersionSet {
   // Returns true iff some level needs a compaction.
   bool NeedsCompaction() const {
     Version* v = current_;
-    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != NULL);
+    if (options_->compaction_style == kCompactionStyleUniversal) {
+      return (v->compaction_score_ >= 1) || ExpiryCompactionDue();
+    }
+    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != NULL) ||
+        (v->file_with_deletions_ != NULL) || ExpiryCompactionDue();
   }
 
   // Add all files listed in any live version to *live.
@@ -285,6 +378,32 @@ class VersionSet {
 
   void SetupOtherInputs(Compaction* c);
 
+  // Return true iff the values of current_->file_to_expire_ have
+  // started to expire.
+  bool ExpiryCompactionDue() const;
+
+  // Return a compaction that rewrites current_->file_to_expire_.
+  Compaction* PickExpiryCompaction();
+
+  // Return the level that a compaction of "level" writes to.
+  int OutputLevel(int level) const {
+    return (level == 0) ? current_->base_level_ : level + 1;
+  }
+
+  // Pick the level-0 runs to merge for kCompactionStyleUniversal.
+  Compaction* PickUniversalCompaction();
+
+  // Return how many of the newest of "runs", which are level-0 files
+  // sorted from newest to oldest, should be merged into one, or zero
+  // if the runs need no merge.
+  size_t UniversalRunsToMerge(const std::vector<FileMetaData*>& runs) const;
+
+  // Return a compaction that merges the "n" newest of "runs", which
+  // are the level-0 files of current_ sorted from newest to oldest,
+  // into a single level-0 file.
+  Compaction* NewUniversalCompaction(const std::vector<FileMetaData*>& runs,
+                                     size_t n);
+
   // Save current contents to *log
   Status WriteSnapshot(log::Writer* log);
 
@@ -338,10 +457,16 @@ class Compaction {
   ~Compaction();
 
   // Return the level that is being compacted.  Inputs from "level"
-  // and "level+1" will be merged to produce a set of "level+1" files.
+  // and output_level() will be merged to produce a set of
+  // output_level() files.
   // 合并的等级，在level等级的文件将被合并到level+1级中
   int level() const { return level_; }
 
+  // Return the level the output files go to: usually "level+1", the
+  // base level for level-0 with dynamic level sizes, or level-0 for
+  // the merges of kCompactionStyleUniversal.
+  int output_level() const { return output_level_; }
+
   // Return the object that holds the edits to the descriptor done
   // by this compaction.
   VersionEdit* edit() { return &edit_; }
@@ -350,7 +475,8 @@ class Compaction {
   // which只能是0或者1
   int num_input_files(int which) const { return inputs_[which].size(); }
 
-  // Return the ith input file at "level()+which" ("which" must be 0 or 1).
+  // Return the ith input file at level() if "which" is 0, or at
+  // output_level() if it is 1.
   // 返回which级别的第i个待合并文件
   FileMetaData* input(int which, int i) const { return inputs_[which][i]; }
 
@@ -366,13 +492,18 @@ class Compaction {
 
   // Returns true if the information we have available guarantees that
   // the compaction is producing data in "level+1" for which no data exists
-  // in levels greater than "level+1".
+  // in levels greater than "level+1" (nor, for universal merges, in the
+  // older level-0 runs that are not part of the merge).
   bool IsBaseLevelForKey(const Slice& user_key);
 
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
   bool ShouldStopBefore(const Slice& internal_key);
 
+  // Returns true iff the blobs of the specified blob file that this
+  // compaction copies should be moved to a new blob file.
+  bool ShouldMoveBlob(uint64_t blob_file_number) const;
+
   // Release the input version for the compaction, once the compaction
   // is successful.
   void ReleaseInputs();
@@ -381,12 +512,16 @@ class Compaction {
   friend class Version;
   friend class VersionSet;
 
-  explicit Compaction(int level);
+  Compaction(const Options* options, int level, int output_level);
 
   // 待compact的level
   int level_;
+  int output_level_;
   // 生成sstable的最大size
   uint64_t max_output_file_size_;
+  // Options::max_grandparent_overlap_factor in bytes, as of the start
+  // of the compaction
+  int64_t max_grandparent_overlap_bytes_;
   // compact时当前的Version
   Version* input_version_;
   // compact过程中的操作
@@ -396,6 +531,13 @@ class Compaction {
   // 每个compact操作从leve和level+1来进行，所以数组只有两个元素
   std::vector<FileMetaData*> inputs_[2];      // The two sets of inputs
 
+  // For universal merges, the level-0 files older than the inputs
+  std::vector<FileMetaData*> older_runs_;
+
+  // True if the inputs have to be rewritten even when moving them to
+  // output_level_ would do, e.g. to drop expired values
+  bool rewrite_inputs_;
+
   // 用于记录level+2级别重叠信息的变量
   // 位于 level-n+2，并且与 compact 的 key-range 有 overlap 的 sstable。
   // 保存 grandparents_是因为 compact 最终会生成一系列 level-n+1 的 sstable，
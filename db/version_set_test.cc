@@ -172,6 +172,121 @@ TEST(FindFileTest, OverlappingFiles) {
   ASSERT_TRUE(Overlaps("600", "700"));
 }
 
+class MinOverlappingRatioTest {
+ public:
+  std::vector<FileMetaData*> files_;
+  std::vector<FileMetaData*> next_files_;
+
+  ~MinOverlappingRatioTest() {
+    for (size_t i = 0; i < files_.size(); i++) {
+      delete files_[i];
+    }
+    for (size_t i = 0; i < next_files_.size(); i++) {
+      delete next_files_[i];
+    }
+  }
+
+  void Add(std::vector<FileMetaData*>* files,
+           const char* smallest, const char* largest, uint64_t file_size) {
+    FileMetaData* f = new FileMetaData;
+    f->number = files->size() + 1;
+    f->file_size = file_size;
+    f->smallest = InternalKey(smallest, 100, kTypeValue);
+    f->largest = InternalKey(largest, 100, kTypeValue);
+    files->push_back(f);
+  }
+
+  int Pick() {
+    InternalKeyComparator cmp(BytewiseComparator());
+    return FindMinOverlappingRatio(cmp, files_, next_files_);
+  }
+};
+
+TEST(MinOverlappingRatioTest, NoFiles) {
+  ASSERT_EQ(-1, Pick());
+  Add(&files_, "a", "b", 100);
+  ASSERT_EQ(0, Pick());
+}
+
+TEST(MinOverlappingRatioTest, LowestRatio) {
+  Add(&next_files_, "a", "b", 300);
+  Add(&next_files_, "c", "d", 300);
+  Add(&next_files_, "e", "g", 500);
+  Add(&next_files_, "j", "m", 800);
+  Add(&next_files_, "w", "y", 100);
+  Add(&files_, "a", "c", 100);   // 6
+  Add(&files_, "e", "f", 100);   // 5
+  Add(&files_, "h", "k", 400);   // 2
+  Add(&files_, "x", "z", 10);    // 10
+  ASSERT_EQ(2, Pick());
+
+  // A file that overlaps nothing only needs to be moved.
+  Add(&files_, "zz", "zz", 1);
+  ASSERT_EQ(4, Pick());
+}
+
+TEST(MinOverlappingRatioTest, SharedNextFiles) {
+  // Both of the first two files overlap "b".."c"
+  Add(&next_files_, "b", "c", 1000);
+  Add(&next_files_, "d", "e", 10);
+  Add(&next_files_, "f", "f", 50);
+  Add(&files_, "a", "b", 100);   // 10
+  Add(&files_, "c", "d", 100);   // 10.1
+  ASSERT_EQ(0, Pick());
+  Add(&files_, "e", "g", 100);   // 0.6
+  ASSERT_EQ(2, Pick());
+}
+
+class DynamicLevelTargetsTest {
+ public:
+  int64_t level_bytes_[config::kNumLevels];
+  double max_bytes_[config::kNumLevels];
+
+  DynamicLevelTargetsTest() {
+    for (int level = 0; level < config::kNumLevels; level++) {
+      level_bytes_[level] = 0;
+      max_bytes_[level] = 0;
+    }
+  }
+
+  int BaseLevel() {
+    return DynamicLevelTargets(level_bytes_, config::kNumLevels, max_bytes_);
+  }
+};
+
+static const int64_t kMB = 1048576;
+
+TEST(DynamicLevelTargetsTest, EmptyDB) {
+  level_bytes_[0] = 100 * kMB;  // Ignored
+  ASSERT_EQ(config::kNumLevels - 1, BaseLevel());
+}
+
+TEST(DynamicLevelTargetsTest, SmallLastLevel) {
+  level_bytes_[6] = 5 * kMB;
+  ASSERT_EQ(6, BaseLevel());
+  ASSERT_EQ(10 * kMB, max_bytes_[6]);
+}
+
+TEST(DynamicLevelTargetsTest, LargeLastLevel) {
+  level_bytes_[6] = 50000 * kMB;
+  ASSERT_EQ(2, BaseLevel());
+  ASSERT_EQ(10 * kMB, max_bytes_[2]);
+  ASSERT_EQ(50 * kMB, max_bytes_[3]);
+  ASSERT_EQ(500 * kMB, max_bytes_[4]);
+  ASSERT_EQ(5000 * kMB, max_bytes_[5]);
+  ASSERT_EQ(50000 * kMB, max_bytes_[6]);
+}
+
+TEST(DynamicLevelTargetsTest, DataAboveLastLevel) {
+  // Levels after the first non-empty one are sized for the largest
+  // one, so its data moves on towards the last level.
+  level_bytes_[4] = 1000 * kMB;
+  ASSERT_EQ(4, BaseLevel());
+  ASSERT_EQ(10 * kMB, max_bytes_[4]);
+  ASSERT_EQ(100 * kMB, max_bytes_[5]);
+  ASSERT_EQ(1000 * kMB, max_bytes_[6]);
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -143,6 +143,34 @@ class MemTableInserter : public WriteBatch::Handler {
 };
 }  // namespace
 
+namespace {
+class ExpiryAppender : public WriteBatch::Handler {
+ public:
+  uint64_t expiry_;
+  WriteBatch* dst_;
+  std::string buf_;
+
+  virtual void Put(const Slice& key, const Slice& value) {
+    buf_.assign(value.data(), value.size());
+    PutFixed64(&buf_, expiry_);
+    dst_->Put(key, buf_);
+  }
+  virtual void Delete(const Slice& key) {
+    dst_->Delete(key);
+  }
+};
+}  // namespace
+
+Status WriteBatchInternal::AppendExpiry(const WriteBatch* src,
+                                        uint64_t expiry, WriteBatch* dst) {
+  ExpiryAppender appender;
+  appender.expiry_ = expiry;
+  appender.dst_ = dst;
+  dst->Clear();
+  SetSequence(dst, Sequence(src));
+  return src->Iterate(&appender);
+}
+
 Status WriteBatchInternal::InsertInto(const WriteBatch* b,
                                       MemTable* memtable) {
   MemTableInserter inserter;
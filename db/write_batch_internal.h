@@ -42,6 +42,11 @@ class WriteBatchInternal {
   static Status InsertInto(const WriteBatch* batch, MemTable* memtable);
 
   static void Append(WriteBatch* dst, const WriteBatch* src);
+
+  // Store in *dst a copy of *src, with the same sequence number, in
+  // which every value is followed by the Fixed64 "expiry".
+  static Status AppendExpiry(const WriteBatch* src, uint64_t expiry,
+                             WriteBatch* dst);
 };
 
 }  // namespace leveldb
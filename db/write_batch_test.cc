@@ -113,6 +113,26 @@ TEST(WriteBatchTest, Append) {
             PrintContents(&b1));
 }
 
+TEST(WriteBatchTest, AppendExpiry) {
+  WriteBatch batch, expiring;
+  batch.Put("foo", "bar");
+  batch.Delete("box");
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_OK(WriteBatchInternal::AppendExpiry(&batch, 12345, &expiring));
+  ASSERT_EQ(100, WriteBatchInternal::Sequence(&expiring));
+  ASSERT_EQ(2, WriteBatchInternal::Count(&expiring));
+
+  std::string value = "bar";
+  PutFixed64(&value, 12345);
+  ASSERT_EQ("Delete(box)@101"
+            "Put(foo, " + value + ")@100",
+            PrintContents(&expiring));
+  ASSERT_EQ(12345, ExtractExpiry(value));
+  ASSERT_TRUE(IsExpired(value, 12345));
+  ASSERT_TRUE(!IsExpired(value, 12344));
+  ASSERT_TRUE(!IsExpired("bar", 12345));
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
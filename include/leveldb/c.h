@@ -60,6 +60,7 @@ typedef struct leveldb_filterpolicy_t  leveldb_filterpolicy_t;
 typedef struct leveldb_iterator_t      leveldb_iterator_t;
 typedef struct leveldb_logger_t        leveldb_logger_t;
 typedef struct leveldb_options_t       leveldb_options_t;
+typedef struct leveldb_pinnableslice_t leveldb_pinnableslice_t;
 typedef struct leveldb_randomfile_t    leveldb_randomfile_t;
 typedef struct leveldb_readoptions_t   leveldb_readoptions_t;
 typedef struct leveldb_seqfile_t       leveldb_seqfile_t;
@@ -105,6 +106,16 @@ extern char* leveldb_get(
     size_t* vallen,
     char** errptr);
 
+/* Returns NULL if not found.  Otherwise returns a handle to the value
+   that avoids copying it where possible; the value is read with
+   leveldb_pinnableslice_value() and the handle must be released with
+   leveldb_pinnableslice_destroy() before the database is closed. */
+extern leveldb_pinnableslice_t* leveldb_get_pinned(
+    leveldb_t* db,
+    const leveldb_readoptions_t* options,
+    const char* key, size_t keylen,
+    char** errptr);
+
 extern leveldb_iterator_t* leveldb_create_iterator(
     leveldb_t* db,
     const leveldb_readoptions_t* options);
@@ -159,6 +170,12 @@ extern const char* leveldb_iter_key(const leveldb_iterator_t*, size_t* klen);
 extern const char* leveldb_iter_value(const leveldb_iterator_t*, size_t* vlen);
 extern void leveldb_iter_get_error(const leveldb_iterator_t*, char** errptr);
 
+/* Pinnable slice */
+
+extern void leveldb_pinnableslice_destroy(leveldb_pinnableslice_t*);
+extern const char* leveldb_pinnableslice_value(
+    const leveldb_pinnableslice_t*, size_t* vlen);
+
 /* Write batch */
 
 extern leveldb_writebatch_t* leveldb_writebatch_create();
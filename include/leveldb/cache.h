@@ -19,6 +19,7 @@
 #define STORAGE_LEVELDB_INCLUDE_CACHE_H_
 
 #include <stdint.h>
+#include <string>
 #include "leveldb/slice.h"
 
 namespace leveldb {
@@ -29,6 +30,26 @@ class Cache;
 // of Cache uses a least-recently-used eviction policy.
 extern Cache* NewLRUCache(size_t capacity);
 
+// Create a new cache with a fixed size capacity that is resistant to
+// being flushed by scans.  New entries enter a probationary segment and
+// are promoted to a protected segment when they are looked up again, so
+// a stream of entries that are used only once evicts other probationary
+// entries before it evicts anything that has been reused.  Up to
+// "high_pri_pool_ratio" of the capacity is reserved for entries
+// inserted with Cache::kHighPriority.
+extern Cache* NewSegmentedLRUCache(size_t capacity,
+                                   double high_pri_pool_ratio);
+
+// Create a new cache with a fixed size capacity that uses the CLOCK
+// eviction policy.  Lookup() and Release() do not take any locks, which
+// makes this cache a better fit than NewLRUCache() for many threads
+// reading a small set of hot entries.  The hash table that holds the
+// entries is sized up front from "estimated_entry_charge", the expected
+// average charge of an entry; if entries are much smaller than
+// estimated, the cache holds fewer of them than its capacity allows.
+extern Cache* NewClockCache(size_t capacity,
+                            size_t estimated_entry_charge = 4096);
+
 class Cache {
  public:
   Cache() { }
@@ -52,6 +73,18 @@ class Cache {
   virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                          void (*deleter)(const Slice& key, void* value)) = 0;
 
+  enum Priority {
+    kLowPriority,
+    kHighPriority
+  };
+
+  // Like Insert() above, but a cache may use "priority" to keep
+  // kHighPriority entries (e.g. index and filter blocks) in preference
+  // to others.  The default implementation ignores the priority.
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value),
+                         Priority priority);
+
   // If the cache has no mapping for "key", returns NULL.
   //
   // Else return a handle that corresponds to the mapping.  The caller
@@ -81,6 +114,19 @@ class Cache {
   // its cache keys.
   virtual uint64_t NewId() = 0;
 
+  // Append a human readable description of the cache's usage and
+  // hit/miss/eviction counters to *stats.  The default implementation
+  // appends nothing.
+  virtual void GetStats(std::string* stats);
+
+  // Call (*visit)(arg, key, value) for every entry in the cache.  Caches
+  // that keep a recency order visit the entries of each of their shards
+  // from the first to the last to be evicted.  The cache may be locked
+  // while "visit" runs, so "visit" must not call methods on *this.  The
+  // default implementation visits nothing.
+  virtual void Walk(void (*visit)(void* arg, const Slice& key, void* value),
+                    void* arg);
+
  private:
   void LRU_Remove(Handle* e);
   void LRU_Append(Handle* e);
@@ -0,0 +1,47 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A database can be configured with a custom CompactionFilter object,
+// which decides during compactions whether each value is kept, dropped
+// or replaced.  Since compactions rewrite the data anyway, this lets an
+// application remove stale data (e.g. expired cache entries) without
+// issuing deletions of its own.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+#define STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+
+#include <string>
+
+namespace leveldb {
+
+class Slice;
+
+class CompactionFilter {
+ public:
+  virtual ~CompactionFilter();
+
+  // Return the name of this filter, for logging.
+  virtual const char* Name() const = 0;
+
+  // Called for the newest value of a user key found by a compaction of
+  // "level", if no snapshot can see that value.  Older values of the
+  // key are never passed, and neither are deleted keys.  Snapshots
+  // created while the compaction is running may observe the outcome.
+  //
+  // Return true to remove "key" from the DB: reads of it then return
+  // NotFound, as if it had been deleted when the filter was called.
+  // Otherwise, to replace the value, store the new value in *new_value
+  // and set *value_changed to true; *value_changed is false on entry.
+  //
+  // May be called concurrently from multiple threads, and must not
+  // call back into the DB.
+  virtual bool Filter(int level, const Slice& key,
+                      const Slice& existing_value,
+                      std::string* new_value,
+                      bool* value_changed) const = 0;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
@@ -7,8 +7,12 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/pinnable_slice.h"
 
 namespace leveldb {
 
@@ -29,6 +33,18 @@ class Snapshot {
   virtual ~Snapshot();
 };
 
+// Receives the entries found by DB::ParallelScan().
+class ScanVisitor {
+ public:
+  virtual ~ScanVisitor();
+
+  // Called for every entry of partition number "partition", in key
+  // order within the partition.  Calls for different partitions happen
+  // concurrently from different threads.  Return false to stop the
+  // whole scan.
+  virtual bool Visit(int partition, const Slice& key, const Slice& value) = 0;
+};
+
 // A range of keys
 struct Range {
   Slice start;          // Included in the range
@@ -83,6 +99,26 @@ class DB {
   virtual Status Get(const ReadOptions& options,
                      const Slice& key, std::string* value) = 0;
 
+  // Like Get() above, but where possible avoids copying the value: on
+  // success *value refers directly to the block holding the entry,
+  // which stays pinned in memory until *value is Reset() or destroyed.
+  // *value must be released before this db is deleted.
+  //
+  // The default implementation copies the result of the Get() above.
+  virtual Status Get(const ReadOptions& options,
+                     const Slice& key, PinnableSlice* value);
+
+  // Look up each of "keys" like Get(), storing the value found for
+  // keys[i] in (*values)[i] (left empty if there is none), and return
+  // the status of each lookup.  The table reads of all the lookups are
+  // issued together (see Env::MultiRead()), which on devices that serve
+  // many requests in parallel is much faster than a Get() per key.
+  //
+  // The default implementation calls Get() for each key.
+  virtual std::vector<Status> MultiGet(const ReadOptions& options,
+                                       const std::vector<Slice>& keys,
+                                       std::vector<std::string>* values);
+
   // Return a heap-allocated iterator over the contents of the database.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
@@ -112,9 +148,14 @@ class DB {
   //  "leveldb.num-files-at-level<N>" - return the number of files at level <N>,
   //     where <N> is an ASCII representation of a level number (e.g. "0").
   //  "leveldb.stats" - returns a multi-line string that describes statistics
-  //     about the internal operation of the DB.
+  //     about the internal operation of the DB, including the write
+  //     amplification: the bytes written by memtable flushes and
+  //     compactions per byte flushed.
   //  "leveldb.sstables" - returns a multi-line string that describes all
   //     of the sstables that make up the db contents.
+  //  "leveldb.block-cache-stats" - returns a multi-line string with the
+  //     usage and hit/miss/eviction counters of the block cache, if the
+  //     cache implementation provides them (see Cache::GetStats).
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
   // For each i in [0,n-1], store in "sizes[i]", the approximate
@@ -140,6 +181,52 @@ class DB {
   //    db->CompactRange(NULL, NULL);
   virtual void CompactRange(const Slice* begin, const Slice* end) = 0;
 
+  // Record which tables and blocks are currently cached, so that the
+  // next open of the DB with Options::persist_cache_state can load them
+  // again.  The state is recorded on close anyway; calling this
+  // periodically keeps a recent state around in case of a crash.
+  //
+  // The default implementation returns a NotSupported status.
+  virtual Status SaveCacheState();
+
+  // Change options of the open DB.  "new_options" maps option names to
+  // decimal values, e.g. "level0_stop_writes_trigger" to "20".  The
+  // options that shape the LSM tree (see leveldb/options.h) can be
+  // changed, except num_levels; they take effect with the next
+  // compaction and write.  Either all of the options are changed, or
+  // none is and a non-OK status is returned.
+  //
+  // The default implementation returns a NotSupported status.
+  virtual Status SetOptions(
+      const std::map<std::string, std::string>& new_options);
+
+  // Store in *split_keys up to n-1 keys, in increasing order, that
+  // divide the key range [*begin,*end) into at most "n" sub-ranges
+  // holding roughly the same amount of data.  The split keys are picked
+  // from the boundaries of the table files and from sample keys of
+  // their index blocks; data that is still in memory is not accounted
+  // for.  begin==NULL and end==NULL are treated as in CompactRange().
+  //
+  // Together with ReadOptions::iterate_lower_bound/iterate_upper_bound
+  // and a snapshot, the sub-ranges can be scanned by separate iterators
+  // in parallel.
+  //
+  // The default implementation stores no split keys.
+  virtual void GetRangeSplits(const Slice* begin, const Slice* end, int n,
+                              std::vector<std::string>* split_keys);
+
+  // Scan the key range [*begin,*end) with up to "parallelism" threads,
+  // each covering one of the sub-ranges found by GetRangeSplits(), and
+  // pass every entry to "visitor".  All threads read from the same
+  // snapshot: options.snapshot if set, otherwise one taken for the
+  // scan.  Returns when all threads are done.  Returns OK unless an
+  // iterator hit an error.
+  //
+  // The default implementation returns a NotSupported status.
+  virtual Status ParallelScan(const ReadOptions& options,
+                              const Slice* begin, const Slice* end,
+                              int parallelism, ScanVisitor* visitor);
+
  private:
   // No copying allowed
   DB(const DB&);
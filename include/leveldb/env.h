@@ -17,6 +17,7 @@
 #include <string>
 #include <vector>
 #include <stdint.h>
+#include "leveldb/slice.h"
 #include "leveldb/status.h"
 
 namespace leveldb {
@@ -25,8 +26,8 @@ class FileLock;
 class Logger;
 class RandomAccessFile;
 class SequentialFile;
-class Slice;
 class WritableFile;
+struct ReadRequest;
 
 class Env {
  public:
@@ -69,6 +70,23 @@ class Env {
   virtual Status NewWritableFile(const std::string& fname,
                                  WritableFile** result) = 0;
 
+  // Like NewRandomAccessFile(), but reads bypass the operating system's
+  // file cache where the platform and file system support it (O_DIRECT
+  // on Linux), so data read through the file is only cached by the
+  // caller.  Reads may have any offset and length.
+  //
+  // The default implementation calls NewRandomAccessFile().
+  virtual Status NewDirectRandomAccessFile(const std::string& fname,
+                                           RandomAccessFile** result);
+
+  // Like NewWritableFile(), but writes bypass the operating system's
+  // file cache where supported.  Appended data may be held in memory
+  // until the next Sync() or Close().
+  //
+  // The default implementation calls NewWritableFile().
+  virtual Status NewDirectWritableFile(const std::string& fname,
+                                       WritableFile** result);
+
   // Returns true iff the named file exists.
   virtual bool FileExists(const std::string& fname) = 0;
 
@@ -125,6 +143,26 @@ class Env {
       void (*function)(void* arg),
       void* arg) = 0;
 
+  // Arrange to run "(*function)(arg)" once in a thread reserved for
+  // short, latency-sensitive I/O such as reading ahead of an iterator.
+  // Unlike Schedule(), such work is never queued behind long-running
+  // background work like compactions, and several functions may run
+  // concurrently.  "function" must not wait for other work scheduled
+  // this way.
+  //
+  // The default implementation runs "(*function)(arg)" in the calling
+  // thread before returning.
+  virtual void ScheduleIO(void (*function)(void* arg), void* arg);
+
+  // Perform the reads described by reqs[0,n-1], which may be of different
+  // files, and set the result and status of each.  Implementations may
+  // keep many of the reads in flight at once, which on devices that
+  // serve requests in parallel is much faster than issuing them one at
+  // a time.
+  //
+  // The default implementation calls Read() for each request in turn.
+  virtual void MultiRead(ReadRequest* reqs, size_t n);
+
   // Start a new thread, invoking "function(arg)" within the new thread.
   // When "function(arg)" returns, the thread will be destroyed.
   virtual void StartThread(void (*function)(void* arg), void* arg) = 0;
@@ -206,6 +244,18 @@ class RandomAccessFile {
   void operator=(const RandomAccessFile&);
 };
 
+// A read of "n" bytes at "offset" of "file" for Env::MultiRead().  The
+// outcome is that of file->Read(offset, n, &result, scratch).
+struct ReadRequest {
+  const RandomAccessFile* file;
+  uint64_t offset;
+  size_t n;
+  char* scratch;
+
+  Slice result;   // Set by MultiRead()
+  Status status;  // Set by MultiRead()
+};
+
 // A file abstraction for sequential writing.  The implementation
 // must provide buffering since callers may append small fragments
 // at a time to the file.
@@ -289,6 +339,13 @@ class EnvWrapper : public Env {
   Status NewWritableFile(const std::string& f, WritableFile** r) {
     return target_->NewWritableFile(f, r);
   }
+  Status NewDirectRandomAccessFile(const std::string& f,
+                                   RandomAccessFile** r) {
+    return target_->NewDirectRandomAccessFile(f, r);
+  }
+  Status NewDirectWritableFile(const std::string& f, WritableFile** r) {
+    return target_->NewDirectWritableFile(f, r);
+  }
   bool FileExists(const std::string& f) { return target_->FileExists(f); }
   Status GetChildren(const std::string& dir, std::vector<std::string>* r) {
     return target_->GetChildren(dir, r);
@@ -309,6 +366,12 @@ class EnvWrapper : public Env {
   void Schedule(void (*f)(void*), void* a) {
     return target_->Schedule(f, a);
   }
+  void ScheduleIO(void (*f)(void*), void* a) {
+    return target_->ScheduleIO(f, a);
+  }
+  void MultiRead(ReadRequest* reqs, size_t n) {
+    return target_->MultiRead(reqs, n);
+  }
   void StartThread(void (*f)(void*), void* a) {
     return target_->StartThread(f, a);
   }
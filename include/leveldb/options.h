@@ -10,10 +10,13 @@
 namespace leveldb {
 
 class Cache;
+class CompactionFilter;
 class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class PersistentCache;
+class Slice;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -27,6 +30,19 @@ enum CompressionType {
   kSnappyCompression = 0x1
 };
 
+// How the tables of a database are compacted (see Options::compaction_style).
+enum CompactionStyle {
+  kCompactionStyleLevel     = 0x0,
+  kCompactionStyleUniversal = 0x1
+};
+
+// Which table of a level a compaction picks (see Options::compaction_pri).
+enum CompactionPri {
+  kByCompactPointer       = 0x0,
+  kMinOverlappingRatio    = 0x1,
+  kOldestFirst            = 0x2
+};
+
 // Options to control the behavior of a database (passed to DB::Open)
 struct Options {
   // -------------------
@@ -97,6 +113,52 @@ struct Options {
   // Default: NULL
   Cache* block_cache;
 
+  // If non-NULL, cache the result of point lookups in table files,
+  // keyed by (file number, user key), so that repeated Gets of hot keys
+  // skip the index and data block search.  Both found values and
+  // deletions are cached.  Entries for a file simply stop being used once
+  // the file is removed by a compaction and age out of the cache.  The
+  // charge of an entry is the size of its key and value.  Reads that
+  // supply ReadOptions::snapshot do not use the row cache.
+  // Default: NULL
+  Cache* row_cache;
+
+  // If non-NULL, blocks that are stored compressed are also kept in this
+  // cache in their compressed form.  A block_cache miss is served from
+  // here, at the cost of decompressing the block, before going to the
+  // file.  Since compressed blocks are several times smaller, a
+  // compressed_block_cache extends the amount of data that can be
+  // served from memory for working sets slightly larger than the
+  // block_cache.  The charge of an entry is its compressed size.
+  // Default: NULL
+  Cache* compressed_block_cache;
+
+  // If non-NULL, table blocks that are not found in memory are looked up
+  // in this cache before they are read from the table file, and blocks
+  // read from table files are added to it.  Use this to keep blocks on
+  // storage that is faster than the one holding the DB (see
+  // NewPersistentCache() in leveldb/persistent_cache.h).
+  // Default: NULL
+  PersistentCache* persistent_cache;
+
+  // If true, the DB records which tables are open and which of their
+  // blocks are in block_cache when it is closed or DB::SaveCacheState()
+  // is called.  When the DB is opened again, a background thread reads
+  // the recorded tables and blocks back into the caches, with a few
+  // large reads per table, so that the DB does not start out cold.
+  // Default: false
+  bool persist_cache_state;
+
+  // If true, background threads open the tables of the DB right after
+  // it is opened, from the lowest level up and as many as fit in the
+  // table cache (see max_open_files), so that the first read of each
+  // table does not have to read its index and filter blocks.  If
+  // paranoid_checks is also true, the threads read every block of those
+  // tables and verify its checksum, and corruption is reported like a
+  // failed compaction: later writes fail with the error.
+  // Default: false
+  bool preload_tables;
+
   // Approximate size of user data packed per block.  Note that the
   // block size specified here corresponds to uncompressed data.  The
   // actual size of the unit read from disk may be smaller if
@@ -135,6 +197,165 @@ struct Options {
   // Default: NULL
   const FilterPolicy* filter_policy;
 
+  // If non-NULL, compactions pass the values of live keys to the
+  // specified filter, which may remove the keys or replace the values
+  // (see leveldb/compaction_filter.h).  Keys that are removed while a
+  // snapshot or an older level still holds a value of them are turned
+  // into deletion markers instead.
+  //
+  // Default: NULL
+  const CompactionFilter* compaction_filter;
+
+  // If non-zero, values of at least this many bytes are moved out of the
+  // tables into separate blob files when the memtable is written out,
+  // and tables only hold small pointers to them.  Compactions then copy
+  // the pointers instead of the values, which greatly reduces the
+  // amount of data rewritten for large values.  Blob files are deleted
+  // once compactions have dropped every value in them; compactions
+  // move the remaining values out of files that are mostly garbage.
+  //
+  // Reading such a value costs one extra read from its blob file.
+  // Default: 0 (all values are kept in the tables)
+  size_t min_blob_size;
+
+  // If non-zero, every value written is stored with the time at which
+  // it expires, this many seconds after the write.  Reads treat expired
+  // keys as deleted, and compactions remove them, including compactions
+  // started only because a table holds expired values.  Changing ttl
+  // only affects later writes.
+  //
+  // A DB written with a non-zero ttl must always be opened with a
+  // non-zero ttl, as the stored values carry the expiry times.  Cannot
+  // be combined with min_blob_size.
+  // Default: 0 (values never expire)
+  int ttl;
+
+  // If true, table files are read with direct I/O, bypassing the
+  // operating system's file cache, so that block_cache is the only
+  // cache of table data and compactions reading large amounts of data
+  // do not evict hot pages.  block_cache should then be sized to hold
+  // the working set.  Has no effect where the platform or file system
+  // does not support direct I/O.
+  // Default: false
+  bool use_direct_reads;
+
+  // If true, the tables written when the memtable is flushed and by
+  // compactions are written with direct I/O, so that they do not fill
+  // the operating system's file cache.  Has no effect where the
+  // platform or file system does not support direct I/O.
+  // Default: false
+  bool use_direct_io_for_flush_and_compaction;
+
+  // Tables written by memtable flushes and compactions are always added
+  // to the table cache as soon as they are written.  If
+  // prepopulate_block_cache is also true and block_cache is non-NULL,
+  // their data blocks are read into block_cache as well, while the file
+  // is still in the operating system's cache, so that reads of newly
+  // written data do not start out cold.  Note that compactions of large
+  // levels may push hotter blocks out of the block cache this way.
+  // Default: false
+  bool prepopulate_block_cache;
+
+  // The following parameters shape the LSM tree.  All but num_levels
+  // can be changed on an open DB with DB::SetOptions().
+
+  // Number of levels the tables are kept in.  Cannot be changed once
+  // the DB is open, and a DB cannot be opened with fewer levels than
+  // hold tables.
+  // Default: 7 (the maximum)
+  int num_levels;
+
+  // Number of level-0 files at which a level-0 compaction is started.
+  // Default: 4
+  int level0_file_num_compaction_trigger;
+
+  // Soft limit on the number of level-0 files: each write is delayed
+  // by 1ms once it is reached.
+  // Default: 8
+  int level0_slowdown_writes_trigger;
+
+  // Maximum number of level-0 files: writes stop once it is reached,
+  // until compactions bring the number down again.
+  // Default: 12
+  int level0_stop_writes_trigger;
+
+  // Maximum level to which a table written from the memtable is pushed
+  // if it does not overlap the tables of the levels in between.
+  // Pushing it beyond level-0 saves compactions, but pushing it too far
+  // wastes space if the same keys are repeatedly overwritten.
+  // Default: 2
+  int max_mem_compaction_level;
+
+  // Size of the tables written by compactions.  Larger tables mean
+  // fewer files and larger compactions.
+  // Default: 2MB
+  size_t max_file_size;
+
+  // A compaction starts a new output table before the current one would
+  // overlap more than this many times max_file_size bytes of the level
+  // after the output level, which bounds the cost of compacting that
+  // table later.
+  // Default: 10
+  int max_grandparent_overlap_factor;
+
+  // A compaction takes on more tables of its input level, if that does
+  // not add tables of the output level, as long as its inputs add up to
+  // at most this many times max_file_size bytes.
+  // Default: 25
+  int expanded_compaction_factor;
+
+  // If true, the level sizes that trigger compactions are derived from
+  // the size of the largest level, normally the last one, instead of
+  // being fixed at 10MB for level-1 and ten times more for each level
+  // after it.  Each level is sized at a tenth of the next, so the last
+  // level holds about 90% of the data whatever the size of the DB, and
+  // level-0 compacts straight into the first level that is due any
+  // data (the last level while the DB is small).  Memtables are then
+  // always written out to level-0.
+  // Default: false
+  bool level_compaction_dynamic_level_bytes;
+
+  // With kCompactionStyleLevel, tables are kept in levels that each
+  // hold ten times as much data as the one before, and compactions
+  // merge a table into the overlapping tables of the next level.  Reads
+  // touch few tables, but each entry is rewritten about ten times per
+  // level.
+  //
+  // With kCompactionStyleUniversal, all tables are kept in level-0 as
+  // sorted runs ordered by age, and compactions merge runs of similar
+  // size into one.  Each entry is rewritten far fewer times, which
+  // suits write-heavy workloads, at the cost of more runs for reads to
+  // search and of more space (see the universal_* options below).
+  // Tables left in other levels by the level style are kept as they
+  // are when a database is reopened with the universal style.
+  // Default: kCompactionStyleLevel
+  CompactionStyle compaction_style;
+
+  // Level style: which table of a level that has grown too large is
+  // merged into the next level.
+  //
+  // kByCompactPointer goes round-robin through the key space.
+  // kMinOverlappingRatio picks the table that overlaps the fewest bytes
+  // of the next level relative to its own size, which is cheapest to
+  // merge and lowers the bytes rewritten by compactions, in particular
+  // for random inserts.  kOldestFirst picks the table written longest
+  // ago, whose entries are the most likely to have been overwritten or
+  // deleted since.
+  // Default: kByCompactPointer
+  CompactionPri compaction_pri;
+
+  // Universal style: runs are merged, starting from the newest one, as
+  // long as the next older run is at most this many percent larger
+  // than all the runs picked before it together.
+  // Default: 1
+  int universal_size_ratio;
+
+  // Universal style: once the runs other than the oldest one add up to
+  // more than this many percent of the oldest run, all runs are merged
+  // into one, which bounds the space taken by stale entries.
+  // Default: 200
+  int universal_max_size_amplification_percent;
+
   // Create an Options object with default values for all fields.
   Options();
 };
@@ -158,10 +379,54 @@ struct ReadOptions {
   // Default: NULL
   const Snapshot* snapshot;
 
+  // Iterators that read table files without mmap read ahead of the
+  // block being requested once they see a run of sequential block
+  // reads.  If zero, the amount read ahead adapts to the access
+  // pattern: it starts small and doubles on every sequential refill up
+  // to 256KB.  If non-zero, every block read that misses the readahead
+  // buffer reads this many bytes instead.  Point lookups are not
+  // affected.
+  // Default: 0
+  size_t readahead_size;
+
+  // If true, an iterator that moves forward into a block or table file
+  // starts reading the next one in the background (see
+  // Env::ScheduleIO), so that the I/O overlaps with the caller's
+  // processing of the current one.  Useful for long scans over data
+  // that is not cached.
+  // Default: false
+  bool async_prefetch;
+
+  // If non-NULL, an iterator created by DB::NewIterator() only returns
+  // keys >= *iterate_lower_bound (inclusive) and < *iterate_upper_bound
+  // (exclusive): it becomes invalid when it reaches a bound instead of
+  // skipping over whatever lies beyond it, and table files, blocks and
+  // readahead that only cover keys outside the bounds are not read.
+  // The bounds are user keys and must remain live while the iterator
+  // is in use.  Ignored by Get().
+  // Default: NULL
+  const Slice* iterate_lower_bound;
+  const Slice* iterate_upper_bound;
+
+  // If true, DB::NewIterator() returns a forward-only "tailing" iterator
+  // meant for repeatedly polling for new writes.  Every Seek() and
+  // SeekToFirst() brings it up to date with the latest state of the
+  // DB, reusing the table iterators it already has unless compactions
+  // changed the set of table files, and Next() picks up writes made
+  // since then once it has passed the last entry.  SeekToLast() and
+  // Prev() are not supported.  The snapshot field is ignored.
+  // Default: false
+  bool tailing;
+
   ReadOptions()
       : verify_checksums(false),
         fill_cache(true),
-        snapshot(NULL) {
+        snapshot(NULL),
+        readahead_size(0),
+        async_prefetch(false),
+        iterate_lower_bound(NULL),
+        iterate_upper_bound(NULL),
+        tailing(false) {
   }
 };
 
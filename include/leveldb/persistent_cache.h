@@ -0,0 +1,65 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PersistentCache keeps table blocks on storage that is faster than
+// the storage holding the database, e.g. a local SSD in front of a
+// network-attached disk.  It sits below Options::block_cache: blocks
+// that miss in memory are looked up here before they are read from the
+// table file, and blocks read from table files are added to it.  Its
+// contents survive reopening the cache.
+//
+// A PersistentCache has internal synchronization and may be safely
+// accessed concurrently from multiple threads.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
+#define STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
+
+#include <stdint.h>
+#include <string>
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Env;
+
+class PersistentCache {
+ public:
+  PersistentCache() { }
+  virtual ~PersistentCache();
+
+  // Store a copy of "value" under "key".  The cache may decline to
+  // store it, and may evict other entries to make room.
+  virtual Status Insert(const Slice& key, const Slice& value) = 0;
+
+  // If the cache holds an intact entry for "key", store its value in
+  // *value and return OK.  Otherwise return a non-OK status (NotFound
+  // if there is no entry).
+  virtual Status Lookup(const Slice& key, std::string* value) = 0;
+
+ private:
+  // No copying allowed
+  PersistentCache(const PersistentCache&);
+  void operator=(const PersistentCache&);
+};
+
+// Open a persistent cache that keeps up to about "capacity" bytes in
+// log-structured files in directory "dirname", creating the directory
+// if necessary.  Entries written by an earlier cache on the same
+// directory are picked up again.  When the cache is full, the oldest
+// file is deleted, i.e. entries are evicted in insertion order.
+//
+// Table blocks are cached under their table's file number, file size
+// and offset, so a cache directory must only be used with a single DB,
+// and should be emptied if that DB is destroyed and recreated.
+//
+// On success stores a pointer to the new cache in *result and returns
+// OK.  The caller should delete the cache when it is no longer needed.
+extern Status NewPersistentCache(Env* env, const std::string& dirname,
+                                 uint64_t capacity,
+                                 PersistentCache** result);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
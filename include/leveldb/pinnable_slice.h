@@ -0,0 +1,79 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PinnableSlice holds a value returned by DB::Get().  Where possible
+// the value is not copied: the slice points directly at the storage
+// that holds it (typically a block in the block cache), and that
+// storage is pinned until the PinnableSlice is Reset() or destroyed.
+// Otherwise the value is copied into a buffer owned by the
+// PinnableSlice.
+//
+// A pinned value holds on to resources of the DB it was read from, so
+// every PinnableSlice must be Reset() or destroyed before that DB is
+// deleted.
+//
+// Multiple threads can invoke const methods on a PinnableSlice without
+// external synchronization, but if any of the threads may call a
+// non-const method, all threads accessing the same PinnableSlice must
+// use external synchronization.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
+#define STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
+
+#include <string>
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class PinnableSlice : public Slice {
+ public:
+  // Create an empty, unpinned slice.
+  PinnableSlice();
+
+  // Releases any pinned storage.
+  ~PinnableSlice();
+
+  typedef void (*CleanupFunction)(void* arg1, void* arg2);
+
+  // Make this slice refer to "s" without copying it.  The storage
+  // behind "s" must remain live until (*function)(arg1, arg2) is
+  // called, which happens when this slice is Reset() or destroyed.
+  // Any previously pinned storage is released first.
+  void PinSlice(const Slice& s, CleanupFunction function,
+                void* arg1, void* arg2);
+
+  // Make this slice refer to a copy of "s" held in the internal buffer.
+  // Any previously pinned storage is released first.
+  void PinSelf(const Slice& s);
+
+  // Make this slice refer to the current contents of the internal
+  // buffer returned by GetSelf().
+  void PinSelf();
+
+  // Return the internal buffer.  Callers may fill it in and then call
+  // PinSelf() to make this slice refer to its contents.
+  std::string* GetSelf() { return &buf_; }
+
+  // Release any pinned storage and make this slice empty.
+  void Reset();
+
+  // Return true iff this slice refers to storage outside of this object.
+  bool IsPinned() const { return cleanup_function_ != NULL; }
+
+ private:
+  void ReleasePinned();
+
+  std::string buf_;
+  CleanupFunction cleanup_function_;
+  void* cleanup_arg1_;
+  void* cleanup_arg2_;
+
+  // No copying allowed
+  PinnableSlice(const PinnableSlice&);
+  void operator=(const PinnableSlice&);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
@@ -63,6 +63,12 @@ class Slice {
     size_ -= n;
   }
 
+  // Drop the last "n" bytes from this slice.
+  void remove_suffix(size_t n) {
+    assert(n <= size());
+    size_ -= n;
+  }
+
   // Return a string that contains the copy of the referenced data.
   std::string ToString() const { return std::string(data_, size_); }
 
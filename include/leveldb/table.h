@@ -6,16 +6,19 @@
 #define STORAGE_LEVELDB_INCLUDE_TABLE_H_
 
 #include <stdint.h>
+#include <vector>
 #include "leveldb/iterator.h"
 
 namespace leveldb {
 
 class Block;
+struct BlockContents;
 class BlockHandle;
 class Footer;
 struct Options;
 class RandomAccessFile;
 struct ReadOptions;
+struct ReadRequest;
 class TableCache;
 
 // A Table is a sorted map from strings to strings.  Tables are
@@ -40,6 +43,16 @@ class Table {
                      uint64_t file_size,
                      Table** table);
 
+  // Like Open() above.  "file_number" is a number that identifies the
+  // table file across restarts; blocks of the table are stored in
+  // options.persistent_cache under it.  If "file_number" is zero, the
+  // persistent cache is not used.
+  static Status Open(const Options& options,
+                     RandomAccessFile* file,
+                     uint64_t file_size,
+                     uint64_t file_number,
+                     Table** table);
+
   ~Table();
 
   // Returns a new iterator over the table contents.
@@ -61,15 +74,78 @@ class Table {
 
   explicit Table(Rep* rep) { rep_ = rep; }
   static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+  static Iterator* ReadaheadBlockReader(void*, const ReadOptions&,
+                                        const Slice&);
+  Iterator* BlockReader(RandomAccessFile* file, const ReadOptions&,
+                        const Slice& index_value) const;
+
+  // Like NewIterator(), but if "upper_bound" is non-NULL the iterator
+  // may stop after the block holding the first key >= *upper_bound
+  // and does not read ahead past that block.
+  Iterator* NewIterator(const ReadOptions&, const Slice* upper_bound) const;
+  Status ReadBlockContents(RandomAccessFile* file, const ReadOptions&,
+                           const BlockHandle& handle,
+                           BlockContents* contents) const;
 
   // Calls (*handle_result)(arg, ...) with the entry found after a call
   // to Seek(key).  May not make such a call if filter policy says
   // that key is not present.
+  //
+  // If "pinned" is non-NULL and such a call was made, *pinned is set to
+  // the iterator over the block holding the entry, so that the slices
+  // passed to handle_result stay live until the caller deletes it.
+  // Otherwise *pinned is set to NULL.
   friend class TableCache;
   Status InternalGet(
       const ReadOptions&, const Slice& key,
       void* arg,
-      void (*handle_result)(void* arg, const Slice& k, const Slice& v));
+      void (*handle_result)(void* arg, const Slice& k, const Slice& v),
+      Iterator** pinned = NULL);
+
+  // InternalGet() in steps, so that the block reads of many lookups can
+  // be issued together with Env::MultiRead().
+  //
+  // PrepareGet() returns false if the table certainly holds no entry
+  // for "k", or on error, which it stores in *status.  Otherwise it
+  // stores in *handle the data block to search for "k" and in *block an
+  // iterator over that block if it is at hand without reading the table
+  // file (e.g. in the block cache), else NULL.
+  bool PrepareGet(const ReadOptions&, const Slice& k, BlockHandle* handle,
+                  Iterator** block, Status* status) const;
+
+  // Set up *req to read the block "handle" into a buffer allocated
+  // with new[].
+  void PrepareBlockRead(const BlockHandle& handle, ReadRequest* req) const;
+
+  // Return an iterator over the block read by *req, which was set up by
+  // PrepareBlockRead(handle, req), adding the block to the block cache.
+  // Frees the buffer of *req.
+  Iterator* FinishBlockRead(const ReadOptions&, const BlockHandle& handle,
+                            ReadRequest* req) const;
+
+  // Return the id that prefixes the keys of this table's blocks in
+  // options.block_cache.
+  uint64_t BlockCacheId() const;
+
+  // If "key" is a block cache key, store the id of the table it belongs
+  // to in *cache_id and the offset of the block in *offset and return
+  // true.  Else return false.
+  static bool ParseBlockCacheKey(const Slice& key, uint64_t* cache_id,
+                                 uint64_t* offset);
+
+  // Read the data blocks that start at the given sorted "offsets" into
+  // options.block_cache, merging reads of nearby blocks.  Offsets that
+  // do not start a data block are ignored.
+  Status LoadBlocks(const std::vector<uint64_t>& offsets) const;
+
+  // Read all data blocks into options.block_cache.
+  Status LoadAllBlocks() const;
+
+  // Append to *keys the keys of up to "n" index entries spread evenly
+  // over the table, always including the last one, and to *offsets the
+  // file offset just past the data block each of them ends.
+  void SampleIndexKeys(int n, std::vector<std::string>* keys,
+                       std::vector<uint64_t>* offsets) const;
 
 
   void ReadMeta(const Footer& footer);
@@ -70,10 +70,14 @@ Status Footer::DecodeFrom(Slice* input) {
 Status ReadBlock(RandomAccessFile* file,
                  const ReadOptions& options,
                  const BlockHandle& handle,
-                 BlockContents* result) {
+                 BlockContents* result,
+                 std::string* compressed) {
   result->data = Slice();
   result->cachable = false;
   result->heap_allocated = false;
+  if (compressed != NULL) {
+    compressed->clear();
+  }
 
   // Read the block contents as well as the type/crc footer.
   // See table_builder.cc for the code that built this structure.
@@ -124,29 +128,109 @@ Status ReadBlock(RandomAccessFile* file,
 
       // Ok
       break;
+    case kSnappyCompression: {
+      if (compressed != NULL) {
+        compressed->assign(data, n + 1);
+      }
+      s = UncompressBlock(Slice(data, n + 1), result);
+      delete[] buf;
+      if (!s.ok()) {
+        return s;
+      }
+      break;
+    }
+    default:
+      delete[] buf;
+      return Status::Corruption("bad block type");
+  }
+
+  return Status::OK();
+}
+
+Status ReadRawBlock(RandomAccessFile* file,
+                    const BlockHandle& handle,
+                    std::string* raw) {
+  const size_t n = static_cast<size_t>(handle.size()) + kBlockTrailerSize;
+  raw->resize(n);
+  Slice contents;
+  Status s = file->Read(handle.offset(), n, &contents, &(*raw)[0]);
+  if (!s.ok()) {
+    raw->clear();
+    return s;
+  }
+  if (contents.size() != n) {
+    raw->clear();
+    return Status::Corruption("truncated block read");
+  }
+  if (contents.data() != raw->data()) {
+    raw->assign(contents.data(), contents.size());
+  }
+  return s;
+}
+
+Status DecodeBlock(const Slice& raw, bool verify_checksum,
+                   BlockContents* result, std::string* compressed) {
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+  if (compressed != NULL) {
+    compressed->clear();
+  }
+  if (raw.size() < kBlockTrailerSize) {
+    return Status::Corruption("truncated block read");
+  }
+  const char* data = raw.data();
+  const size_t n = raw.size() - kBlockTrailerSize;
+  if (verify_checksum) {
+    const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + n + 1));
+    const uint32_t actual = crc32c::Value(data, n + 1);
+    if (actual != crc) {
+      return Status::Corruption("block checksum mismatch");
+    }
+  }
+
+  if (data[n] == kNoCompression) {
+    char* buf = new char[n];
+    memcpy(buf, data, n);
+    result->data = Slice(buf, n);
+    result->heap_allocated = true;
+    result->cachable = true;
+    return Status::OK();
+  }
+  if (compressed != NULL) {
+    compressed->assign(data, n + 1);
+  }
+  return UncompressBlock(Slice(data, n + 1), result);
+}
+
+Status UncompressBlock(const Slice& compressed, BlockContents* result) {
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+  if (compressed.empty()) {
+    return Status::Corruption("empty compressed block");
+  }
+  const char* data = compressed.data();
+  const size_t n = compressed.size() - 1;
+  switch (data[n]) {
     case kSnappyCompression: {
       size_t ulength = 0;
       if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
-        delete[] buf;
         return Status::Corruption("corrupted compressed block contents");
       }
       char* ubuf = new char[ulength];
       if (!port::Snappy_Uncompress(data, n, ubuf)) {
-        delete[] buf;
         delete[] ubuf;
         return Status::Corruption("corrupted compressed block contents");
       }
-      delete[] buf;
       result->data = Slice(ubuf, ulength);
       result->heap_allocated = true;
       result->cachable = true;
       break;
     }
     default:
-      delete[] buf;
       return Status::Corruption("bad block type");
   }
-
   return Status::OK();
 }
 
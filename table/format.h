@@ -95,10 +95,34 @@ struct BlockContents {
 
 // Read the block identified by "handle" from "file".  On failure
 // return non-OK.  On success fill *result and return OK.
+//
+// If "compressed" is non-NULL and the block is stored compressed, its
+// stored form (the block data followed by the one-byte compression
+// type) is copied into *compressed so that it can be cached and later
+// decoded with UncompressBlock().  Otherwise *compressed is cleared.
 extern Status ReadBlock(RandomAccessFile* file,
                         const ReadOptions& options,
                         const BlockHandle& handle,
-                        BlockContents* result);
+                        BlockContents* result,
+                        std::string* compressed = NULL);
+
+// Read the block identified by "handle" from "file" as it is stored:
+// its contents followed by the block trailer.  On success store it in
+// *raw and return OK.
+extern Status ReadRawBlock(RandomAccessFile* file,
+                           const BlockHandle& handle,
+                           std::string* raw);
+
+// Check and decode a block read by ReadRawBlock().  The checksum is
+// verified if "verify_checksum" is true.  On success fill *result with
+// heap allocated contents and return OK.  "compressed" is handled as
+// by ReadBlock().
+extern Status DecodeBlock(const Slice& raw, bool verify_checksum,
+                          BlockContents* result, std::string* compressed);
+
+// Decode a block in the compressed form produced by ReadBlock().  On
+// success fill *result with heap allocated contents and return OK.
+extern Status UncompressBlock(const Slice& compressed, BlockContents* result);
 
 // Implementation details follow.  Clients should ignore,
 
@@ -4,11 +4,14 @@
 
 #include "leveldb/table.h"
 
+#include <algorithm>
+
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/persistent_cache.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -28,6 +31,9 @@ struct Table::Rep {
   Status status;
   RandomAccessFile* file;
   uint64_t cache_id;
+  uint64_t compressed_cache_id;
+  uint64_t file_number;   // Zero if the table is not in a persistent cache
+  uint64_t file_size;
   FilterBlockReader* filter;
   const char* filter_data;
 
@@ -40,6 +46,14 @@ Status Table::Open(const Options& options,
                    RandomAccessFile* file,
                    uint64_t size,
                    Table** table) {
+  return Open(options, file, size, 0, table);
+}
+
+Status Table::Open(const Options& options,
+                   RandomAccessFile* file,
+                   uint64_t size,
+                   uint64_t file_number,
+                   Table** table) {
   *table = NULL;
   if (size < Footer::kEncodedLength) {
     return Status::InvalidArgument("file is too short to be an sstable");
@@ -78,6 +92,10 @@ Status Table::Open(const Options& options,
     rep->metaindex_handle = footer.metaindex_handle();
     rep->index_block = index_block;
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
+    rep->compressed_cache_id = (options.compressed_block_cache ?
+                                options.compressed_block_cache->NewId() : 0);
+    rep->file_number = file_number;
+    rep->file_size = size;
     rep->filter_data = NULL;
     rep->filter = NULL;
     *table = new Table(rep);
@@ -152,20 +170,249 @@ static void DeleteCachedBlock(const Slice& key, void* value) {
   delete block;
 }
 
+static void DeleteCompressedBlock(const Slice& key, void* value) {
+  std::string* compressed = reinterpret_cast<std::string*>(value);
+  delete compressed;
+}
+
 static void ReleaseBlock(void* arg, void* h) {
   Cache* cache = reinterpret_cast<Cache*>(arg);
   Cache::Handle* handle = reinterpret_cast<Cache::Handle*>(h);
   cache->Release(handle);
 }
 
-// 根据传入的index iterator的值,得到其对应的data block,返回这个data block的iterator
-// Convert an index iterator value (i.e., an encoded BlockHandle)
-// into an iterator over the contents of the corresponding block.
+namespace {
+
+static const size_t kInitialReadahead = 8 << 10;
+static const size_t kMaxReadahead = 256 << 10;
+static const int kSequentialReadsForReadahead = 2;
+
+// A view of a table file owned by a single table iterator.  Once it
+// sees a run of back-to-back block reads it starts reading ahead of
+// the requested block and serves the following blocks out of its
+// buffer, so that a scan over a file read with pread(2) issues a few
+// large reads instead of one small read per block.  The readahead
+// window starts at kInitialReadahead and doubles on every refill up
+// to kMaxReadahead; a non-sequential read resets it.
+//
+// Files that hand out pointers into their own memory (e.g. mmap-ed
+// files) gain nothing from this, so readahead is switched off as soon
+// as such a file is detected.
+//
+// Not thread-safe: the owning iterator provides the synchronization.
+class ReadaheadFile : public RandomAccessFile {
+ public:
+  // If "fixed_size" is non-zero, every read that misses the buffer
+  // reads "fixed_size" bytes; otherwise the window adapts as above.
+  // Readahead never extends past offset "limit".
+  ReadaheadFile(RandomAccessFile* file, size_t fixed_size, uint64_t limit)
+      : file_(file),
+        fixed_size_(fixed_size),
+        limit_(limit),
+        readahead_size_(kInitialReadahead),
+        disabled_(false),
+        sequential_reads_(0),
+        prev_end_(0),
+        buf_(NULL),
+        buf_capacity_(0),
+        buf_offset_(0),
+        buf_len_(0) {
+  }
+
+  virtual ~ReadaheadFile() {
+    delete[] buf_;
+  }
+
+  virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                      char* scratch) const {
+    if (disabled_) {
+      return file_->Read(offset, n, result, scratch);
+    }
+
+    // Serve the read from the buffer if it is fully covered.
+    if (offset >= buf_offset_ && offset + n <= buf_offset_ + buf_len_) {
+      memcpy(scratch, buf_ + (offset - buf_offset_), n);
+      *result = Slice(scratch, n);
+      prev_end_ = offset + n;
+      return Status::OK();
+    }
+
+    if (offset == prev_end_) {
+      sequential_reads_++;
+    } else {
+      sequential_reads_ = 0;
+      readahead_size_ = kInitialReadahead;
+    }
+    prev_end_ = offset + n;
+
+    size_t want = fixed_size_;
+    if (want == 0 && sequential_reads_ >= kSequentialReadsForReadahead) {
+      want = readahead_size_;
+    }
+    if (offset < limit_ && want > limit_ - offset) {
+      want = limit_ - offset;
+    }
+    if (want <= n) {
+      Status s = file_->Read(offset, n, result, scratch);
+      if (s.ok() && result->data() != scratch) {
+        disabled_ = true;
+      }
+      return s;
+    }
+
+    if (buf_capacity_ < want) {
+      delete[] buf_;
+      buf_ = new char[want];
+      buf_capacity_ = want;
+    }
+    buf_len_ = 0;
+    Slice contents;
+    Status s = file_->Read(offset, want, &contents, buf_);
+    if (!s.ok()) {
+      return s;
+    }
+    const size_t avail = std::min(n, contents.size());
+    if (contents.data() != buf_) {
+      disabled_ = true;
+      *result = Slice(contents.data(), avail);
+      return s;
+    }
+    buf_offset_ = offset;
+    buf_len_ = contents.size();
+    memcpy(scratch, buf_, avail);
+    *result = Slice(scratch, avail);
+    if (fixed_size_ == 0 && readahead_size_ < kMaxReadahead) {
+      readahead_size_ = std::min(readahead_size_ * 2, kMaxReadahead);
+    }
+    return s;
+  }
+
+ private:
+  RandomAccessFile* const file_;
+  const size_t fixed_size_;
+  const uint64_t limit_;
+  mutable size_t readahead_size_;
+  mutable bool disabled_;
+  mutable int sequential_reads_;
+  mutable uint64_t prev_end_;   // Offset just past the previous read
+  mutable char* buf_;
+  mutable size_t buf_capacity_;
+  mutable uint64_t buf_offset_;  // File offset of buf_[0]
+  mutable size_t buf_len_;       // Number of valid bytes in buf_
+};
+
+// State shared by the blocks of a single table iterator.
+struct IteratorState {
+  Table* table;
+  uint64_t limit;     // Blocks starting at or after this offset are skipped
+  ReadaheadFile file;
+
+  IteratorState(Table* t, RandomAccessFile* f, size_t readahead_size,
+                uint64_t l)
+      : table(t), limit(l), file(f, readahead_size, l) { }
+};
+
+static void DeleteIteratorState(void* arg, void* ignored) {
+  delete reinterpret_cast<IteratorState*>(arg);
+}
+
+}  // namespace
+
 Iterator* Table::BlockReader(void* arg,
                              const ReadOptions& options,
                              const Slice& index_value) {
   Table* table = reinterpret_cast<Table*>(arg);
-  Cache* block_cache = table->rep_->options.block_cache;
+  return table->BlockReader(table->rep_->file, options, index_value);
+}
+
+Iterator* Table::ReadaheadBlockReader(void* arg,
+                                      const ReadOptions& options,
+                                      const Slice& index_value) {
+  IteratorState* state = reinterpret_cast<IteratorState*>(arg);
+  BlockHandle handle;
+  Slice input = index_value;
+  if (handle.DecodeFrom(&input).ok() && handle.offset() >= state->limit) {
+    // Only holds keys past the iterator's upper bound
+    return NewEmptyIterator();
+  }
+  return state->table->BlockReader(&state->file, options, index_value);
+}
+
+// 根据传入的index iterator的值,得到其对应的data block,返回这个data block的iterator
+// Convert an index iterator value (i.e., an encoded BlockHandle)
+// into an iterator over the contents of the corresponding block.
+// Read the block identified by "handle" from the first of the tiers
+// below the block cache that holds it, filling the tiers that missed.
+//  1. compressed_block_cache: a block that fell out of the block cache
+//     may still be held in compressed form, which is cheaper to
+//     decompress than to read again.
+//  2. persistent_cache: blocks kept on faster local storage, keyed by
+//     file number, file size and offset so that they stay valid across
+//     restarts.
+//  3. The table file itself.
+Status Table::ReadBlockContents(RandomAccessFile* file,
+                                const ReadOptions& options,
+                                const BlockHandle& handle,
+                                BlockContents* contents) const {
+  Cache* compressed_cache = rep_->options.compressed_block_cache;
+  char compressed_key_buffer[16];
+  EncodeFixed64(compressed_key_buffer, rep_->compressed_cache_id);
+  EncodeFixed64(compressed_key_buffer+8, handle.offset());
+  Slice compressed_key(compressed_key_buffer, sizeof(compressed_key_buffer));
+  if (compressed_cache != NULL) {
+    Cache::Handle* h = compressed_cache->Lookup(compressed_key);
+    if (h != NULL) {
+      const std::string* compressed =
+          reinterpret_cast<std::string*>(compressed_cache->Value(h));
+      Status s = UncompressBlock(*compressed, contents);
+      compressed_cache->Release(h);
+      return s;
+    }
+  }
+
+  std::string* compressed = NULL;
+  if (compressed_cache != NULL && options.fill_cache) {
+    compressed = new std::string;
+  }
+  Status s;
+  PersistentCache* persistent_cache = rep_->options.persistent_cache;
+  if (persistent_cache != NULL && rep_->file_number != 0) {
+    char persistent_key_buffer[24];
+    EncodeFixed64(persistent_key_buffer, rep_->file_number);
+    EncodeFixed64(persistent_key_buffer+8, rep_->file_size);
+    EncodeFixed64(persistent_key_buffer+16, handle.offset());
+    Slice persistent_key(persistent_key_buffer, sizeof(persistent_key_buffer));
+    // Cached blocks are always verified; a bad one is read again.
+    std::string raw;
+    if (!persistent_cache->Lookup(persistent_key, &raw).ok() ||
+        raw.size() != handle.size() + kBlockTrailerSize ||
+        !DecodeBlock(raw, true, contents, compressed).ok()) {
+      s = ReadRawBlock(file, handle, &raw);
+      if (s.ok()) {
+        s = DecodeBlock(raw, options.verify_checksums, contents, compressed);
+      }
+      if (s.ok() && options.fill_cache) {
+        persistent_cache->Insert(persistent_key, raw);  // Ignore errors
+      }
+    }
+  } else {
+    s = ReadBlock(file, options, handle, contents, compressed);
+  }
+
+  if (s.ok() && compressed != NULL && !compressed->empty()) {
+    compressed_cache->Release(compressed_cache->Insert(
+        compressed_key, compressed, compressed->size(),
+        &DeleteCompressedBlock));
+  } else {
+    delete compressed;
+  }
+  return s;
+}
+
+Iterator* Table::BlockReader(RandomAccessFile* file,
+                             const ReadOptions& options,
+                             const Slice& index_value) const {
+  Cache* block_cache = rep_->options.block_cache;
   Block* block = NULL;
   Cache::Handle* cache_handle = NULL;
 
@@ -180,7 +427,7 @@ Iterator* Table::BlockReader(void* arg,
     if (block_cache != NULL) {
       // 如果block_cache不为NULL
       char cache_key_buffer[16];
-      EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
+      EncodeFixed64(cache_key_buffer, rep_->cache_id);
       EncodeFixed64(cache_key_buffer+8, handle.offset());
       Slice key(cache_key_buffer, sizeof(cache_key_buffer));
       // 根据key查询缓存
@@ -190,7 +437,7 @@ Iterator* Table::BlockReader(void* arg,
         block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
       } else {
     	// 不成功,那么就到block中查找
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        s = ReadBlockContents(file, options, handle, &contents);
         if (s.ok()) {
         // 然后存放到缓存中
           block = new Block(contents);
@@ -201,7 +448,7 @@ Iterator* Table::BlockReader(void* arg,
         }
       }
     } else {
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
+      s = ReadBlockContents(file, options, handle, &contents);
       if (s.ok()) {
         block = new Block(contents);
       }
@@ -210,7 +457,7 @@ Iterator* Table::BlockReader(void* arg,
 
   Iterator* iter;
   if (block != NULL) {
-    iter = block->NewIterator(table->rep_->options.comparator);
+    iter = block->NewIterator(rep_->options.comparator);
     if (cache_handle == NULL) {
       iter->RegisterCleanup(&DeleteBlock, block, NULL);
     } else {
@@ -223,16 +470,47 @@ Iterator* Table::BlockReader(void* arg,
 }
 
 Iterator* Table::NewIterator(const ReadOptions& options) const {
+  return NewIterator(options, NULL);
+}
+
+Iterator* Table::NewIterator(const ReadOptions& options,
+                             const Slice* upper_bound) const {
+  // Blocks after the one holding the first key >= *upper_bound can only
+  // hold larger keys, so they are neither read nor read ahead.
+  uint64_t limit = ~static_cast<uint64_t>(0);
+  if (upper_bound != NULL) {
+    Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+    iiter->Seek(*upper_bound);
+    if (iiter->Valid()) {
+      BlockHandle handle;
+      Slice input = iiter->value();
+      if (handle.DecodeFrom(&input).ok()) {
+        limit = handle.offset() + handle.size() + kBlockTrailerSize;
+      }
+    }
+    delete iiter;
+  }
+
   // 这又是一个NewTwoLevelIterator,其中的index iter是index block返回的iter,data block函数由blockreader函数提供
   // 所以可以看到这是根据index block的信息来指引data block步伐的iter
-  return NewTwoLevelIterator(
+  IteratorState* state = new IteratorState(const_cast<Table*>(this),
+                                            rep_->file,
+                                            options.readahead_size,
+                                            limit);
+  Iterator* iter = NewTwoLevelIterator(
       rep_->index_block->NewIterator(rep_->options.comparator),
-      &Table::BlockReader, const_cast<Table*>(this), options);
+      &Table::ReadaheadBlockReader, state, options, rep_->options.env);
+  iter->RegisterCleanup(&DeleteIteratorState, state, NULL);
+  return iter;
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k,
                           void* arg,
-                          void (*saver)(void*, const Slice&, const Slice&)) {
+                          void (*saver)(void*, const Slice&, const Slice&),
+                          Iterator** pinned) {
+  if (pinned != NULL) {
+    *pinned = NULL;
+  }
   Status s;
   Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
   iiter->Seek(k);
@@ -248,11 +526,17 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k,
       Slice handle = iiter->value();
       Iterator* block_iter = BlockReader(this, options, iiter->value());
       block_iter->Seek(k);
+      bool called = false;
       if (block_iter->Valid()) {
         (*saver)(arg, block_iter->key(), block_iter->value());
+        called = true;
       }
       s = block_iter->status();
-      delete block_iter;
+      if (called && pinned != NULL) {
+        *pinned = block_iter;
+      } else {
+        delete block_iter;
+      }
     }
   }
   if (s.ok()) {
@@ -263,6 +547,234 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k,
 }
 
 
+bool Table::PrepareGet(const ReadOptions& options, const Slice& k,
+                       BlockHandle* handle, Iterator** block,
+                       Status* status) const {
+  *block = NULL;
+  *status = Status::OK();
+  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  iiter->Seek(k);
+  bool result = false;
+  if (iiter->Valid()) {
+    Slice handle_value = iiter->value();
+    FilterBlockReader* filter = rep_->filter;
+    *status = handle->DecodeFrom(&handle_value);
+    if (status->ok() &&
+        (filter == NULL || filter->KeyMayMatch(handle->offset(), k))) {
+      result = true;
+      Cache* block_cache = rep_->options.block_cache;
+      Cache::Handle* cache_handle = NULL;
+      if (block_cache != NULL) {
+        char cache_key_buffer[16];
+        EncodeFixed64(cache_key_buffer, rep_->cache_id);
+        EncodeFixed64(cache_key_buffer+8, handle->offset());
+        Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+        cache_handle = block_cache->Lookup(key);
+      }
+      if (cache_handle != NULL) {
+        Block* b = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
+        *block = b->NewIterator(rep_->options.comparator);
+        (*block)->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
+      } else if (rep_->options.compressed_block_cache != NULL ||
+                 rep_->options.persistent_cache != NULL) {
+        // The tiers below the block cache are searched one block at a time
+        *block = BlockReader(rep_->file, options, iiter->value());
+      }
+    }
+  }
+  if (status->ok()) {
+    *status = iiter->status();
+  }
+  delete iiter;
+  return result && status->ok();
+}
+
+void Table::PrepareBlockRead(const BlockHandle& handle,
+                             ReadRequest* req) const {
+  req->file = rep_->file;
+  req->offset = handle.offset();
+  req->n = static_cast<size_t>(handle.size() + kBlockTrailerSize);
+  req->scratch = new char[req->n];
+}
+
+Iterator* Table::FinishBlockRead(const ReadOptions& options,
+                                 const BlockHandle& handle,
+                                 ReadRequest* req) const {
+  BlockContents contents;
+  Status s = req->status;
+  if (s.ok()) {
+    if (req->result.size() != req->n) {
+      s = Status::Corruption("truncated block read");
+    } else {
+      s = DecodeBlock(req->result, options.verify_checksums, &contents, NULL);
+    }
+  }
+  delete[] req->scratch;
+  req->scratch = NULL;
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+
+  Block* block = new Block(contents);
+  Cache* block_cache = rep_->options.block_cache;
+  Cache::Handle* cache_handle = NULL;
+  if (block_cache != NULL && contents.cachable && options.fill_cache) {
+    char cache_key_buffer[16];
+    EncodeFixed64(cache_key_buffer, rep_->cache_id);
+    EncodeFixed64(cache_key_buffer+8, handle.offset());
+    Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+    cache_handle = block_cache->Insert(key, block, block->size(),
+                                       &DeleteCachedBlock);
+  }
+  Iterator* iter = block->NewIterator(rep_->options.comparator);
+  if (cache_handle == NULL) {
+    iter->RegisterCleanup(&DeleteBlock, block, NULL);
+  } else {
+    iter->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
+  }
+  return iter;
+}
+
+uint64_t Table::BlockCacheId() const {
+  return rep_->cache_id;
+}
+
+bool Table::ParseBlockCacheKey(const Slice& key, uint64_t* cache_id,
+                               uint64_t* offset) {
+  if (key.size() != 16) {
+    return false;
+  }
+  *cache_id = DecodeFixed64(key.data());
+  *offset = DecodeFixed64(key.data() + 8);
+  return true;
+}
+
+namespace {
+// Blocks separated by at most kMaxLoadGap bytes are fetched with one
+// read of at most kMaxLoadRead bytes (unless a single block is larger).
+static const uint64_t kMaxLoadGap = 32 << 10;
+static const uint64_t kMaxLoadRead = 1 << 20;
+}
+
+Status Table::LoadAllBlocks() const {
+  std::vector<uint64_t> offsets;
+  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  for (iiter->SeekToFirst(); iiter->Valid(); iiter->Next()) {
+    BlockHandle handle;
+    Slice input = iiter->value();
+    if (handle.DecodeFrom(&input).ok()) {
+      offsets.push_back(handle.offset());
+    }
+  }
+  Status s = iiter->status();
+  delete iiter;
+  if (s.ok()) {
+    s = LoadBlocks(offsets);
+  }
+  return s;
+}
+
+Status Table::LoadBlocks(const std::vector<uint64_t>& offsets) const {
+  Cache* block_cache = rep_->options.block_cache;
+  if (block_cache == NULL || offsets.empty()) {
+    return Status::OK();
+  }
+
+  // The index lists the data blocks in file order, so the handles of
+  // the requested blocks come out sorted as well.
+  std::vector<BlockHandle> handles;
+  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  size_t next = 0;
+  for (iiter->SeekToFirst(); iiter->Valid() && next < offsets.size();
+       iiter->Next()) {
+    BlockHandle handle;
+    Slice input = iiter->value();
+    if (!handle.DecodeFrom(&input).ok()) {
+      continue;
+    }
+    while (next < offsets.size() && offsets[next] < handle.offset()) {
+      next++;
+    }
+    if (next < offsets.size() && offsets[next] == handle.offset()) {
+      handles.push_back(handle);
+      next++;
+    }
+  }
+  Status s = iiter->status();
+  delete iiter;
+
+  std::string scratch;
+  size_t i = 0;
+  while (s.ok() && i < handles.size()) {
+    // Extend the read over the following blocks while they are close.
+    const uint64_t start = handles[i].offset();
+    uint64_t end = start + handles[i].size() + kBlockTrailerSize;
+    size_t j = i + 1;
+    while (j < handles.size() &&
+           handles[j].offset() <= end + kMaxLoadGap &&
+           handles[j].offset() + handles[j].size() + kBlockTrailerSize -
+           start <= kMaxLoadRead) {
+      end = handles[j].offset() + handles[j].size() + kBlockTrailerSize;
+      j++;
+    }
+
+    scratch.resize(end - start);
+    Slice data;
+    s = rep_->file->Read(start, end - start, &data, &scratch[0]);
+    if (s.ok() && data.size() != end - start) {
+      s = Status::Corruption("truncated block read");
+    }
+    for (; s.ok() && i < j; i++) {
+      const BlockHandle& handle = handles[i];
+      char cache_key_buffer[16];
+      EncodeFixed64(cache_key_buffer, rep_->cache_id);
+      EncodeFixed64(cache_key_buffer+8, handle.offset());
+      Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+      Cache::Handle* cache_handle = block_cache->Lookup(key);
+      if (cache_handle == NULL) {
+        BlockContents contents;
+        Slice raw(data.data() + (handle.offset() - start),
+                  handle.size() + kBlockTrailerSize);
+        s = DecodeBlock(raw, true, &contents, NULL);
+        if (s.ok()) {
+          Block* block = new Block(contents);
+          cache_handle = block_cache->Insert(
+              key, block, block->size(), &DeleteCachedBlock);
+        }
+      }
+      if (cache_handle != NULL) {
+        block_cache->Release(cache_handle);
+      }
+    }
+  }
+  return s;
+}
+
+
+void Table::SampleIndexKeys(int n, std::vector<std::string>* keys,
+                            std::vector<uint64_t>* offsets) const {
+  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  int num_blocks = 0;
+  for (iiter->SeekToFirst(); iiter->Valid(); iiter->Next()) {
+    num_blocks++;
+  }
+  const int step = std::max(1, (num_blocks + n - 1) / std::max(n, 1));
+  int i = 0;
+  for (iiter->SeekToFirst(); iiter->Valid(); iiter->Next()) {
+    i++;
+    if (i % step != 0 && i != num_blocks) {
+      continue;
+    }
+    BlockHandle handle;
+    Slice input = iiter->value();
+    if (handle.DecodeFrom(&input).ok()) {
+      keys->push_back(iiter->key().ToString());
+      offsets->push_back(handle.offset() + handle.size() + kBlockTrailerSize);
+    }
+  }
+  delete iiter;
+}
+
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
   Iterator* index_iter =
       rep_->index_block->NewIterator(rep_->options.comparator);
@@ -16,6 +16,7 @@
 #include "table/block.h"
 #include "table/block_builder.h"
 #include "table/format.h"
+#include "leveldb/cache.h"
 #include "util/random.h"
 #include "util/testharness.h"
 #include "util/testutil.h"
@@ -797,6 +798,97 @@ TEST(TableTest, ApproximateOffsetOfPlain) {
 
 }
 
+// A file that counts the reads issued against it.  If "stable" is
+// true, results point into the file's own memory the way an mmap-ed
+// file would.
+class CountingSource : public RandomAccessFile {
+ public:
+  CountingSource(const std::string& contents, bool stable)
+      : contents_(contents), stable_(stable), reads_(0) { }
+
+  int reads() const { return reads_; }
+
+  virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                      char* scratch) const {
+    reads_++;
+    if (offset > contents_.size()) {
+      return Status::InvalidArgument("invalid Read offset");
+    }
+    if (offset + n > contents_.size()) {
+      n = contents_.size() - offset;
+    }
+    if (stable_) {
+      *result = Slice(contents_.data() + offset, n);
+    } else {
+      memcpy(scratch, &contents_[offset], n);
+      *result = Slice(scratch, n);
+    }
+    return Status::OK();
+  }
+
+ private:
+  std::string contents_;
+  bool stable_;
+  mutable int reads_;
+};
+
+// Builds a table holding "n" entries of about 1KB each and returns the
+// number of reads a full scan issues against it.
+static int CountScanReads(int n, bool stable, size_t readahead) {
+  Options options;
+  options.block_size = 2048;
+  options.compression = kNoCompression;
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  char key[20];
+  for (int i = 0; i < n; i++) {
+    snprintf(key, sizeof(key), "k%06d", i);
+    builder.Add(key, std::string(1000, 'v'));
+  }
+  ASSERT_OK(builder.Finish());
+
+  CountingSource* source = new CountingSource(sink.contents(), stable);
+  Table* table = NULL;
+  ASSERT_OK(Table::Open(options, source, sink.contents().size(), &table));
+  const int reads_before_scan = source->reads();
+
+  ReadOptions read_options;
+  read_options.readahead_size = readahead;
+  Iterator* iter = table->NewIterator(read_options);
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    snprintf(key, sizeof(key), "k%06d", count);
+    ASSERT_EQ(key, iter->key().ToString());
+    ASSERT_EQ(std::string(1000, 'v'), iter->value().ToString());
+    count++;
+  }
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(n, count);
+  delete iter;
+  const int result = source->reads() - reads_before_scan;
+  delete table;
+  delete source;
+  return result;
+}
+
+TEST(TableTest, AdaptiveReadahead) {
+  // Files that hand out pointers into their own memory get no
+  // readahead, so the scan reads every block separately.
+  const int blocks = CountScanReads(2000, true, 0);
+  ASSERT_GT(blocks, 500);
+
+  // With pread-style files the window grows to 256KB, so the scan
+  // needs only a small number of reads.
+  const int adaptive = CountScanReads(2000, false, 0);
+  ASSERT_GT(adaptive, 1);
+  ASSERT_LT(adaptive, blocks / 30);
+
+  // A fixed readahead size reads that much on every refill.
+  const int fixed = CountScanReads(2000, false, 64 << 10);
+  ASSERT_GT(fixed, 2000 * 1000 / (64 << 10));
+  ASSERT_LT(fixed, blocks / 10);
+}
+
 static bool SnappyCompressionSupported() {
   std::string out;
   Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
@@ -831,6 +923,67 @@ TEST(TableTest, ApproximateOffsetOfCompressed) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"),    4000,   6000));
 }
 
+// Scans a snappy compressed table twice through a block cache that
+// cannot hold anything and returns the number of reads the second scan
+// issues.
+static int CountRescanReads(size_t compressed_cache_capacity) {
+  Options options;
+  options.block_size = 2048;
+  options.compression = kSnappyCompression;
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  char key[20];
+  const int n = 1000;
+  for (int i = 0; i < n; i++) {
+    snprintf(key, sizeof(key), "k%06d", i);
+    builder.Add(key, std::string(1000, 'a' + (i % 26)));
+  }
+  ASSERT_OK(builder.Finish());
+
+  options.block_cache = NewLRUCache(0);
+  options.compressed_block_cache = NewLRUCache(compressed_cache_capacity);
+  CountingSource* source = new CountingSource(sink.contents(), true);
+  Table* table = NULL;
+  ASSERT_OK(Table::Open(options, source, sink.contents().size(), &table));
+
+  int reads = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    reads = source->reads();
+    Iterator* iter = table->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      snprintf(key, sizeof(key), "k%06d", count);
+      ASSERT_EQ(key, iter->key().ToString());
+      ASSERT_EQ(std::string(1000, 'a' + (count % 26)),
+                iter->value().ToString());
+      count++;
+    }
+    ASSERT_OK(iter->status());
+    ASSERT_EQ(n, count);
+    delete iter;
+    reads = source->reads() - reads;
+  }
+  delete table;
+  delete source;
+  delete options.block_cache;
+  delete options.compressed_block_cache;
+  return reads;
+}
+
+TEST(TableTest, CompressedBlockCache) {
+  if (!SnappyCompressionSupported()) {
+    fprintf(stderr, "skipping compression tests\n");
+    return;
+  }
+
+  // Without room in the compressed cache every block is read again.
+  ASSERT_GT(CountRescanReads(0), 300);
+
+  // The whole table fits in the compressed cache, so the second scan
+  // is served from memory.
+  ASSERT_EQ(0, CountRescanReads(1 << 20));
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
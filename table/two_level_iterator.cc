@@ -4,10 +4,13 @@
 
 #include "table/two_level_iterator.h"
 
+#include "leveldb/env.h"
 #include "leveldb/table.h"
+#include "port/port.h"
 #include "table/block.h"
 #include "table/format.h"
 #include "table/iterator_wrapper.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
@@ -15,13 +18,39 @@ namespace {
 
 typedef Iterator* (*BlockFunction)(void*, const ReadOptions&, const Slice&);
 
+// A block being read in the background on behalf of a TwoLevelIterator.
+struct Prefetch {
+  BlockFunction block_function;
+  void* arg;
+  const ReadOptions* options;
+  std::string handle;
+
+  port::Mutex mu;
+  port::CondVar cv;
+  bool done;              // Protected by mu
+  Iterator* result;       // Protected by mu
+
+  Prefetch() : cv(&mu), done(false), result(NULL) { }
+};
+
+static void RunPrefetch(void* arg) {
+  Prefetch* p = reinterpret_cast<Prefetch*>(arg);
+  Iterator* iter = (*p->block_function)(p->arg, *p->options, p->handle);
+  iter->SeekToFirst();
+  MutexLock l(&p->mu);
+  p->result = iter;
+  p->done = true;
+  p->cv.Signal();
+}
+
 class TwoLevelIterator: public Iterator {
  public:
   TwoLevelIterator(
     Iterator* index_iter,
     BlockFunction block_function,
     void* arg,
-    const ReadOptions& options);
+    const ReadOptions& options,
+    Env* env);
 
   virtual ~TwoLevelIterator();
 
@@ -61,6 +90,8 @@ class TwoLevelIterator: public Iterator {
   void SkipEmptyDataBlocksBackward();
   void SetDataIterator(Iterator* data_iter);
   void InitDataBlock();
+  void StartPrefetch();
+  Iterator* FinishPrefetch(std::string* handle);
 
   BlockFunction block_function_;	// block操作函数
   void* arg_;									// block操作函数的参数
@@ -71,21 +102,34 @@ class TwoLevelIterator: public Iterator {
   // If data_iter_ is non-NULL, then "data_block_handle_" holds the
   // "index_value" passed to block_function_ to create the data_iter_.
   std::string data_block_handle_;
+
+  Env* const env_;
+  Prefetch* prefetch_;  // Pending background read, or NULL
+  // Handle of the block whose successor was last prefetched
+  std::string prefetch_base_;
 };
 
 TwoLevelIterator::TwoLevelIterator(
     Iterator* index_iter,
     BlockFunction block_function,
     void* arg,
-    const ReadOptions& options)
+    const ReadOptions& options,
+    Env* env)
     : block_function_(block_function),
       arg_(arg),
       options_(options),
       index_iter_(index_iter),
-      data_iter_(NULL) {
+      data_iter_(NULL),
+      env_(env),
+      prefetch_(NULL) {
+  assert(env_ != NULL || !options_.async_prefetch);
 }
 
 TwoLevelIterator::~TwoLevelIterator() {
+  if (prefetch_ != NULL) {
+    std::string ignored;
+    delete FinishPrefetch(&ignored);
+  }
 }
 
 void TwoLevelIterator::Seek(const Slice& target) {
@@ -95,6 +139,7 @@ void TwoLevelIterator::Seek(const Slice& target) {
   // data iterator定位到目标所在位置
   if (data_iter_.iter() != NULL) data_iter_.Seek(target);
   SkipEmptyDataBlocksForward();
+  StartPrefetch();
 }
 
 void TwoLevelIterator::SeekToFirst() {
@@ -102,6 +147,7 @@ void TwoLevelIterator::SeekToFirst() {
   InitDataBlock();
   if (data_iter_.iter() != NULL) data_iter_.SeekToFirst();
   SkipEmptyDataBlocksForward();
+  StartPrefetch();
 }
 
 void TwoLevelIterator::SeekToLast() {
@@ -137,6 +183,7 @@ void TwoLevelIterator::SkipEmptyDataBlocksForward() {
     InitDataBlock();
     // 跳转到开始
     if (data_iter_.iter() != NULL) data_iter_.SeekToFirst();
+    StartPrefetch();
   }
 }
 
@@ -176,21 +223,84 @@ void TwoLevelIterator::InitDataBlock() {
       // data_iter已经在该block data上了，无须改变
     } else {
       // 根据handle数据定位data iter
-      Iterator* iter = (*block_function_)(arg_, options_, handle);
+      Iterator* iter = NULL;
+      if (prefetch_ != NULL) {
+        std::string prefetched_handle;
+        Iterator* prefetched = FinishPrefetch(&prefetched_handle);
+        if (handle.compare(prefetched_handle) == 0) {
+          iter = prefetched;
+        } else {
+          delete prefetched;
+        }
+      }
+      if (iter == NULL) {
+        iter = (*block_function_)(arg_, options_, handle);
+      }
       data_block_handle_.assign(handle.data(), handle.size());
       SetDataIterator(iter);
     }
   }
 }
 
+// Start reading the block after the current one in the background,
+// unless that has already been done for the current block.
+void TwoLevelIterator::StartPrefetch() {
+  if (!options_.async_prefetch || prefetch_ != NULL ||
+      !index_iter_.Valid() || data_iter_.iter() == NULL ||
+      Slice(prefetch_base_) == Slice(data_block_handle_)) {
+    return;
+  }
+  prefetch_base_ = data_block_handle_;
+
+  // Peek at the next index entry, then return to the current one.
+  // Index keys are distinct, so seeking to the current key restores
+  // the position exactly.
+  std::string current_key = index_iter_.key().ToString();
+  std::string next_handle;
+  index_iter_.Next();
+  if (index_iter_.Valid()) {
+    next_handle = index_iter_.value().ToString();
+  }
+  index_iter_.Seek(current_key);
+  if (next_handle.empty()) {
+    return;
+  }
+
+  prefetch_ = new Prefetch;
+  prefetch_->block_function = block_function_;
+  prefetch_->arg = arg_;
+  prefetch_->options = &options_;
+  prefetch_->handle.swap(next_handle);
+  env_->ScheduleIO(&RunPrefetch, prefetch_);
+}
+
+// Wait for the pending prefetch to complete and return its result.
+// The caller takes ownership of the returned iterator.
+Iterator* TwoLevelIterator::FinishPrefetch(std::string* handle) {
+  assert(prefetch_ != NULL);
+  Iterator* result;
+  {
+    MutexLock l(&prefetch_->mu);
+    while (!prefetch_->done) {
+      prefetch_->cv.Wait();
+    }
+    result = prefetch_->result;
+  }
+  handle->swap(prefetch_->handle);
+  delete prefetch_;
+  prefetch_ = NULL;
+  return result;
+}
+
 }  // namespace
 
 Iterator* NewTwoLevelIterator(
     Iterator* index_iter,
     BlockFunction block_function,
     void* arg,
-    const ReadOptions& options) {
-  return new TwoLevelIterator(index_iter, block_function, arg, options);
+    const ReadOptions& options,
+    Env* env) {
+  return new TwoLevelIterator(index_iter, block_function, arg, options, env);
 }
 
 }  // namespace leveldb
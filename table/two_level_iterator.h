@@ -9,6 +9,7 @@
 
 namespace leveldb {
 
+class Env;
 struct ReadOptions;
 
 // Return a new two level iterator.  A two-level iterator contains an
@@ -24,6 +25,12 @@ struct ReadOptions;
 // 的值存储的是block中的键值对。
 // 简单说，两层级迭代器，内部既有index迭代器，又有data block迭代器，因为sstable中有index和data block的
 // 另外传入的block_function可以将index迭代器的值转换为对应block的值
+//
+// If options.async_prefetch is set, "env" must be non-NULL: whenever
+// the iterator moves forward into a new block, it asks env->ScheduleIO()
+// to call block_function for the following block, and positions the
+// result at its first entry, in the background.  block_function is
+// never invoked concurrently for the same iterator.
 extern Iterator* NewTwoLevelIterator(
     Iterator* index_iter,
     Iterator* (*block_function)(
@@ -31,7 +38,8 @@ extern Iterator* NewTwoLevelIterator(
         const ReadOptions& options,
         const Slice& index_value),
     void* arg,
-    const ReadOptions& options);
+    const ReadOptions& options,
+    Env* env);
 
 }  // namespace leveldb
 
@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "leveldb/cache.h"
 #include "port/port.h"
@@ -16,10 +17,44 @@ namespace leveldb {
 Cache::~Cache() {
 }
 
+Cache::Handle* Cache::Insert(const Slice& key, void* value, size_t charge,
+                             void (*deleter)(const Slice& key, void* value),
+                             Priority priority) {
+  return Insert(key, value, charge, deleter);
+}
+
+void Cache::GetStats(std::string* stats) {
+}
+
+void Cache::Walk(void (*visit)(void* arg, const Slice& key, void* value),
+                 void* arg) {
+}
+
 namespace {
 
 // LRU cache implementation
 
+// Each shard keeps its entries in one of several circular doubly linked
+// lists ordered by access time:
+//   kProbation: low priority entries that have not been reused since
+//               they were inserted.  This is the only list used by a
+//               plain LRU cache.
+//   kProtected: low priority entries that were looked up at least once
+//               after insertion.
+//   kHighPri:   entries inserted with Cache::kHighPriority.
+enum Pool {
+  kProbation,
+  kProtected,
+  kHighPri,
+  kNumPools
+};
+
+static const char* kPoolNames[kNumPools] = { "probation", "protected", "high" };
+
+// Fraction of the low priority capacity a segmented cache lets the
+// protected segment grow to before demoting its oldest entries.
+static const double kProtectedRatio = 0.8;
+
 // An entry is a variable length heap-allocated structure.  Entries
 // are kept in a circular doubly linked list ordered by access time.
 struct LRUHandle {
@@ -32,6 +67,7 @@ struct LRUHandle {
   size_t key_length;
   uint32_t refs;
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
+  Pool pool;          // List that holds the entry while it is in the cache
   char key_data[1];   // Beginning of key
 
   Slice key() const {
@@ -138,54 +174,101 @@ class LRUCache {
   LRUCache();
   ~LRUCache();
 
-  // Separate from constructor so caller can easily make an array of LRUCache
-  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+  // Separate from constructor so caller can easily make an array of
+  // LRUCache.  If "segmented" is false the shard is a plain LRU cache and
+  // only high priority entries get special treatment.
+  void SetCapacity(size_t capacity, double high_pri_pool_ratio,
+                   bool segmented);
 
   // Like Cache methods, but with an extra "hash" parameter.
   Cache::Handle* Insert(const Slice& key, uint32_t hash,
                         void* value, size_t charge,
-                        void (*deleter)(const Slice& key, void* value));
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Priority priority);
   Cache::Handle* Lookup(const Slice& key, uint32_t hash);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
 
+  // Counters reported by GetStats().  All of them are cumulative
+  // except for the usage figures.
+  struct Stats {
+    size_t usage;
+    size_t pool_usage[kNumPools];
+    uint64_t hits[kNumPools];
+    uint64_t misses;
+    uint64_t inserts[kNumPools];
+    uint64_t evictions[kNumPools];
+  };
+  void GetStats(Stats* stats);
+  void Walk(void (*visit)(void*, const Slice&, void*), void* arg);
+
  private:
   void LRU_Remove(LRUHandle* e);
-  void LRU_Append(LRUHandle* e);
+  void LRU_Append(LRUHandle* e, Pool pool);
   void Unref(LRUHandle* e);
+  void MaintainPoolSizes();
 
   // Initialized before use.
   size_t capacity_;
+  size_t pool_capacity_[kNumPools];
 
   // mutex_ protects the following state.
   port::Mutex mutex_;
   size_t usage_;
   uint64_t last_id_;
 
-  // Dummy head of LRU list.
-  // lru.prev is newest entry, lru.next is oldest entry.
-  LRUHandle lru_;
+  // Dummy heads of the LRU lists.
+  // lru_[p].prev is the newest entry of pool p, lru_[p].next the oldest.
+  LRUHandle lru_[kNumPools];
+  size_t pool_usage_[kNumPools];
+
+  uint64_t hits_[kNumPools];
+  uint64_t misses_;
+  uint64_t inserts_[kNumPools];
+  uint64_t evictions_[kNumPools];
 
   HandleTable table_;
 };
 
 LRUCache::LRUCache()
-    : usage_(0),
-      last_id_(0) {
-  // Make empty circular linked list
-  lru_.next = &lru_;
-  lru_.prev = &lru_;
+    : capacity_(0),
+      usage_(0),
+      last_id_(0),
+      misses_(0) {
+  for (int p = 0; p < kNumPools; p++) {
+    // Make empty circular linked list
+    lru_[p].next = &lru_[p];
+    lru_[p].prev = &lru_[p];
+    pool_capacity_[p] = 0;
+    pool_usage_[p] = 0;
+    hits_[p] = 0;
+    inserts_[p] = 0;
+    evictions_[p] = 0;
+  }
 }
 
 LRUCache::~LRUCache() {
-  for (LRUHandle* e = lru_.next; e != &lru_; ) {
-    LRUHandle* next = e->next;
-    assert(e->refs == 1);  // Error if caller has an unreleased handle
-    Unref(e);
-    e = next;
+  for (int p = 0; p < kNumPools; p++) {
+    for (LRUHandle* e = lru_[p].next; e != &lru_[p]; ) {
+      LRUHandle* next = e->next;
+      assert(e->refs == 1);  // Error if caller has an unreleased handle
+      Unref(e);
+      e = next;
+    }
   }
 }
 
+void LRUCache::SetCapacity(size_t capacity, double high_pri_pool_ratio,
+                           bool segmented) {
+  capacity_ = capacity;
+  pool_capacity_[kHighPri] =
+      static_cast<size_t>(capacity * high_pri_pool_ratio);
+  const size_t low_capacity = capacity - pool_capacity_[kHighPri];
+  pool_capacity_[kProtected] =
+      segmented ? static_cast<size_t>(low_capacity * kProtectedRatio) : 0;
+  pool_capacity_[kProbation] = low_capacity - pool_capacity_[kProtected];
+}
+
 void LRUCache::Unref(LRUHandle* e) {
   assert(e->refs > 0);
   e->refs--;
@@ -199,14 +282,36 @@ void LRUCache::Unref(LRUHandle* e) {
 void LRUCache::LRU_Remove(LRUHandle* e) {
   e->next->prev = e->prev;
   e->prev->next = e->next;
+  pool_usage_[e->pool] -= e->charge;
 }
 
-void LRUCache::LRU_Append(LRUHandle* e) {
-  // Make "e" newest entry by inserting just before lru_
-  e->next = &lru_;
-  e->prev = lru_.prev;
+void LRUCache::LRU_Append(LRUHandle* e, Pool pool) {
+  // Make "e" newest entry of "pool" by inserting just before lru_[pool]
+  LRUHandle* list = &lru_[pool];
+  e->next = list;
+  e->prev = list->prev;
   e->prev->next = e;
   e->next->prev = e;
+  e->pool = pool;
+  pool_usage_[pool] += e->charge;
+}
+
+// Demote the oldest entries of pools that outgrew their share: high
+// priority entries become ordinary reused entries, and protected
+// entries go back on probation.
+void LRUCache::MaintainPoolSizes() {
+  const Pool demoted_high_pri =
+      (pool_capacity_[kProtected] > 0) ? kProtected : kProbation;
+  while (pool_usage_[kHighPri] > pool_capacity_[kHighPri]) {
+    LRUHandle* e = lru_[kHighPri].next;
+    LRU_Remove(e);
+    LRU_Append(e, demoted_high_pri);
+  }
+  while (pool_usage_[kProtected] > pool_capacity_[kProtected]) {
+    LRUHandle* e = lru_[kProtected].next;
+    LRU_Remove(e);
+    LRU_Append(e, kProbation);
+  }
 }
 
 Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
@@ -214,8 +319,16 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
   LRUHandle* e = table_.Lookup(key, hash);
   if (e != NULL) {
     e->refs++;
+    hits_[e->pool]++;
+    Pool pool = e->pool;
+    if (pool == kProbation && pool_capacity_[kProtected] > 0) {
+      pool = kProtected;
+    }
     LRU_Remove(e);
-    LRU_Append(e);
+    LRU_Append(e, pool);
+    MaintainPoolSizes();
+  } else {
+    misses_++;
   }
   return reinterpret_cast<Cache::Handle*>(e);
 }
@@ -227,7 +340,8 @@ void LRUCache::Release(Cache::Handle* handle) {
 
 Cache::Handle* LRUCache::Insert(
     const Slice& key, uint32_t hash, void* value, size_t charge,
-    void (*deleter)(const Slice& key, void* value)) {
+    void (*deleter)(const Slice& key, void* value),
+    Cache::Priority priority) {
   MutexLock l(&mutex_);
 
   LRUHandle* e = reinterpret_cast<LRUHandle*>(
@@ -239,7 +353,10 @@ Cache::Handle* LRUCache::Insert(
   e->hash = hash;
   e->refs = 2;  // One from LRUCache, one for the returned handle
   memcpy(e->key_data, key.data(), key.size());
-  LRU_Append(e);
+  const Pool pool = (priority == Cache::kHighPriority &&
+                     pool_capacity_[kHighPri] > 0) ? kHighPri : kProbation;
+  LRU_Append(e, pool);
+  inserts_[pool]++;
   usage_ += charge;
 
   LRUHandle* old = table_.Insert(e);
@@ -247,11 +364,22 @@ Cache::Handle* LRUCache::Insert(
     LRU_Remove(old);
     Unref(old);
   }
-
-  while (usage_ > capacity_ && lru_.next != &lru_) {
-    LRUHandle* old = lru_.next;
+  MaintainPoolSizes();
+
+  // Evict from the probationary segment first, so that entries which
+  // were only used once go before any that were reused.
+  while (usage_ > capacity_) {
+    int p = kProbation;
+    while (p < kNumPools && lru_[p].next == &lru_[p]) {
+      p++;
+    }
+    if (p == kNumPools) {
+      break;
+    }
+    LRUHandle* old = lru_[p].next;
     LRU_Remove(old);
     table_.Remove(old->key(), old->hash);
+    evictions_[p]++;
     Unref(old);
   }
 
@@ -267,6 +395,28 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
   }
 }
 
+void LRUCache::GetStats(Stats* stats) {
+  MutexLock l(&mutex_);
+  stats->usage = usage_;
+  stats->misses = misses_;
+  for (int p = 0; p < kNumPools; p++) {
+    stats->pool_usage[p] = pool_usage_[p];
+    stats->hits[p] = hits_[p];
+    stats->inserts[p] = inserts_[p];
+    stats->evictions[p] = evictions_[p];
+  }
+}
+
+// Pools are visited in the order in which Insert() evicts from them.
+void LRUCache::Walk(void (*visit)(void*, const Slice&, void*), void* arg) {
+  MutexLock l(&mutex_);
+  for (int p = 0; p < kNumPools; p++) {
+    for (LRUHandle* e = lru_[p].next; e != &lru_[p]; e = e->next) {
+      (*visit)(arg, e->key(), e->value);
+    }
+  }
+}
+
 static const int kNumShardBits = 4;
 static const int kNumShards = 1 << kNumShardBits;
 
@@ -284,19 +434,46 @@ class ShardedLRUCache : public Cache {
     return hash >> (32 - kNumShardBits);
   }
 
+  static void AppendStatsLine(std::string* stats, const char* name,
+                              const LRUCache::Stats& s) {
+    char buf[300];
+    uint64_t hits = 0, inserts = 0, evictions = 0;
+    for (int p = 0; p < kNumPools; p++) {
+      hits += s.hits[p];
+      inserts += s.inserts[p];
+      evictions += s.evictions[p];
+    }
+    snprintf(buf, sizeof(buf),
+             "%5s %10llu %10llu %10llu %10llu %10llu\n",
+             name,
+             static_cast<unsigned long long>(s.usage),
+             static_cast<unsigned long long>(hits),
+             static_cast<unsigned long long>(s.misses),
+             static_cast<unsigned long long>(inserts),
+             static_cast<unsigned long long>(evictions));
+    stats->append(buf);
+  }
+
  public:
-  explicit ShardedLRUCache(size_t capacity)
+  ShardedLRUCache(size_t capacity, double high_pri_pool_ratio,
+                  bool segmented)
       : last_id_(0) {
     const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
     for (int s = 0; s < kNumShards; s++) {
-      shard_[s].SetCapacity(per_shard);
+      shard_[s].SetCapacity(per_shard, high_pri_pool_ratio, segmented);
     }
   }
   virtual ~ShardedLRUCache() { }
   virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                          void (*deleter)(const Slice& key, void* value)) {
+    return Insert(key, value, charge, deleter, kLowPriority);
+  }
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value),
+                         Priority priority) {
     const uint32_t hash = HashSlice(key);
-    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+                                      priority);
   }
   virtual Handle* Lookup(const Slice& key) {
     const uint32_t hash = HashSlice(key);
@@ -317,12 +494,63 @@ class ShardedLRUCache : public Cache {
     MutexLock l(&id_mutex_);
     return ++(last_id_);
   }
+
+  virtual void GetStats(std::string* stats) {
+    LRUCache::Stats total;
+    memset(&total, 0, sizeof(total));
+    std::string shards;
+    for (int s = 0; s < kNumShards; s++) {
+      LRUCache::Stats shard;
+      shard_[s].GetStats(&shard);
+      char name[10];
+      snprintf(name, sizeof(name), "%d", s);
+      AppendStatsLine(&shards, name, shard);
+      total.usage += shard.usage;
+      total.misses += shard.misses;
+      for (int p = 0; p < kNumPools; p++) {
+        total.pool_usage[p] += shard.pool_usage[p];
+        total.hits[p] += shard.hits[p];
+        total.inserts[p] += shard.inserts[p];
+        total.evictions[p] += shard.evictions[p];
+      }
+    }
+
+    char buf[200];
+    stats->append("                          Pools\n"
+                  " Pool      Usage       Hits    Inserts  Evictions\n"
+                  "------------------------------------------------\n");
+    for (int p = 0; p < kNumPools; p++) {
+      snprintf(buf, sizeof(buf), "%-9s %10llu %10llu %10llu %10llu\n",
+               kPoolNames[p],
+               static_cast<unsigned long long>(total.pool_usage[p]),
+               static_cast<unsigned long long>(total.hits[p]),
+               static_cast<unsigned long long>(total.inserts[p]),
+               static_cast<unsigned long long>(total.evictions[p]));
+      stats->append(buf);
+    }
+    stats->append("                          Shards\n"
+                  "Shard      Usage       Hits     Misses    Inserts  Evictions\n"
+                  "-----------------------------------------------------------\n");
+    stats->append(shards);
+    AppendStatsLine(stats, "total", total);
+  }
+
+  virtual void Walk(void (*visit)(void* arg, const Slice& key, void* value),
+                    void* arg) {
+    for (int s = 0; s < kNumShards; s++) {
+      shard_[s].Walk(visit, arg);
+    }
+  }
 };
 
 }  // end anonymous namespace
 
 Cache* NewLRUCache(size_t capacity) {
-  return new ShardedLRUCache(capacity);
+  return new ShardedLRUCache(capacity, 0.0, false);
+}
+
+Cache* NewSegmentedLRUCache(size_t capacity, double high_pri_pool_ratio) {
+  return new ShardedLRUCache(capacity, high_pri_pool_ratio, true);
 }
 
 }  // namespace leveldb
@@ -4,8 +4,13 @@
 
 #include "leveldb/cache.h"
 
+#include <algorithm>
 #include <vector>
+#include "leveldb/env.h"
+#include "port/port.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
+#include "util/random.h"
 #include "util/testharness.h"
 
 namespace leveldb {
@@ -23,6 +28,12 @@ static int DecodeKey(const Slice& k) {
 static void* EncodeValue(uintptr_t v) { return reinterpret_cast<void*>(v); }
 static int DecodeValue(void* v) { return reinterpret_cast<uintptr_t>(v); }
 
+static void CollectEntry(void* arg, const Slice& key, void* value) {
+  std::vector<std::pair<int, int> >* entries =
+      reinterpret_cast<std::vector<std::pair<int, int> >*>(arg);
+  entries->push_back(std::make_pair(DecodeKey(key), DecodeValue(value)));
+}
+
 class CacheTest {
  public:
   static CacheTest* current_;
@@ -59,9 +70,44 @@ class CacheTest {
                                    &CacheTest::Deleter));
   }
 
+  void InsertHighPriority(int key, int value, int charge = 1) {
+    cache_->Release(cache_->Insert(EncodeKey(key), EncodeValue(value), charge,
+                                   &CacheTest::Deleter,
+                                   Cache::kHighPriority));
+  }
+
   void Erase(int key) {
     cache_->Erase(EncodeKey(key));
   }
+
+  // Return the entries visited by Cache::Walk() as "key:value" pairs,
+  // sorted by key.
+  std::string WalkEntries() {
+    std::vector<std::pair<int, int> > entries;
+    cache_->Walk(&CollectEntry, &entries);
+    std::sort(entries.begin(), entries.end());
+    std::string result;
+    for (size_t i = 0; i < entries.size(); i++) {
+      char buf[50];
+      snprintf(buf, sizeof(buf), "%s%d:%d", (i == 0 ? "" : " "),
+               entries[i].first, entries[i].second);
+      result += buf;
+    }
+    return result;
+  }
+
+  void UseSegmentedCache(double high_pri_pool_ratio) {
+    delete cache_;
+    cache_ = NewSegmentedLRUCache(kCacheSize, high_pri_pool_ratio);
+  }
+
+  // Insert a run of "n" entries that are never looked up again, the
+  // way a scan fills the block cache.
+  void Scan(int first, int n) {
+    for (int i = first; i < first + n; i++) {
+      Insert(i, i);
+    }
+  }
 };
 CacheTest* CacheTest::current_;
 
@@ -173,12 +219,334 @@ TEST(CacheTest, HeavyEntries) {
   ASSERT_LE(cached_weight, kCacheSize + kCacheSize/10);
 }
 
+TEST(CacheTest, ScanResistance) {
+  // A plain LRU cache loses its reused entries to a scan.
+  for (int i = 0; i < 10; i++) {
+    Insert(i, 100+i);
+    ASSERT_EQ(100+i, Lookup(i));
+  }
+  Scan(1000, 10 * kCacheSize);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(-1, Lookup(i));
+  }
+
+  // A segmented cache keeps them.
+  UseSegmentedCache(0.0);
+  for (int i = 0; i < 10; i++) {
+    Insert(i, 100+i);
+    ASSERT_EQ(100+i, Lookup(i));
+  }
+  Scan(1000, 10 * kCacheSize);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(100+i, Lookup(i));
+  }
+
+  // Entries that are reused while the scan runs are kept too.
+  Scan(20000, kCacheSize / 2);
+  for (int i = 0; i < 10; i++) {
+    Insert(i + 50, 150+i);
+    ASSERT_EQ(150+i, Lookup(i + 50));
+  }
+  Scan(30000, 10 * kCacheSize);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(100+i, Lookup(i));
+    ASSERT_EQ(150+i, Lookup(i + 50));
+  }
+}
+
+TEST(CacheTest, HighPriorityPool) {
+  UseSegmentedCache(0.5);
+  for (int i = 0; i < 10; i++) {
+    InsertHighPriority(i, 100+i);
+  }
+
+  // Reused low priority entries do not displace high priority ones.
+  for (int i = 1000; i < 1000 + 10 * kCacheSize; i++) {
+    Insert(i, i);
+    ASSERT_EQ(i, Lookup(i));
+  }
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(100+i, Lookup(i));
+  }
+
+  // High priority entries beyond the pool's share compete with the
+  // rest of the cache.
+  for (int i = 0; i < 10 * kCacheSize; i++) {
+    InsertHighPriority(i, 100+i);
+  }
+  int cached = 0;
+  for (int i = 0; i < 10 * kCacheSize; i++) {
+    if (Lookup(i) >= 0) {
+      cached++;
+    }
+  }
+  ASSERT_LE(cached, kCacheSize + kCacheSize/10);
+}
+
+TEST(CacheTest, Stats) {
+  UseSegmentedCache(0.0);
+  ASSERT_EQ(-1, Lookup(100));
+  Insert(100, 101, 7);
+  ASSERT_EQ(101, Lookup(100));
+
+  std::string stats;
+  cache_->GetStats(&stats);
+  // Usage, hits, misses, inserts and evictions summed over the shards.
+  ASSERT_NE(std::string::npos,
+            stats.find("total          7          1          1          1"
+                       "          0\n"));
+  ASSERT_NE(std::string::npos, stats.find("protected          7"));
+}
+
+TEST(CacheTest, Walk) {
+  ASSERT_EQ("", WalkEntries());
+  Insert(100, 101);
+  Insert(200, 201);
+  Insert(300, 301);
+  Erase(200);
+  ASSERT_EQ("100:101 300:301", WalkEntries());
+
+  // Entries in every pool are visited.
+  UseSegmentedCache(0.5);
+  Insert(100, 101);
+  InsertHighPriority(200, 201);
+  Insert(300, 301);
+  ASSERT_EQ(301, Lookup(300));
+  ASSERT_EQ("100:101 200:201 300:301", WalkEntries());
+}
+
 TEST(CacheTest, NewId) {
   uint64_t a = cache_->NewId();
   uint64_t b = cache_->NewId();
   ASSERT_NE(a, b);
 }
 
+// Runs the CacheTest helpers against a clock cache.  Entries in these
+// tests have a charge of 1, so size the table for that.
+class ClockCacheTest : public CacheTest {
+ public:
+  ClockCacheTest() {
+    delete cache_;
+    cache_ = NewClockCache(kCacheSize, 1);
+  }
+};
+
+TEST(ClockCacheTest, ClockHitAndMiss) {
+  ASSERT_EQ(-1, Lookup(100));
+
+  Insert(100, 101);
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1,  Lookup(200));
+
+  Insert(200, 201);
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+
+  Insert(100, 102);
+  ASSERT_EQ(102, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(100, deleted_keys_[0]);
+  ASSERT_EQ(101, deleted_values_[0]);
+}
+
+TEST(ClockCacheTest, ClockErase) {
+  Erase(200);
+  ASSERT_EQ(0, deleted_keys_.size());
+
+  Insert(100, 101);
+  Insert(200, 201);
+  Erase(100);
+  ASSERT_EQ(-1,  Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(100, deleted_keys_[0]);
+  ASSERT_EQ(101, deleted_values_[0]);
+
+  Erase(100);
+  ASSERT_EQ(1, deleted_keys_.size());
+}
+
+TEST(ClockCacheTest, ClockEntriesArePinned) {
+  Insert(100, 101);
+  Cache::Handle* h1 = cache_->Lookup(EncodeKey(100));
+  ASSERT_EQ(101, DecodeValue(cache_->Value(h1)));
+
+  Insert(100, 102);
+  Cache::Handle* h2 = cache_->Lookup(EncodeKey(100));
+  ASSERT_EQ(102, DecodeValue(cache_->Value(h2)));
+  ASSERT_EQ(0, deleted_keys_.size());
+
+  cache_->Release(h1);
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(100, deleted_keys_[0]);
+  ASSERT_EQ(101, deleted_values_[0]);
+
+  Erase(100);
+  ASSERT_EQ(-1, Lookup(100));
+  ASSERT_EQ(1, deleted_keys_.size());
+
+  cache_->Release(h2);
+  ASSERT_EQ(2, deleted_keys_.size());
+  ASSERT_EQ(100, deleted_keys_[1]);
+  ASSERT_EQ(102, deleted_values_[1]);
+}
+
+TEST(ClockCacheTest, ClockWalk) {
+  ASSERT_EQ("", WalkEntries());
+  Insert(100, 101);
+  Insert(200, 201);
+  Insert(300, 301);
+  ASSERT_EQ(101, Lookup(100));
+  Erase(200);
+  ASSERT_EQ("100:101 300:301", WalkEntries());
+}
+
+TEST(ClockCacheTest, ClockEvictionPolicy) {
+  Insert(100, 101);
+  Insert(200, 201);
+
+  // Frequently used entry must be kept around
+  for (int i = 0; i < kCacheSize + 100; i++) {
+    Insert(1000+i, 2000+i);
+    ASSERT_EQ(2000+i, Lookup(1000+i));
+    ASSERT_EQ(101, Lookup(100));
+  }
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1, Lookup(200));
+}
+
+TEST(ClockCacheTest, ClockHeavyEntries) {
+  const int kLight = 1;
+  const int kHeavy = 10;
+  int added = 0;
+  int index = 0;
+  while (added < 2*kCacheSize) {
+    const int weight = (index & 1) ? kLight : kHeavy;
+    Insert(index, 1000+index, weight);
+    added += weight;
+    index++;
+  }
+
+  int cached_weight = 0;
+  for (int i = 0; i < index; i++) {
+    const int weight = (i & 1 ? kLight : kHeavy);
+    int r = Lookup(i);
+    if (r >= 0) {
+      cached_weight += weight;
+      ASSERT_EQ(1000+i, r);
+    }
+  }
+  ASSERT_LE(cached_weight, kCacheSize + kCacheSize/10);
+}
+
+TEST(ClockCacheTest, ClockPinnedEntriesOverflowTable) {
+  // Entries that cannot be evicted because they are in use are handed
+  // out even when the table has no room left for them.
+  std::vector<Cache::Handle*> handles;
+  for (int i = 0; i < 4 * kCacheSize; i++) {
+    handles.push_back(cache_->Insert(EncodeKey(i), EncodeValue(i), 1,
+                                     &CacheTest::Deleter));
+  }
+  for (int i = 0; i < handles.size(); i++) {
+    ASSERT_EQ(i, DecodeValue(cache_->Value(handles[i])));
+  }
+  ASSERT_EQ(0, deleted_keys_.size());
+  for (int i = 0; i < handles.size(); i++) {
+    cache_->Release(handles[i]);
+  }
+
+  // Once released, the entries are evicted as usual.
+  for (int i = 0; i < kCacheSize; i++) {
+    Insert(10000+i, i);
+  }
+  int cached = 0;
+  for (int i = 0; i < handles.size(); i++) {
+    if (Lookup(i) >= 0) {
+      cached++;
+    }
+  }
+  ASSERT_LE(cached, kCacheSize/10);
+  ASSERT_GE(deleted_keys_.size(), handles.size() - cached);
+}
+
+namespace {
+
+struct ConcurrentState {
+  Cache* cache;
+  port::Mutex mu;
+  int inserted;
+  int deleted;
+  int done;
+  ConcurrentState() : inserted(0), deleted(0), done(0) { }
+};
+
+static ConcurrentState* concurrent_state;
+
+static void CountingDeleter(const Slice& key, void* v) {
+  // Values are always derived from their key.
+  ASSERT_EQ(DecodeKey(key) * 3, DecodeValue(v));
+  MutexLock l(&concurrent_state->mu);
+  concurrent_state->deleted++;
+}
+
+static void ConcurrentThread(void* arg) {
+  ConcurrentState* state = reinterpret_cast<ConcurrentState*>(arg);
+  Random rnd(reinterpret_cast<uintptr_t>(&rnd));
+  int inserted = 0;
+  for (int i = 0; i < 100000; i++) {
+    const int k = rnd.Uniform(2000);
+    const std::string key = EncodeKey(k);
+    switch (rnd.Uniform(10)) {
+      case 0:
+        state->cache->Release(state->cache->Insert(
+            key, EncodeValue(k * 3), 1, &CountingDeleter));
+        inserted++;
+        break;
+      case 1:
+        state->cache->Erase(key);
+        break;
+      default: {
+        Cache::Handle* h = state->cache->Lookup(key);
+        if (h != NULL) {
+          ASSERT_EQ(k * 3, DecodeValue(state->cache->Value(h)));
+          state->cache->Release(h);
+        }
+        break;
+      }
+    }
+  }
+  MutexLock l(&state->mu);
+  state->inserted += inserted;
+  state->done++;
+}
+
+}  // namespace
+
+TEST(ClockCacheTest, ClockConcurrent) {
+  const int kThreads = 8;
+  ConcurrentState state;
+  state.cache = NewClockCache(kCacheSize, 1);
+  concurrent_state = &state;
+  for (int i = 0; i < kThreads; i++) {
+    Env::Default()->StartThread(&ConcurrentThread, &state);
+  }
+  while (true) {
+    {
+      MutexLock l(&state.mu);
+      if (state.done == kThreads) {
+        break;
+      }
+    }
+    Env::Default()->SleepForMicroseconds(10000);
+  }
+  // Every entry is deleted exactly once.
+  delete state.cache;
+  ASSERT_EQ(state.inserted, state.deleted);
+  concurrent_state = NULL;
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
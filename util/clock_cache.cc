@@ -0,0 +1,435 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A Cache that uses the CLOCK eviction policy and lets Lookup() and
+// Release() run without taking any lock.
+//
+// Each shard stores its entries in an open-addressing hash table with
+// linear probing.  Every slot has an atomic "meta" word that holds the
+// slot's state, the number of outstanding handles to its entry and a
+// usage bit that Lookup() sets.  A reader takes a handle by atomically
+// incrementing the reference count while the slot is visible, and an
+// entry is only freed by whoever moves an unreferenced slot out of the
+// visible or invisible state, so a reader never sees an entry being
+// torn down under it.  Insert(), Erase() and eviction are serialized
+// by a per-shard mutex; eviction sweeps a clock hand over the slots,
+// clearing usage bits and removing unreferenced entries whose usage
+// bit is already clear.
+//
+// Each slot also counts the entries whose probe sequence passed over
+// it ("displacements"), so that a lookup can stop at the first slot
+// that is not part of any longer probe sequence.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "leveldb/cache.h"
+#include "port/port.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+namespace {
+
+// Layout of ClockHandle::meta.
+static const uint64_t kRefsMask = (1ull << 30) - 1;
+static const uint64_t kUsageBit = 1ull << 30;
+static const int kStateShift = 32;
+static const uint64_t kStateMask = 3ull << kStateShift;
+// The slot is free.  Only the shard's mutex holder may fill it.
+static const uint64_t kStateEmpty = 0;
+// The slot is owned by a single thread that is filling or freeing it.
+static const uint64_t kStateConstruction = 1ull << kStateShift;
+// The slot holds an entry that Lookup() can find.
+static const uint64_t kStateVisible = 2ull << kStateShift;
+// The slot holds an entry that was erased or replaced but is still
+// referenced by outstanding handles.
+static const uint64_t kStateInvisible = 3ull << kStateShift;
+
+// Fraction of the slots a shard fills before it evicts entries to make
+// room, even if the capacity has not been reached.
+static const double kMaxLoadFactor = 0.9;
+
+// Fraction of the slots the entries are expected to fill at capacity.
+static const double kTargetLoadFactor = 0.7;
+
+struct ClockHandle {
+  // Written by the thread that fills the slot before it becomes visible.
+  void* value;
+  void (*deleter)(const Slice&, void* value);
+  char* key_data;
+  size_t key_length;
+  size_t charge;
+  uint32_t hash;            // Also read atomically before taking a handle
+  bool detached;            // True iff the entry is not in the table
+
+  uint64_t meta;            // Accessed atomically
+  uint32_t displacements;   // Accessed atomically
+
+  Slice key() const { return Slice(key_data, key_length); }
+};
+
+// A single shard of sharded cache.
+class ClockCache {
+ public:
+  ClockCache();
+  ~ClockCache();
+
+  // Separate from constructor so caller can easily make an array of
+  // ClockCache.
+  void SetCapacity(size_t capacity, size_t estimated_entry_charge);
+
+  // Like Cache methods, but with an extra "hash" parameter.
+  Cache::Handle* Insert(const Slice& key, uint32_t hash,
+                        void* value, size_t charge,
+                        void (*deleter)(const Slice& key, void* value));
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash);
+  void Release(Cache::Handle* handle);
+  void Erase(const Slice& key, uint32_t hash);
+  void Walk(void (*visit)(void*, const Slice&, void*), void* arg);
+
+ private:
+  void FreeEntry(ClockHandle* h);
+  void RemoveFromTable(ClockHandle* h);
+  void MakeInvisible(ClockHandle* h);
+  void EvictFor(size_t charge);
+  ClockHandle* FindVisible(const Slice& key, uint32_t hash);
+  ClockHandle* FindEmptySlot(uint32_t hash);
+
+  bool NeedsEviction(size_t charge) const {
+    return (__atomic_load_n(&usage_, __ATOMIC_RELAXED) + charge > capacity_ ||
+            __atomic_load_n(&occupancy_, __ATOMIC_RELAXED) >= max_occupancy_);
+  }
+
+  // Initialized before use.
+  size_t capacity_;
+  uint32_t length_;
+  uint32_t mask_;
+  uint32_t max_occupancy_;
+  ClockHandle* slots_;
+
+  // Updated atomically.
+  size_t usage_;
+  uint32_t occupancy_;   // Number of slots that are not empty
+
+  // mutex_ serializes Insert(), Erase() and eviction.
+  port::Mutex mutex_;
+  uint32_t clock_hand_;
+};
+
+ClockCache::ClockCache()
+    : capacity_(0),
+      length_(0),
+      mask_(0),
+      max_occupancy_(0),
+      slots_(NULL),
+      usage_(0),
+      occupancy_(0),
+      clock_hand_(0) {
+}
+
+ClockCache::~ClockCache() {
+  for (uint32_t i = 0; i < length_; i++) {
+    ClockHandle* h = &slots_[i];
+    const uint64_t state = h->meta & kStateMask;
+    if (state == kStateVisible || state == kStateInvisible) {
+      // Error if caller has an unreleased handle
+      assert((h->meta & kRefsMask) == 0);
+      FreeEntry(h);
+    }
+  }
+  delete[] slots_;
+}
+
+void ClockCache::SetCapacity(size_t capacity, size_t estimated_entry_charge) {
+  capacity_ = capacity;
+  if (estimated_entry_charge == 0) {
+    estimated_entry_charge = 1;
+  }
+  const double wanted =
+      (capacity / estimated_entry_charge) / kTargetLoadFactor + 1;
+  length_ = 16;
+  while (length_ < wanted && length_ < (1u << 30)) {
+    length_ *= 2;
+  }
+  mask_ = length_ - 1;
+  max_occupancy_ = static_cast<uint32_t>(length_ * kMaxLoadFactor);
+  slots_ = new ClockHandle[length_];
+  memset(slots_, 0, sizeof(slots_[0]) * length_);
+}
+
+void ClockCache::FreeEntry(ClockHandle* h) {
+  (*h->deleter)(h->key(), h->value);
+  free(h->key_data);
+  __atomic_fetch_sub(&usage_, h->charge, __ATOMIC_RELAXED);
+}
+
+// REQUIRES: the caller moved the slot to kStateConstruction.
+void ClockCache::RemoveFromTable(ClockHandle* h) {
+  FreeEntry(h);
+  const uint32_t slot = static_cast<uint32_t>(h - slots_);
+  for (uint32_t i = h->hash & mask_; i != slot; i = (i + 1) & mask_) {
+    __atomic_fetch_sub(&slots_[i].displacements, 1, __ATOMIC_RELAXED);
+  }
+  __atomic_fetch_sub(&occupancy_, 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->meta, kStateEmpty, __ATOMIC_RELEASE);
+}
+
+// REQUIRES: mutex_ held and h is visible.
+void ClockCache::MakeInvisible(ClockHandle* h) {
+  // Only the reference count and usage bit can change under us.
+  uint64_t meta = __atomic_load_n(&h->meta, __ATOMIC_ACQUIRE);
+  uint64_t invisible;
+  do {
+    invisible = (meta & ~kStateMask) | kStateInvisible;
+  } while (!__atomic_compare_exchange_n(&h->meta, &meta, invisible, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+  // If handles are outstanding, the last Release() frees the entry.
+  if ((invisible & kRefsMask) == 0 &&
+      __atomic_compare_exchange_n(&h->meta, &invisible, kStateConstruction,
+                                  false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    RemoveFromTable(h);
+  }
+}
+
+// Sweep the clock hand until "charge" more bytes fit, or until every
+// entry has been passed twice (the remaining entries are all in use).
+// REQUIRES: mutex_ held.
+void ClockCache::EvictFor(size_t charge) {
+  for (uint32_t step = 0; step < 2 * length_ && NeedsEviction(charge);
+       step++) {
+    ClockHandle* h = &slots_[clock_hand_];
+    clock_hand_ = (clock_hand_ + 1) & mask_;
+    uint64_t meta = __atomic_load_n(&h->meta, __ATOMIC_ACQUIRE);
+    if ((meta & kStateMask) != kStateVisible) {
+      continue;
+    }
+    if (meta & kUsageBit) {
+      // Give recently used entries another round.
+      __atomic_fetch_and(&h->meta, ~kUsageBit, __ATOMIC_RELAXED);
+    } else if ((meta & kRefsMask) == 0 &&
+               __atomic_compare_exchange_n(&h->meta, &meta,
+                                           kStateConstruction, false,
+                                           __ATOMIC_ACQ_REL,
+                                           __ATOMIC_ACQUIRE)) {
+      RemoveFromTable(h);
+    }
+  }
+}
+
+// REQUIRES: mutex_ held.
+ClockHandle* ClockCache::FindVisible(const Slice& key, uint32_t hash) {
+  uint32_t i = hash & mask_;
+  for (uint32_t probes = 0; probes < length_; probes++, i = (i + 1) & mask_) {
+    ClockHandle* h = &slots_[i];
+    const uint64_t meta = __atomic_load_n(&h->meta, __ATOMIC_ACQUIRE);
+    if ((meta & kStateMask) == kStateVisible &&
+        h->hash == hash && h->key() == key) {
+      return h;
+    }
+    if (__atomic_load_n(&h->displacements, __ATOMIC_ACQUIRE) == 0) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+// REQUIRES: mutex_ held.
+ClockHandle* ClockCache::FindEmptySlot(uint32_t hash) {
+  uint32_t i = hash & mask_;
+  for (uint32_t probes = 0; probes < length_; probes++, i = (i + 1) & mask_) {
+    ClockHandle* h = &slots_[i];
+    if (__atomic_load_n(&h->meta, __ATOMIC_ACQUIRE) == kStateEmpty) {
+      return h;
+    }
+  }
+  return NULL;
+}
+
+Cache::Handle* ClockCache::Lookup(const Slice& key, uint32_t hash) {
+  uint32_t i = hash & mask_;
+  for (uint32_t probes = 0; probes < length_; probes++, i = (i + 1) & mask_) {
+    ClockHandle* h = &slots_[i];
+    uint64_t meta = __atomic_load_n(&h->meta, __ATOMIC_ACQUIRE);
+    if ((meta & kStateMask) == kStateVisible &&
+        __atomic_load_n(&h->hash, __ATOMIC_RELAXED) == hash) {
+      // Take a handle while the entry is visible.  Once we hold it the
+      // entry cannot be freed or replaced, so its key can be compared.
+      while ((meta & kStateMask) == kStateVisible &&
+             !__atomic_compare_exchange_n(&h->meta, &meta,
+                                          (meta + 1) | kUsageBit, true,
+                                          __ATOMIC_ACQUIRE,
+                                          __ATOMIC_ACQUIRE)) {
+      }
+      if ((meta & kStateMask) == kStateVisible) {
+        if (h->hash == hash && h->key() == key) {
+          return reinterpret_cast<Cache::Handle*>(h);
+        }
+        Release(reinterpret_cast<Cache::Handle*>(h));
+      }
+    }
+    if (__atomic_load_n(&h->displacements, __ATOMIC_ACQUIRE) == 0) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+void ClockCache::Release(Cache::Handle* handle) {
+  ClockHandle* h = reinterpret_cast<ClockHandle*>(handle);
+  if (h->detached) {
+    FreeEntry(h);
+    delete h;
+    return;
+  }
+  const uint64_t old = __atomic_fetch_sub(&h->meta, 1, __ATOMIC_ACQ_REL);
+  assert((old & kRefsMask) > 0);
+  if ((old & kStateMask) == kStateInvisible && (old & kRefsMask) == 1) {
+    // Last handle to an erased entry.
+    uint64_t expected = old - 1;
+    if (__atomic_compare_exchange_n(&h->meta, &expected, kStateConstruction,
+                                    false, __ATOMIC_ACQ_REL,
+                                    __ATOMIC_ACQUIRE)) {
+      RemoveFromTable(h);
+    }
+  }
+}
+
+Cache::Handle* ClockCache::Insert(
+    const Slice& key, uint32_t hash, void* value, size_t charge,
+    void (*deleter)(const Slice& key, void* value)) {
+  MutexLock l(&mutex_);
+
+  ClockHandle* old = FindVisible(key, hash);
+  if (old != NULL) {
+    MakeInvisible(old);
+  }
+  EvictFor(charge);
+
+  ClockHandle* h = NULL;
+  if (__atomic_load_n(&occupancy_, __ATOMIC_RELAXED) < length_) {
+    h = FindEmptySlot(hash);
+  }
+  if (h == NULL) {
+    // Every slot holds an entry that is in use.  Hand out an entry that
+    // lives outside the table and is freed when it is released.
+    h = new ClockHandle;
+    h->detached = true;
+  } else {
+    h->detached = false;
+    const uint32_t slot = static_cast<uint32_t>(h - slots_);
+    for (uint32_t i = hash & mask_; i != slot; i = (i + 1) & mask_) {
+      __atomic_fetch_add(&slots_[i].displacements, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&occupancy_, 1, __ATOMIC_RELAXED);
+  }
+  h->value = value;
+  h->deleter = deleter;
+  h->charge = charge;
+  h->key_length = key.size();
+  h->key_data = reinterpret_cast<char*>(malloc(key.size() > 0 ? key.size()
+                                                                : 1));
+  memcpy(h->key_data, key.data(), key.size());
+  __atomic_store_n(&h->hash, hash, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&usage_, charge, __ATOMIC_RELAXED);
+  if (!h->detached) {
+    // Publish the entry with one handle for the caller.
+    __atomic_store_n(&h->meta, kStateVisible | 1, __ATOMIC_RELEASE);
+  }
+  return reinterpret_cast<Cache::Handle*>(h);
+}
+
+void ClockCache::Erase(const Slice& key, uint32_t hash) {
+  MutexLock l(&mutex_);
+  ClockHandle* h = FindVisible(key, hash);
+  if (h != NULL) {
+    MakeInvisible(h);
+  }
+}
+
+// Visible entries are only freed with mutex_ held, so they can be read
+// without taking a reference.  Entries that were not used since the
+// clock hand last passed them go first, as EvictFor() would pick them.
+void ClockCache::Walk(void (*visit)(void*, const Slice&, void*), void* arg) {
+  MutexLock l(&mutex_);
+  for (int pass = 0; pass < 2; pass++) {
+    const uint64_t usage = (pass == 0) ? 0 : kUsageBit;
+    for (uint32_t i = 0; i < length_; i++) {
+      ClockHandle* h = &slots_[i];
+      const uint64_t meta = __atomic_load_n(&h->meta, __ATOMIC_ACQUIRE);
+      if ((meta & kStateMask) == kStateVisible &&
+          (meta & kUsageBit) == usage) {
+        (*visit)(arg, h->key(), h->value);
+      }
+    }
+  }
+}
+
+static const int kNumShardBits = 4;
+static const int kNumShards = 1 << kNumShardBits;
+
+class ShardedClockCache : public Cache {
+ private:
+  ClockCache shard_[kNumShards];
+  port::Mutex id_mutex_;
+  uint64_t last_id_;
+
+  static inline uint32_t HashSlice(const Slice& s) {
+    return Hash(s.data(), s.size(), 0);
+  }
+
+  static uint32_t Shard(uint32_t hash) {
+    return hash >> (32 - kNumShardBits);
+  }
+
+ public:
+  ShardedClockCache(size_t capacity, size_t estimated_entry_charge)
+      : last_id_(0) {
+    const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
+    for (int s = 0; s < kNumShards; s++) {
+      shard_[s].SetCapacity(per_shard, estimated_entry_charge);
+    }
+  }
+  virtual ~ShardedClockCache() { }
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value)) {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+  }
+  virtual Handle* Lookup(const Slice& key) {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Lookup(key, hash);
+  }
+  virtual void Release(Handle* handle) {
+    ClockHandle* h = reinterpret_cast<ClockHandle*>(handle);
+    shard_[Shard(h->hash)].Release(handle);
+  }
+  virtual void Erase(const Slice& key) {
+    const uint32_t hash = HashSlice(key);
+    shard_[Shard(hash)].Erase(key, hash);
+  }
+  virtual void* Value(Handle* handle) {
+    return reinterpret_cast<ClockHandle*>(handle)->value;
+  }
+  virtual uint64_t NewId() {
+    MutexLock l(&id_mutex_);
+    return ++(last_id_);
+  }
+  virtual void Walk(void (*visit)(void* arg, const Slice& key, void* value),
+                    void* arg) {
+    for (int s = 0; s < kNumShards; s++) {
+      shard_[s].Walk(visit, arg);
+    }
+  }
+};
+
+}  // end anonymous namespace
+
+Cache* NewClockCache(size_t capacity, size_t estimated_entry_charge) {
+  return new ShardedClockCache(capacity, estimated_entry_charge);
+}
+
+}  // namespace leveldb
@@ -9,6 +9,28 @@ namespace leveldb {
 Env::~Env() {
 }
 
+Status Env::NewDirectRandomAccessFile(const std::string& fname,
+                                      RandomAccessFile** result) {
+  return NewRandomAccessFile(fname, result);
+}
+
+Status Env::NewDirectWritableFile(const std::string& fname,
+                                  WritableFile** result) {
+  return NewWritableFile(fname, result);
+}
+
+void Env::ScheduleIO(void (*function)(void*), void* arg) {
+  (*function)(arg);
+}
+
+void Env::MultiRead(ReadRequest* reqs, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    ReadRequest* req = &reqs[i];
+    req->status = req->file->Read(req->offset, req->n, &req->result,
+                                  req->scratch);
+  }
+}
+
 SequentialFile::~SequentialFile() {
 }
 
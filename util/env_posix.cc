@@ -2,8 +2,10 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
+#include <algorithm>
 #include <deque>
 #include <set>
+#include <vector>
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -20,6 +22,11 @@
 #if defined(LEVELDB_PLATFORM_ANDROID)
 #include <sys/stat.h>
 #endif
+#if defined(LEVELDB_IO_URING_PRESENT)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
 #include "leveldb/env.h"
 #include "leveldb/slice.h"
 #include "port/port.h"
@@ -68,8 +75,39 @@ class PosixSequentialFile: public SequentialFile {
   }
 };
 
+// A pread(2) issued by PosixEnv::MultiRead()
+struct PreadOp {
+  int fd;           // Negative if there is nothing to read
+  uint64_t offset;
+  size_t n;
+  char* buf;
+  ssize_t result;   // Number of bytes read, or -errno
+};
+
+static void DoPread(PreadOp* op) {
+  if (op->fd < 0) {
+    return;
+  }
+  ssize_t r;
+  do {
+    r = pread(op->fd, op->buf, op->n, static_cast<off_t>(op->offset));
+  } while (r < 0 && errno == EINTR);
+  op->result = (r < 0) ? -errno : r;
+}
+
+// A file whose reads PosixEnv::MultiRead() can issue as preads, together
+// with those of other files.
+class PosixPreadableFile: public RandomAccessFile {
+ public:
+  // Set up *op to serve "req"
+  virtual void PrepareRead(const ReadRequest& req, PreadOp* op) const = 0;
+
+  // Set the outcome of *req once *op is done
+  virtual void FinishRead(const PreadOp& op, ReadRequest* req) const = 0;
+};
+
 // pread() based random-access
-class PosixRandomAccessFile: public RandomAccessFile {
+class PosixRandomAccessFile: public PosixPreadableFile {
  private:
   std::string filename_;
   int fd_;
@@ -79,6 +117,24 @@ class PosixRandomAccessFile: public RandomAccessFile {
       : filename_(fname), fd_(fd) { }
   virtual ~PosixRandomAccessFile() { close(fd_); }
 
+  virtual void PrepareRead(const ReadRequest& req, PreadOp* op) const {
+    op->fd = fd_;
+    op->offset = req.offset;
+    op->n = req.n;
+    op->buf = req.scratch;
+    op->result = 0;
+  }
+
+  virtual void FinishRead(const PreadOp& op, ReadRequest* req) const {
+    if (op.result < 0) {
+      req->result = Slice(req->scratch, 0);
+      req->status = IOError(filename_, static_cast<int>(-op.result));
+    } else {
+      req->result = Slice(req->scratch, op.result);
+      req->status = Status::OK();
+    }
+  }
+
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                       char* scratch) const {
     Status s;
@@ -92,6 +148,115 @@ class PosixRandomAccessFile: public RandomAccessFile {
   }
 };
 
+#if defined(O_DIRECT)
+// Offsets, lengths and buffers of O_DIRECT reads and writes must be
+// multiples of the file system's logical block size.  4K covers every
+// common device.
+static const size_t kDirectIOAlignment = 4096;
+
+static uint64_t AlignDown(uint64_t x) {
+  return x - (x % kDirectIOAlignment);
+}
+
+static uint64_t AlignUp(uint64_t x) {
+  return AlignDown(x + kDirectIOAlignment - 1);
+}
+
+static char* NewAlignedBuffer(size_t size) {
+  void* ptr = NULL;
+  if (posix_memalign(&ptr, kDirectIOAlignment, size) != 0) {
+    return NULL;
+  }
+  return reinterpret_cast<char*>(ptr);
+}
+
+// pread() based random-access on a file opened with O_DIRECT.  Each
+// read is widened to aligned boundaries and goes through an aligned
+// buffer, from which the requested range is copied to "scratch".
+class PosixDirectRandomAccessFile: public PosixPreadableFile {
+ private:
+  std::string filename_;
+  int fd_;
+
+ public:
+  PosixDirectRandomAccessFile(const std::string& fname, int fd)
+      : filename_(fname), fd_(fd) { }
+  virtual ~PosixDirectRandomAccessFile() { close(fd_); }
+
+  virtual void PrepareRead(const ReadRequest& req, PreadOp* op) const {
+    op->fd = -1;
+    op->offset = AlignDown(req.offset);
+    op->n = static_cast<size_t>(AlignUp(req.offset + req.n) - op->offset);
+    op->buf = NULL;
+    op->result = 0;
+    if (req.n > 0) {
+      op->buf = NewAlignedBuffer(op->n);
+      if (op->buf == NULL) {
+        op->result = -ENOMEM;
+      } else {
+        op->fd = fd_;
+      }
+    }
+  }
+
+  virtual void FinishRead(const PreadOp& op, ReadRequest* req) const {
+    req->result = Slice(req->scratch, 0);
+    req->status = Status::OK();
+    if (op.result < 0) {
+      req->status = IOError(filename_, static_cast<int>(-op.result));
+    } else {
+      const size_t skip = static_cast<size_t>(req->offset - op.offset);
+      if (static_cast<size_t>(op.result) > skip) {
+        const size_t avail = std::min(req->n, op.result - skip);
+        memcpy(req->scratch, op.buf + skip, avail);
+        req->result = Slice(req->scratch, avail);
+      }
+    }
+    free(op.buf);
+  }
+
+  virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                      char* scratch) const {
+    *result = Slice();
+    if (n == 0) {
+      return Status::OK();
+    }
+    const uint64_t start = AlignDown(offset);
+    const size_t length = static_cast<size_t>(AlignUp(offset + n) - start);
+    char* buf = NewAlignedBuffer(length);
+    if (buf == NULL) {
+      return IOError(filename_, ENOMEM);
+    }
+    Status s;
+    size_t done = 0;
+    while (done < length) {
+      ssize_t r = pread(fd_, buf + done, length - done,
+                        static_cast<off_t>(start + done));
+      if (r < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        s = IOError(filename_, errno);
+        break;
+      } else if (r == 0) {
+        break;  // End of file
+      }
+      done += r;
+    }
+    if (s.ok()) {
+      const size_t skip = static_cast<size_t>(offset - start);
+      if (done > skip) {
+        const size_t avail = std::min(n, done - skip);
+        memcpy(scratch, buf + skip, avail);
+        *result = Slice(scratch, avail);
+      }
+    }
+    free(buf);
+    return s;
+  }
+};
+#endif
+
 // Helper class to limit mmap file usage so that we do not end up
 // running out virtual memory or running into kernel performance
 // problems for very large databases.
@@ -345,6 +510,379 @@ class PosixMmapFile : public WritableFile {
   }
 };
 
+#if defined(O_DIRECT)
+// Writes to a file opened with O_DIRECT.  Appends are collected in an
+// aligned buffer that is written out whenever it fills up.  Sync()
+// and Close() also write the partially filled last block, padded with
+// zeros, and then cut the file back to its real length; that block
+// stays buffered so that later appends rewrite it in place.
+class PosixDirectWritableFile : public WritableFile {
+ public:
+  static const size_t kBufferSize = 1 << 20;
+
+ private:
+  std::string filename_;
+  int fd_;
+  char* buf_;             // kBufferSize bytes, aligned
+  size_t buf_len_;        // Bytes of buf_ in use
+  uint64_t file_offset_;  // Offset of buf_[0] in file; always aligned
+
+  Status WriteAligned(size_t n) {
+    size_t done = 0;
+    while (done < n) {
+      ssize_t r = pwrite(fd_, buf_ + done, n - done,
+                         static_cast<off_t>(file_offset_ + done));
+      if (r < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return IOError(filename_, errno);
+      }
+      done += r;
+    }
+    return Status::OK();
+  }
+
+  // Write out everything buffered and keep only the unfilled last
+  // block in buf_.
+  Status WriteBuffered() {
+    if (buf_len_ == 0) {
+      return Status::OK();
+    }
+    const size_t padded = static_cast<size_t>(AlignUp(buf_len_));
+    memset(buf_ + buf_len_, 0, padded - buf_len_);
+    Status s = WriteAligned(padded);
+    if (s.ok() && padded != buf_len_ &&
+        ftruncate(fd_, file_offset_ + buf_len_) < 0) {
+      s = IOError(filename_, errno);
+    }
+    if (s.ok()) {
+      const size_t full = static_cast<size_t>(AlignDown(buf_len_));
+      memmove(buf_, buf_ + full, buf_len_ - full);
+      buf_len_ -= full;
+      file_offset_ += full;
+    }
+    return s;
+  }
+
+ public:
+  PosixDirectWritableFile(const std::string& fname, int fd, char* buf)
+      : filename_(fname),
+        fd_(fd),
+        buf_(buf),
+        buf_len_(0),
+        file_offset_(0) {
+  }
+
+  ~PosixDirectWritableFile() {
+    if (fd_ >= 0) {
+      PosixDirectWritableFile::Close();
+    }
+  }
+
+  virtual Status Append(const Slice& data) {
+    const char* src = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+      size_t n = std::min(left, kBufferSize - buf_len_);
+      memcpy(buf_ + buf_len_, src, n);
+      buf_len_ += n;
+      src += n;
+      left -= n;
+      if (buf_len_ == kBufferSize) {
+        Status s = WriteAligned(kBufferSize);
+        if (!s.ok()) {
+          return s;
+        }
+        file_offset_ += kBufferSize;
+        buf_len_ = 0;
+      }
+    }
+    return Status::OK();
+  }
+
+  virtual Status Close() {
+    Status s = WriteBuffered();
+    if (close(fd_) < 0) {
+      if (s.ok()) {
+        s = IOError(filename_, errno);
+      }
+    }
+    fd_ = -1;
+    free(buf_);
+    buf_ = NULL;
+    return s;
+  }
+
+  virtual Status Flush() {
+    return Status::OK();
+  }
+
+  virtual Status Sync() {
+    Status s = WriteBuffered();
+    if (s.ok() && fdatasync(fd_) < 0) {
+      s = IOError(filename_, errno);
+    }
+    return s;
+  }
+};
+#endif
+
+#if defined(LEVELDB_IO_URING_PRESENT)
+// A minimal io_uring(7) instance driven through the raw system calls, so
+// that liburing is not needed.  Each thread that issues MultiRead()s gets
+// a ring of its own, which therefore needs no locking.
+class IoUring {
+ public:
+  // Number of reads kept in flight at a time
+  enum { kDepth = 64 };
+
+  // Return the ring of the calling thread, or NULL if io_uring cannot
+  // be used.
+  static IoUring* ForThisThread();
+
+  // Run ops[0,n-1], up to kDepth of them at a time.
+  void Run(PreadOp* ops, size_t n);
+
+  // Destructor of the thread-specific ring
+  static void DeleteRing(void* arg);
+
+ private:
+  int fd_;
+  bool broken_;
+  unsigned entries_;
+  void* sq_ptr_;
+  size_t sq_len_;
+  void* cq_ptr_;
+  size_t cq_len_;
+  struct io_uring_sqe* sqes_;
+  size_t sqes_len_;
+  unsigned* sq_head_;
+  unsigned* sq_tail_;
+  unsigned sq_mask_;
+  unsigned* sq_array_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  struct io_uring_cqe* cqes_;
+
+  IoUring()
+      : fd_(-1), broken_(false), entries_(0),
+        sq_ptr_(MAP_FAILED), sq_len_(0), cq_ptr_(MAP_FAILED), cq_len_(0),
+        sqes_(reinterpret_cast<struct io_uring_sqe*>(MAP_FAILED)),
+        sqes_len_(0) {
+  }
+
+  ~IoUring() {
+    if (sqes_ != MAP_FAILED) munmap(sqes_, sqes_len_);
+    if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_len_);
+    if (sq_ptr_ != MAP_FAILED) munmap(sq_ptr_, sq_len_);
+    if (fd_ >= 0) close(fd_);
+  }
+
+  bool Init() {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    fd_ = static_cast<int>(syscall(__NR_io_uring_setup, kDepth, &p));
+    if (fd_ < 0) {
+      return false;
+    }
+    sq_len_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_len_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_len_ = cq_len_ = std::max(sq_len_, cq_len_);
+    }
+    sq_ptr_ = mmap(NULL, sq_len_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED) {
+      return false;
+    }
+    if (single_mmap) {
+      cq_ptr_ = sq_ptr_;
+    } else {
+      cq_ptr_ = mmap(NULL, cq_len_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+      if (cq_ptr_ == MAP_FAILED) {
+        return false;
+      }
+    }
+    sqes_len_ = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = reinterpret_cast<struct io_uring_sqe*>(
+        mmap(NULL, sqes_len_, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) {
+      return false;
+    }
+
+    char* sq = reinterpret_cast<char*>(sq_ptr_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    char* cq = reinterpret_cast<char*>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+    entries_ = p.sq_entries;
+    return true;
+  }
+
+  // Record the outcome of every completed read; return their number.
+  size_t Reap(PreadOp* ops) {
+    unsigned head = *cq_head_;
+    const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    size_t count = 0;
+    while (head != tail) {
+      const struct io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+      ops[cqe->user_data].result = cqe->res;
+      head++;
+      count++;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return count;
+  }
+};
+
+static pthread_once_t io_uring_once = PTHREAD_ONCE_INIT;
+static pthread_key_t io_uring_key;
+static char io_uring_unavailable;  // Ring of threads that cannot have one
+
+void IoUring::DeleteRing(void* arg) {
+  if (arg != &io_uring_unavailable) {
+    delete reinterpret_cast<IoUring*>(arg);
+  }
+}
+
+static void InitIoUringKey() {
+  pthread_key_create(&io_uring_key, &IoUring::DeleteRing);
+}
+
+IoUring* IoUring::ForThisThread() {
+  pthread_once(&io_uring_once, &InitIoUringKey);
+  void* ring = pthread_getspecific(io_uring_key);
+  if (ring == NULL) {
+    IoUring* r = new IoUring;
+    if (r->Init()) {
+      ring = r;
+    } else {
+      delete r;
+      ring = &io_uring_unavailable;
+    }
+    pthread_setspecific(io_uring_key, ring);
+  }
+  if (ring == &io_uring_unavailable ||
+      reinterpret_cast<IoUring*>(ring)->broken_) {
+    return NULL;
+  }
+  return reinterpret_cast<IoUring*>(ring);
+}
+
+void IoUring::Run(PreadOp* ops, size_t n) {
+  std::vector<struct iovec> iov(entries_);
+  size_t next = 0;
+  while (next < n) {
+    // Queue the next wave of reads
+    const unsigned old_tail = *sq_tail_;  // Only this thread moves it
+    unsigned tail = old_tail;
+    for (; next < n && tail - old_tail < entries_; next++) {
+      PreadOp* op = &ops[next];
+      if (op->fd < 0) {
+        continue;
+      }
+      const unsigned index = tail & sq_mask_;
+      iov[tail - old_tail].iov_base = op->buf;
+      iov[tail - old_tail].iov_len = op->n;
+      struct io_uring_sqe* sqe = &sqes_[index];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_READV;
+      sqe->fd = op->fd;
+      sqe->off = op->offset;
+      sqe->addr = reinterpret_cast<uintptr_t>(&iov[tail - old_tail]);
+      sqe->len = 1;
+      sqe->user_data = next;
+      sq_array_[index] = index;
+      tail++;
+    }
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+    // Submit it and wait for all of it to complete
+    const size_t wave = tail - old_tail;
+    size_t to_submit = wave;
+    size_t completed = 0;
+    while (completed < wave) {
+      int r = static_cast<int>(syscall(__NR_io_uring_enter, fd_, to_submit,
+                                       wave - completed,
+                                       IORING_ENTER_GETEVENTS, NULL, 0));
+      if (r >= 0) {
+        to_submit -= r;
+      } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        if (to_submit == 0) {
+          fprintf(stderr, "io_uring_enter: %s\n", strerror(errno));
+          abort();
+        }
+        // Stop using the ring.  The reads it has not taken are done
+        // with pread(2); only those in flight are waited for.
+        broken_ = true;
+        const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        for (unsigned t = head; t != tail; t++) {
+          DoPread(&ops[sqes_[t & sq_mask_].user_data]);
+          completed++;
+        }
+        __atomic_store_n(sq_tail_, head, __ATOMIC_RELEASE);
+        tail = head;
+        to_submit = 0;
+      }
+      completed += Reap(ops);
+    }
+  }
+}
+#endif  // LEVELDB_IO_URING_PRESENT
+
+// A set of preads run by the calling thread together with the I/O
+// threads, for when io_uring is not available.
+struct PreadBatch {
+  PreadOp* ops;
+  size_t n;
+  port::Mutex mu;
+  port::CondVar cv;
+  size_t next;        // Index of the next op to run
+  size_t done;        // Number of ops completed
+  int refs;           // Threads still using the batch
+
+  PreadBatch(PreadOp* o, size_t count, int r)
+      : ops(o), n(count), cv(&mu), next(0), done(0), refs(r) { }
+};
+
+// Run ops of "batch" until there are none left.  Drops the caller's
+// reference, and deletes the batch if it was the last one, only if
+// "release" is true.
+static void WorkOnPreadBatch(PreadBatch* batch, bool release) {
+  batch->mu.Lock();
+  while (batch->next < batch->n) {
+    PreadOp* op = &batch->ops[batch->next++];
+    batch->mu.Unlock();
+    DoPread(op);
+    batch->mu.Lock();
+    if (++batch->done == batch->n) {
+      batch->cv.SignalAll();
+    }
+  }
+  bool last = false;
+  if (release) {
+    last = (--batch->refs == 0);
+  }
+  batch->mu.Unlock();
+  if (last) {
+    delete batch;
+  }
+}
+
+static void PreadBatchHelper(void* arg) {
+  WorkOnPreadBatch(reinterpret_cast<PreadBatch*>(arg), true);
+}
+
 static int LockOrUnlock(int fd, bool lock) {
   errno = 0;
   struct flock f;
@@ -441,6 +979,43 @@ class PosixEnv : public Env {
     return s;
   }
 
+  virtual Status NewDirectRandomAccessFile(const std::string& fname,
+                                           RandomAccessFile** result) {
+#if defined(O_DIRECT)
+    int fd = open(fname.c_str(), O_RDONLY | O_DIRECT);
+    if (fd >= 0) {
+      *result = new PosixDirectRandomAccessFile(fname, fd);
+      return Status::OK();
+    } else if (errno != EINVAL) {
+      *result = NULL;
+      return IOError(fname, errno);
+    }
+    // The file system does not support O_DIRECT (e.g. tmpfs)
+#endif
+    return NewRandomAccessFile(fname, result);
+  }
+
+  virtual Status NewDirectWritableFile(const std::string& fname,
+                                       WritableFile** result) {
+#if defined(O_DIRECT)
+    int fd = open(fname.c_str(), O_CREAT | O_RDWR | O_TRUNC | O_DIRECT, 0644);
+    if (fd >= 0) {
+      char* buf = NewAlignedBuffer(PosixDirectWritableFile::kBufferSize);
+      if (buf == NULL) {
+        close(fd);
+        *result = NULL;
+        return IOError(fname, ENOMEM);
+      }
+      *result = new PosixDirectWritableFile(fname, fd, buf);
+      return Status::OK();
+    } else if (errno != EINVAL) {
+      *result = NULL;
+      return IOError(fname, errno);
+    }
+#endif
+    return NewWritableFile(fname, result);
+  }
+
   virtual bool FileExists(const std::string& fname) {
     return access(fname.c_str(), F_OK) == 0;
   }
@@ -540,6 +1115,10 @@ class PosixEnv : public Env {
 
   virtual void Schedule(void (*function)(void*), void* arg);
 
+  virtual void ScheduleIO(void (*function)(void*), void* arg);
+
+  virtual void MultiRead(ReadRequest* reqs, size_t n);
+
   virtual void StartThread(void (*function)(void* arg), void* arg);
 
   virtual Status GetTestDirectory(std::string* result) {
@@ -599,6 +1178,19 @@ class PosixEnv : public Env {
     return NULL;
   }
 
+  // Run ops[0,n-1], with as many of them in flight at once as possible
+  void RunPreads(PreadOp* ops, size_t n);
+
+  // IOThread() is the body of the threads that serve ScheduleIO()
+  void IOThread();
+  static void* IOThreadWrapper(void* arg) {
+    reinterpret_cast<PosixEnv*>(arg)->IOThread();
+    return NULL;
+  }
+
+  // Number of threads started for ScheduleIO()
+  enum { kNumIOThreads = 4 };
+
   size_t page_size_;
   pthread_mutex_t mu_;
   pthread_cond_t bgsignal_;
@@ -610,14 +1202,21 @@ class PosixEnv : public Env {
   typedef std::deque<BGItem> BGQueue;
   BGQueue queue_;
 
+  // Separate queue served by the I/O threads
+  pthread_cond_t iosignal_;
+  bool started_iothreads_;
+  BGQueue io_queue_;
+
   PosixLockTable locks_;
   MmapLimiter mmap_limit_;
 };
 
 PosixEnv::PosixEnv() : page_size_(getpagesize()),
-                       started_bgthread_(false) {
+                       started_bgthread_(false),
+                       started_iothreads_(false) {
   PthreadCall("mutex_init", pthread_mutex_init(&mu_, NULL));
   PthreadCall("cvar_init", pthread_cond_init(&bgsignal_, NULL));
+  PthreadCall("cvar_init", pthread_cond_init(&iosignal_, NULL));
 }
 
 void PosixEnv::Schedule(void (*function)(void*), void* arg) {
@@ -662,6 +1261,100 @@ void PosixEnv::BGThread() {
   }
 }
 
+void PosixEnv::ScheduleIO(void (*function)(void*), void* arg) {
+  PthreadCall("lock", pthread_mutex_lock(&mu_));
+
+  // Start the I/O threads if necessary
+  if (!started_iothreads_) {
+    started_iothreads_ = true;
+    for (int i = 0; i < kNumIOThreads; i++) {
+      pthread_t t;
+      PthreadCall(
+          "create thread",
+          pthread_create(&t, NULL,  &PosixEnv::IOThreadWrapper, this));
+    }
+  }
+
+  io_queue_.push_back(BGItem());
+  io_queue_.back().function = function;
+  io_queue_.back().arg = arg;
+  PthreadCall("signal", pthread_cond_signal(&iosignal_));
+
+  PthreadCall("unlock", pthread_mutex_unlock(&mu_));
+}
+
+void PosixEnv::IOThread() {
+  while (true) {
+    PthreadCall("lock", pthread_mutex_lock(&mu_));
+    while (io_queue_.empty()) {
+      PthreadCall("wait", pthread_cond_wait(&iosignal_, &mu_));
+    }
+
+    void (*function)(void*) = io_queue_.front().function;
+    void* arg = io_queue_.front().arg;
+    io_queue_.pop_front();
+
+    PthreadCall("unlock", pthread_mutex_unlock(&mu_));
+    (*function)(arg);
+  }
+}
+
+void PosixEnv::MultiRead(ReadRequest* reqs, size_t n) {
+  std::vector<PreadOp> ops;
+  std::vector<std::pair<const PosixPreadableFile*, ReadRequest*> > pending;
+  for (size_t i = 0; i < n; i++) {
+    ReadRequest* req = &reqs[i];
+    const PosixPreadableFile* file =
+        dynamic_cast<const PosixPreadableFile*>(req->file);
+    if (file == NULL) {
+      // E.g. an mmap-ed file, whose reads do not wait for the device
+      // before they return.
+      req->status = req->file->Read(req->offset, req->n, &req->result,
+                                    req->scratch);
+    } else {
+      ops.push_back(PreadOp());
+      file->PrepareRead(*req, &ops.back());
+      pending.push_back(std::make_pair(file, req));
+    }
+  }
+  if (!ops.empty()) {
+    RunPreads(&ops[0], ops.size());
+  }
+  for (size_t i = 0; i < pending.size(); i++) {
+    pending[i].first->FinishRead(ops[i], pending[i].second);
+  }
+}
+
+void PosixEnv::RunPreads(PreadOp* ops, size_t n) {
+  if (n == 1) {
+    DoPread(&ops[0]);
+    return;
+  }
+#if defined(LEVELDB_IO_URING_PRESENT)
+  IoUring* ring = IoUring::ForThisThread();
+  if (ring != NULL) {
+    ring->Run(ops, n);
+    return;
+  }
+#endif
+  const int helpers = static_cast<int>(
+      std::min(n - 1, static_cast<size_t>(kNumIOThreads)));
+  PreadBatch* batch = new PreadBatch(ops, n, 1 + helpers);
+  for (int i = 0; i < helpers; i++) {
+    ScheduleIO(&PreadBatchHelper, batch);
+  }
+  WorkOnPreadBatch(batch, false);
+  batch->mu.Lock();
+  while (batch->done < batch->n) {
+    batch->cv.Wait();
+  }
+  const bool last = (--batch->refs == 0);
+  batch->mu.Unlock();
+  if (last) {
+    delete batch;
+  }
+}
+
 namespace {
 struct StartThreadState {
   void (*user_function)(void*);
@@ -4,7 +4,9 @@
 
 #include "leveldb/env.h"
 
+#include <algorithm>
 #include "port/port.h"
+#include "util/random.h"
 #include "util/testharness.h"
 
 namespace leveldb {
@@ -64,6 +66,22 @@ TEST(EnvPosixTest, RunMany) {
   ASSERT_EQ(4, reinterpret_cast<uintptr_t>(cur));
 }
 
+static void WaitForBool(void* ptr) {
+  port::AtomicPointer* p = reinterpret_cast<port::AtomicPointer*>(ptr);
+  while (p->Acquire_Load() == NULL) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+}
+
+TEST(EnvPosixTest, ScheduleIONotBlockedBySchedule) {
+  // Occupy the background thread until the I/O work item has run.
+  port::AtomicPointer called (NULL);
+  env_->Schedule(&WaitForBool, &called);
+  env_->ScheduleIO(&SetBool, &called);
+  WaitForBool(&called);
+  ASSERT_TRUE(called.Acquire_Load() != NULL);
+}
+
 struct State {
   port::Mutex mu;
   int val;
@@ -97,6 +115,92 @@ TEST(EnvPosixTest, StartThread) {
   ASSERT_EQ(state.val, 3);
 }
 
+TEST(EnvPosixTest, DirectIO) {
+  std::string fname;
+  ASSERT_OK(env_->GetTestDirectory(&fname));
+  fname += "/direct_io_test";
+
+  // Appends of odd sizes, with syncs that leave a partial last block.
+  Random rnd(301);
+  std::string data;
+  WritableFile* writable;
+  ASSERT_OK(env_->NewDirectWritableFile(fname, &writable));
+  for (int i = 0; i < 200; i++) {
+    std::string piece(rnd.Uniform(20000), 'a' + (i % 26));
+    data += piece;
+    ASSERT_OK(writable->Append(piece));
+    if (i % 17 == 0) {
+      ASSERT_OK(writable->Sync());
+      uint64_t size;
+      ASSERT_OK(env_->GetFileSize(fname, &size));
+      ASSERT_EQ(data.size(), size);
+    }
+  }
+  ASSERT_OK(writable->Close());
+  delete writable;
+  uint64_t size;
+  ASSERT_OK(env_->GetFileSize(fname, &size));
+  ASSERT_EQ(data.size(), size);
+
+  // Unaligned reads, including ones that run past the end of the file.
+  RandomAccessFile* file;
+  ASSERT_OK(env_->NewDirectRandomAccessFile(fname, &file));
+  char* scratch = new char[100000];
+  for (int i = 0; i < 100; i++) {
+    uint64_t offset = rnd.Uniform(data.size());
+    size_t n = rnd.Uniform(100000);
+    Slice result;
+    ASSERT_OK(file->Read(offset, n, &result, scratch));
+    ASSERT_EQ(data.substr(offset, n), result.ToString());
+  }
+  Slice result;
+  ASSERT_OK(file->Read(data.size(), 10, &result, scratch));
+  ASSERT_EQ(0, result.size());
+  delete[] scratch;
+  delete file;
+  ASSERT_OK(env_->DeleteFile(fname));
+}
+
+TEST(EnvPosixTest, MultiRead) {
+  std::string fname;
+  ASSERT_OK(env_->GetTestDirectory(&fname));
+  fname += "/multi_read_test";
+  Random rnd(301);
+  std::string data;
+  for (int i = 0; i < 100000; i++) {
+    data.push_back(static_cast<char>(' ' + rnd.Uniform(95)));
+  }
+  ASSERT_OK(WriteStringToFile(env_, data, fname));
+
+  // Reads of a buffered and of a direct file in one batch
+  RandomAccessFile* files[2];
+  ASSERT_OK(env_->NewRandomAccessFile(fname, &files[0]));
+  ASSERT_OK(env_->NewDirectRandomAccessFile(fname, &files[1]));
+  const int kReads = 200;
+  std::vector<ReadRequest> reqs(kReads);
+  std::vector<std::string> scratch(kReads);
+  for (int i = 0; i < kReads; i++) {
+    reqs[i].file = files[i % 2];
+    reqs[i].offset = rnd.Uniform(data.size());
+    reqs[i].n = std::min<size_t>(rnd.Uniform(10000),
+                                 data.size() - reqs[i].offset);
+    scratch[i].resize(reqs[i].n + 1);
+    reqs[i].scratch = &scratch[i][0];
+  }
+  // Past the end of the direct file
+  reqs[7].offset = data.size() + 10;
+  env_->MultiRead(&reqs[0], reqs.size());
+  for (int i = 0; i < kReads; i++) {
+    ASSERT_OK(reqs[i].status);
+    ASSERT_EQ(i == 7 ? std::string()
+                     : data.substr(reqs[i].offset, reqs[i].n),
+              reqs[i].result.ToString());
+  }
+  delete files[0];
+  delete files[1];
+  ASSERT_OK(env_->DeleteFile(fname));
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
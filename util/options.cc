@@ -19,10 +19,34 @@ Options::Options()
       write_buffer_size(4<<20),
       max_open_files(1000),
       block_cache(NULL),
+      row_cache(NULL),
+      compressed_block_cache(NULL),
+      persistent_cache(NULL),
+      persist_cache_state(false),
+      preload_tables(false),
       block_size(4096),
       block_restart_interval(16),
       compression(kSnappyCompression),
-      filter_policy(NULL) {
+      filter_policy(NULL),
+      compaction_filter(NULL),
+      min_blob_size(0),
+      ttl(0),
+      use_direct_reads(false),
+      use_direct_io_for_flush_and_compaction(false),
+      prepopulate_block_cache(false),
+      num_levels(7),
+      level0_file_num_compaction_trigger(4),
+      level0_slowdown_writes_trigger(8),
+      level0_stop_writes_trigger(12),
+      max_mem_compaction_level(2),
+      max_file_size(2<<20),
+      max_grandparent_overlap_factor(10),
+      expanded_compaction_factor(25),
+      level_compaction_dynamic_level_bytes(false),
+      compaction_style(kCompactionStyleLevel),
+      compaction_pri(kByCompactPointer),
+      universal_size_ratio(1),
+      universal_max_size_amplification_percent(200) {
 }
 
 
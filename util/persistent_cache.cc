@@ -0,0 +1,427 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Persistent cache that appends entries to a sequence of segment files
+// and keeps an in-memory index from key to the record's location.
+//
+// Each segment file holds a sequence of records:
+//    checksum: uint32     // masked crc32c of everything after it
+//    key_length: uint32
+//    value_length: uint32
+//    key: uint8[key_length]
+//    value: uint8[value_length]
+// New records go to the newest segment until it reaches its size limit.
+// The newest segment's records are also kept in memory to serve lookups
+// until the segment is complete and can be opened for reading.
+// When the segments hold more than the capacity, the oldest segment is
+// deleted along with its index entries.  Opening a cache rebuilds the
+// index by scanning the record headers of the existing segments.
+
+#include "leveldb/persistent_cache.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/logging.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+PersistentCache::~PersistentCache() {
+}
+
+namespace {
+
+static const size_t kHeaderSize = 4 + 4 + 4;
+
+// The capacity is split into about this many segments, each of which
+// is at most kMaxSegmentSize bytes.
+static const int kTargetSegments = 8;
+static const uint64_t kMaxSegmentSize = 16 << 20;
+
+static std::string SegmentFileName(const std::string& dirname,
+                                   uint64_t number) {
+  char buf[100];
+  snprintf(buf, sizeof(buf), "/%06llu.pcache",
+           static_cast<unsigned long long>(number));
+  return dirname + buf;
+}
+
+// If "fname" names a segment file, store its number in *number.
+static bool ParseSegmentFileName(const std::string& fname, uint64_t* number) {
+  Slice rest(fname);
+  return (ConsumeDecimalNumber(&rest, number) && rest == Slice(".pcache"));
+}
+
+// Check the record in "contents" and extract its value.
+static Status DecodeRecord(const Slice& key, const Slice& contents,
+                           std::string* value) {
+  const char* data = contents.data();
+  const uint32_t crc = crc32c::Unmask(DecodeFixed32(data));
+  const uint32_t key_length = DecodeFixed32(data + 4);
+  const uint32_t value_length = DecodeFixed32(data + 8);
+  if (crc32c::Value(data + 4, contents.size() - 4) != crc ||
+      kHeaderSize + key_length + value_length != contents.size() ||
+      Slice(data + kHeaderSize, key_length) != key) {
+    return Status::Corruption("bad persistent cache record");
+  }
+  value->assign(data + kHeaderSize + key_length, value_length);
+  return Status::OK();
+}
+
+struct Segment {
+  uint64_t number;
+  uint64_t size;                  // Bytes of records in the file
+  RandomAccessFile* file;         // NULL while the segment is written
+  std::vector<std::string> keys;  // Keys indexed into this segment
+  int refs;                       // One for the cache, one per reader
+};
+
+struct Location {
+  Segment* segment;
+  uint64_t offset;
+  uint32_t size;                  // Record size, including the header
+};
+
+class SegmentedFileCache : public PersistentCache {
+ public:
+  SegmentedFileCache(Env* env, const std::string& dirname, uint64_t capacity)
+      : env_(env),
+        dirname_(dirname),
+        capacity_(capacity),
+        segment_limit_(std::max<uint64_t>(
+            std::min(capacity / kTargetSegments, kMaxSegmentSize), 1)),
+        usage_(0),
+        writer_(NULL),
+        writer_segment_(NULL) {
+  }
+
+  virtual ~SegmentedFileCache() {
+    FinishSegment();
+    for (size_t i = 0; i < segments_.size(); i++) {
+      Unref(segments_[i]);
+    }
+  }
+
+  // Rebuild the index from the existing segments and start a new one.
+  Status Open();
+
+  virtual Status Insert(const Slice& key, const Slice& value);
+  virtual Status Lookup(const Slice& key, std::string* value);
+
+ private:
+  Status RecoverSegment(uint64_t number);
+  Status StartSegment(uint64_t number);
+  void FinishSegment();
+  void EvictOldestSegment();
+  void Unref(Segment* segment);
+
+  Env* const env_;
+  const std::string dirname_;
+  const uint64_t capacity_;
+  const uint64_t segment_limit_;
+
+  port::Mutex mutex_;
+  uint64_t usage_;                     // Sum of the segments' sizes
+  std::vector<Segment*> segments_;     // Oldest first
+  std::map<std::string, Location> index_;
+  WritableFile* writer_;               // Appends to the newest segment
+  Segment* writer_segment_;
+  std::string writer_contents_;        // Records of writer_segment_
+};
+
+void SegmentedFileCache::Unref(Segment* segment) {
+  assert(segment->refs > 0);
+  segment->refs--;
+  if (segment->refs == 0) {
+    delete segment->file;
+    delete segment;
+  }
+}
+
+Status SegmentedFileCache::Open() {
+  env_->CreateDir(dirname_);  // Ignore error; it may already exist
+  std::vector<std::string> children;
+  Status s = env_->GetChildren(dirname_, &children);
+  if (!s.ok()) {
+    return s;
+  }
+  std::vector<uint64_t> numbers;
+  for (size_t i = 0; i < children.size(); i++) {
+    uint64_t number;
+    if (ParseSegmentFileName(children[i], &number)) {
+      numbers.push_back(number);
+    }
+  }
+  std::sort(numbers.begin(), numbers.end());
+
+  MutexLock l(&mutex_);
+  for (size_t i = 0; i < numbers.size(); i++) {
+    s = RecoverSegment(numbers[i]);
+    if (!s.ok()) {
+      // A segment we cannot read only costs us its entries.
+      env_->DeleteFile(SegmentFileName(dirname_, numbers[i]));
+    }
+  }
+  while (usage_ > capacity_ && !segments_.empty()) {
+    EvictOldestSegment();
+  }
+  return StartSegment(numbers.empty() ? 1 : numbers.back() + 1);
+}
+
+// REQUIRES: mutex_ held.
+Status SegmentedFileCache::RecoverSegment(uint64_t number) {
+  const std::string fname = SegmentFileName(dirname_, number);
+  uint64_t file_size;
+  Status s = env_->GetFileSize(fname, &file_size);
+  SequentialFile* input = NULL;
+  if (s.ok()) {
+    s = env_->NewSequentialFile(fname, &input);
+  }
+  RandomAccessFile* file = NULL;
+  if (s.ok()) {
+    s = env_->NewRandomAccessFile(fname, &file);
+  }
+  if (!s.ok()) {
+    delete input;
+    return s;
+  }
+
+  Segment* segment = new Segment;
+  segment->number = number;
+  segment->file = file;
+  segment->refs = 1;
+
+  // Only the record headers and keys are read here; the checksum of a
+  // record is verified when it is looked up.  A record that does not
+  // fit in the file ends the segment (e.g. after a crash).
+  uint64_t offset = 0;
+  char header[kHeaderSize];
+  std::string key;
+  while (offset + kHeaderSize <= file_size) {
+    Slice fragment;
+    if (!input->Read(kHeaderSize, &fragment, header).ok() ||
+        fragment.size() != kHeaderSize) {
+      break;
+    }
+    const uint32_t key_length = DecodeFixed32(fragment.data() + 4);
+    const uint32_t value_length = DecodeFixed32(fragment.data() + 8);
+    const uint64_t record_size = kHeaderSize + key_length + value_length;
+    if (key_length == 0 || offset + record_size > file_size) {
+      break;
+    }
+    key.resize(key_length);
+    if (!input->Read(key_length, &fragment, &key[0]).ok() ||
+        fragment.size() != key_length) {
+      break;
+    }
+    if (fragment.data() != key.data()) {
+      key.assign(fragment.data(), fragment.size());
+    }
+    if (!input->Skip(value_length).ok()) {
+      break;
+    }
+    Location loc;
+    loc.segment = segment;
+    loc.offset = offset;
+    loc.size = static_cast<uint32_t>(record_size);
+    std::map<std::string, Location>::iterator it = index_.find(key);
+    if (it == index_.end()) {
+      index_[key] = loc;
+      segment->keys.push_back(key);
+    }
+    offset += record_size;
+  }
+  delete input;
+
+  if (offset == 0) {
+    delete segment->file;
+    delete segment;
+    env_->DeleteFile(fname);
+    return Status::OK();
+  }
+  segment->size = offset;
+  usage_ += offset;
+  segments_.push_back(segment);
+  return Status::OK();
+}
+
+// REQUIRES: mutex_ held.
+Status SegmentedFileCache::StartSegment(uint64_t number) {
+  FinishSegment();
+  WritableFile* writer;
+  Status s = env_->NewWritableFile(SegmentFileName(dirname_, number), &writer);
+  if (!s.ok()) {
+    return s;
+  }
+  Segment* segment = new Segment;
+  segment->number = number;
+  segment->size = 0;
+  segment->file = NULL;
+  segment->refs = 1;
+  segments_.push_back(segment);
+  writer_ = writer;
+  writer_segment_ = segment;
+  return s;
+}
+
+// Close the segment being written and switch its lookups over to the
+// file.  If the file cannot be reopened, the segment is dropped.
+// REQUIRES: mutex_ held.
+void SegmentedFileCache::FinishSegment() {
+  if (writer_ == NULL) {
+    return;
+  }
+  Status s = writer_->Close();
+  delete writer_;
+  writer_ = NULL;
+  Segment* segment = writer_segment_;
+  writer_segment_ = NULL;
+  writer_contents_.clear();
+  if (s.ok()) {
+    s = env_->NewRandomAccessFile(SegmentFileName(dirname_, segment->number),
+                                  &segment->file);
+  }
+  if (!s.ok()) {
+    // Evict it, keeping the order of the remaining segments.
+    std::vector<Segment*>::iterator it =
+        std::find(segments_.begin(), segments_.end(), segment);
+    segments_.erase(it);
+    segments_.insert(segments_.begin(), segment);
+    EvictOldestSegment();
+  }
+}
+
+// REQUIRES: mutex_ held.
+void SegmentedFileCache::EvictOldestSegment() {
+  Segment* segment = segments_.front();
+  segments_.erase(segments_.begin());
+  for (size_t i = 0; i < segment->keys.size(); i++) {
+    index_.erase(segment->keys[i]);
+  }
+  usage_ -= segment->size;
+  if (segment == writer_segment_) {
+    delete writer_;
+    writer_ = NULL;
+    writer_segment_ = NULL;
+    writer_contents_.clear();
+  }
+  env_->DeleteFile(SegmentFileName(dirname_, segment->number));
+  Unref(segment);
+}
+
+Status SegmentedFileCache::Insert(const Slice& key, const Slice& value) {
+  const uint64_t record_size = kHeaderSize + key.size() + value.size();
+  if (key.empty() || record_size > segment_limit_) {
+    return Status::InvalidArgument("entry does not fit in the cache");
+  }
+
+  std::string record;
+  record.reserve(record_size);
+  PutFixed32(&record, 0);  // Checksum, filled in below
+  PutFixed32(&record, static_cast<uint32_t>(key.size()));
+  PutFixed32(&record, static_cast<uint32_t>(value.size()));
+  record.append(key.data(), key.size());
+  record.append(value.data(), value.size());
+  EncodeFixed32(&record[0], crc32c::Mask(
+      crc32c::Value(record.data() + 4, record.size() - 4)));
+
+  MutexLock l(&mutex_);
+  const std::string k = key.ToString();
+  if (index_.find(k) != index_.end()) {
+    return Status::OK();
+  }
+
+  Status s;
+  if (writer_ == NULL || writer_segment_->size + record_size > segment_limit_) {
+    const uint64_t number =
+        segments_.empty() ? 1 : segments_.back()->number + 1;
+    s = StartSegment(number);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  while (usage_ + record_size > capacity_ && segments_.size() > 1) {
+    EvictOldestSegment();
+  }
+
+  Segment* segment = writer_segment_;
+  s = writer_->Append(record);
+  if (s.ok()) {
+    s = writer_->Flush();
+  }
+  if (!s.ok()) {
+    // Do not append behind a partial record.
+    FinishSegment();
+    return s;
+  }
+  writer_contents_.append(record);
+  Location loc;
+  loc.segment = segment;
+  loc.offset = segment->size;
+  loc.size = static_cast<uint32_t>(record_size);
+  index_[k] = loc;
+  segment->keys.push_back(k);
+  segment->size += record_size;
+  usage_ += record_size;
+  return s;
+}
+
+Status SegmentedFileCache::Lookup(const Slice& key, std::string* value) {
+  Location loc;
+  {
+    MutexLock l(&mutex_);
+    std::map<std::string, Location>::iterator it =
+        index_.find(key.ToString());
+    if (it == index_.end()) {
+      return Status::NotFound(Slice());
+    }
+    loc = it->second;
+    if (loc.segment == writer_segment_) {
+      return DecodeRecord(key, Slice(writer_contents_.data() + loc.offset,
+                                     loc.size), value);
+    }
+    loc.segment->refs++;
+  }
+
+  // Read outside the lock; the reference keeps the file open even if
+  // the segment is evicted meanwhile.
+  std::string record(loc.size, '\0');
+  Slice contents;
+  Status s = loc.segment->file->Read(loc.offset, loc.size, &contents,
+                                     &record[0]);
+  {
+    MutexLock l(&mutex_);
+    Unref(loc.segment);
+  }
+  if (!s.ok()) {
+    return s;
+  }
+  if (contents.size() != loc.size) {
+    return Status::Corruption("truncated persistent cache record");
+  }
+  return DecodeRecord(key, contents, value);
+}
+
+}  // namespace
+
+Status NewPersistentCache(Env* env, const std::string& dirname,
+                          uint64_t capacity, PersistentCache** result) {
+  *result = NULL;
+  SegmentedFileCache* cache = new SegmentedFileCache(env, dirname, capacity);
+  Status s = cache->Open();
+  if (s.ok()) {
+    *result = cache;
+  } else {
+    delete cache;
+  }
+  return s;
+}
+
+}  // namespace leveldb
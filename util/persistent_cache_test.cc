@@ -0,0 +1,182 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/persistent_cache.h"
+
+#include <vector>
+#include "leveldb/env.h"
+#include "util/testharness.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+static std::string Key(int i) {
+  char buf[100];
+  snprintf(buf, sizeof(buf), "key%06d", i);
+  return std::string(buf);
+}
+
+static std::string Value(int i, int size) {
+  std::string result = Key(i);
+  result.resize(size, 'v');
+  return result;
+}
+
+class PersistentCacheTest {
+ public:
+  Env* env_;
+  std::string dirname_;
+  PersistentCache* cache_;
+
+  PersistentCacheTest() : env_(Env::Default()), cache_(NULL) {
+    dirname_ = test::TmpDir() + "/persistent_cache_test";
+    DeleteFiles();
+  }
+
+  ~PersistentCacheTest() {
+    delete cache_;
+    DeleteFiles();
+    env_->DeleteDir(dirname_);
+  }
+
+  void DeleteFiles() {
+    std::vector<std::string> children;
+    env_->GetChildren(dirname_, &children);
+    for (size_t i = 0; i < children.size(); i++) {
+      env_->DeleteFile(dirname_ + "/" + children[i]);
+    }
+  }
+
+  void Open(uint64_t capacity) {
+    delete cache_;
+    cache_ = NULL;
+    ASSERT_OK(NewPersistentCache(env_, dirname_, capacity, &cache_));
+  }
+
+  std::string Lookup(int i) {
+    std::string value;
+    Status s = cache_->Lookup(Key(i), &value);
+    if (s.IsNotFound()) {
+      return "NOT_FOUND";
+    } else if (!s.ok()) {
+      return s.ToString();
+    }
+    return value;
+  }
+
+  uint64_t TotalFileSize() {
+    std::vector<std::string> children;
+    env_->GetChildren(dirname_, &children);
+    uint64_t total = 0;
+    for (size_t i = 0; i < children.size(); i++) {
+      uint64_t size;
+      if (env_->GetFileSize(dirname_ + "/" + children[i], &size).ok()) {
+        total += size;
+      }
+    }
+    return total;
+  }
+};
+
+TEST(PersistentCacheTest, InsertAndLookup) {
+  Open(1 << 20);
+  ASSERT_EQ("NOT_FOUND", Lookup(1));
+  ASSERT_OK(cache_->Insert(Key(1), Value(1, 100)));
+  ASSERT_OK(cache_->Insert(Key(2), Value(2, 1000)));
+  ASSERT_EQ(Value(1, 100), Lookup(1));
+  ASSERT_EQ(Value(2, 1000), Lookup(2));
+  ASSERT_EQ("NOT_FOUND", Lookup(3));
+
+  // Entries that do not fit are rejected.
+  ASSERT_TRUE(!cache_->Insert(Key(4), Value(4, 1 << 20)).ok());
+  ASSERT_EQ("NOT_FOUND", Lookup(4));
+}
+
+TEST(PersistentCacheTest, Reopen) {
+  const int N = 1000;
+  Open(1 << 20);
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(cache_->Insert(Key(i), Value(i, 500)));
+  }
+  Open(1 << 20);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Value(i, 500), Lookup(i));
+  }
+
+  // Entries added after reopening go to a new segment.
+  ASSERT_OK(cache_->Insert(Key(N), Value(N, 500)));
+  ASSERT_EQ(Value(N, 500), Lookup(N));
+  Open(1 << 20);
+  ASSERT_EQ(Value(0, 500), Lookup(0));
+  ASSERT_EQ(Value(N, 500), Lookup(N));
+}
+
+TEST(PersistentCacheTest, Eviction) {
+  const uint64_t kCapacity = 256 << 10;
+  Open(kCapacity);
+  const int N = 4000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(cache_->Insert(Key(i), Value(i, 500)));
+  }
+  // The oldest entries were evicted first.
+  ASSERT_EQ("NOT_FOUND", Lookup(0));
+  ASSERT_EQ(Value(N - 1, 500), Lookup(N - 1));
+  int found = 0;
+  for (int i = 0; i < N; i++) {
+    if (Lookup(i) != "NOT_FOUND") {
+      ASSERT_EQ(Value(i, 500), Lookup(i));
+      found++;
+    }
+  }
+  ASSERT_GT(found, 300);
+
+  // The file being written may be preallocated, so sizes are only
+  // checked once the cache is closed.
+  delete cache_;
+  cache_ = NULL;
+  ASSERT_LE(TotalFileSize(), kCapacity);
+
+  // A smaller capacity on reopen evicts the excess.
+  Open(kCapacity / 4);
+  delete cache_;
+  cache_ = NULL;
+  ASSERT_LE(TotalFileSize(), kCapacity / 4);
+  Open(kCapacity / 4);
+  ASSERT_EQ(Value(N - 1, 500), Lookup(N - 1));
+}
+
+TEST(PersistentCacheTest, TruncatedSegment) {
+  Open(1 << 20);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(cache_->Insert(Key(i), Value(i, 1000)));
+  }
+  delete cache_;
+  cache_ = NULL;
+
+  // Cut the last record short, as a crash while appending would.
+  std::vector<std::string> children;
+  ASSERT_OK(env_->GetChildren(dirname_, &children));
+  std::string fname;
+  for (size_t i = 0; i < children.size(); i++) {
+    if (children[i].find(".pcache") != std::string::npos) {
+      fname = dirname_ + "/" + children[i];
+    }
+  }
+  std::string contents;
+  ASSERT_OK(ReadFileToString(env_, fname, &contents));
+  contents.resize(contents.size() - 10);
+  ASSERT_OK(WriteStringToFile(env_, contents, fname));
+
+  Open(1 << 20);
+  for (int i = 0; i < 9; i++) {
+    ASSERT_EQ(Value(i, 1000), Lookup(i));
+  }
+  ASSERT_EQ("NOT_FOUND", Lookup(9));
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/pinnable_slice.h"
+
+namespace leveldb {
+
+PinnableSlice::PinnableSlice()
+    : cleanup_function_(NULL),
+      cleanup_arg1_(NULL),
+      cleanup_arg2_(NULL) {
+}
+
+PinnableSlice::~PinnableSlice() {
+  ReleasePinned();
+}
+
+void PinnableSlice::ReleasePinned() {
+  if (cleanup_function_ != NULL) {
+    CleanupFunction function = cleanup_function_;
+    cleanup_function_ = NULL;
+    (*function)(cleanup_arg1_, cleanup_arg2_);
+  }
+}
+
+void PinnableSlice::PinSlice(const Slice& s, CleanupFunction function,
+                             void* arg1, void* arg2) {
+  assert(function != NULL);
+  ReleasePinned();
+  cleanup_function_ = function;
+  cleanup_arg1_ = arg1;
+  cleanup_arg2_ = arg2;
+  *static_cast<Slice*>(this) = s;
+}
+
+void PinnableSlice::PinSelf(const Slice& s) {
+  // Copy before releasing: "s" may refer to the pinned storage.
+  buf_.assign(s.data(), s.size());
+  ReleasePinned();
+  *static_cast<Slice*>(this) = buf_;
+}
+
+void PinnableSlice::PinSelf() {
+  ReleasePinned();
+  *static_cast<Slice*>(this) = buf_;
+}
+
+void PinnableSlice::Reset() {
+  ReleasePinned();
+  buf_.clear();
+  clear();
+}
+
+}  // namespace leveldb